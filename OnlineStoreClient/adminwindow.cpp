@@ -7,6 +7,7 @@
 #include <QBuffer>
 #include <QListWidgetItem>
 #include <QVBoxLayout>
+#include <QStatusBar>
 
 AdminWindow::AdminWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -22,6 +23,9 @@ AdminWindow::AdminWindow(QWidget *parent) :
     connect(&m_networkManager, &NetworkManager::categoriesFetched, this, &AdminWindow::handleCategoriesFetched);
     connect(&m_networkManager, &NetworkManager::productsFetched, this, &AdminWindow::handleProductsFetched);
     connect(&m_networkManager, &NetworkManager::adminActionCompleted, this, &AdminWindow::handleAdminAction);
+    connect(&m_networkManager, &NetworkManager::categoryDeletionProgress, this, [this](int categoryId, qint64 processed) {
+        statusBar()->showMessage(QString("Удаление категории %1: обработано товаров %2").arg(categoryId).arg(processed));
+    });
 }
 
 AdminWindow::~AdminWindow()
@@ -178,43 +182,42 @@ void AdminWindow::on_btnCreateProduct_clicked()
     double price = QInputDialog::getDouble(this, "Новый товар", "Цена:", 0, 0.01, 10000000, 2, &ok);
     if (!ok) return;
 
+    int stock = QInputDialog::getInt(this, "Новый товар", "Количество на складе:", 1, 0, 1000000, 1, &ok);
+    if (!ok) return;
+
     QString description = QInputDialog::getMultiLineText(this, "Новый товар", "Описание (можно оставить пустым):", "", &ok);
     if (!ok) return;
 
     // Диалог для выбора картинки
-    QString imageFilePath = QFileDialog::getOpenFileName(this, "Выбрать изображение", "", "Images (*.png *.jpg *.jpeg)");
+    QString imageFilePath = QFileDialog::getOpenFileName(this, "Выбрать изображение", "", "Images (*.png *.jpg *.jpeg *.gif *.webp)");
 
     // Собираем JSON для отправки
     QJsonObject productData;
     productData["product_name"] = name;
     productData["product_price"] = price;
+    productData["product_stock"] = stock;
     productData["product_description"] = description;
     productData["category_ids"] = QJsonArray({m_selectedCategoryId}); // Привязываем к текущей категории
 
     // Если картинка выбрана, сначала загружаем ее на сервер
     if (!imageFilePath.isEmpty()) {
-        QFile file(imageFilePath);
-        if (file.open(QIODevice::ReadOnly)) {
-            QNetworkReply* uploadReply = m_networkManager.uploadImage(file.readAll(), QFileInfo(file).fileName());
-            // Когда картинка загрузится, мы получим путь и создадим товар
-            connect(uploadReply, &QNetworkReply::finished, this, [this, uploadReply, productData]() mutable {
-                bool success;
-                QJsonDocument doc;
-                // ... (логика парсинга ответа от загрузки, как в ProductCardInAdminPanel)
-                if (uploadReply->error() == QNetworkReply::NoError) {
-                    doc = QJsonDocument::fromJson(uploadReply->readAll());
-                    if (doc.isObject() && doc.object().contains("image_path")) {
-                        productData["product_image_path"] = doc.object()["image_path"].toString();
-                        m_networkManager.addProduct(productData); // Отправляем запрос на создание товара
-                    } else {
-                        QMessageBox::critical(this, "Ошибка", "Сервер не вернул путь к изображению.");
-                    }
-                } else {
-                    QMessageBox::critical(this, "Ошибка", "Не удалось загрузить изображение: " + uploadReply->errorString());
-                }
-                uploadReply->deleteLater();
-            });
-        }
+        ImageUploader* uploader = m_networkManager.uploadImage(imageFilePath);
+        connect(uploader, &ImageUploader::progress, this, [this](qint64 sent, qint64 total) {
+            if (total > 0) {
+                statusBar()->showMessage(QString("Загрузка изображения: %1%").arg(sent * 100 / total));
+            }
+        });
+        // Когда картинка загрузится, мы получим путь и создадим товар
+        connect(uploader, &ImageUploader::finished, this,
+                [this, productData](bool success, const QString& imagePath, const QString& errorString) mutable {
+            statusBar()->clearMessage();
+            if (success) {
+                productData["product_image_path"] = imagePath;
+                m_networkManager.addProduct(productData); // Отправляем запрос на создание товара
+            } else {
+                QMessageBox::critical(this, "Ошибка", "Не удалось загрузить изображение: " + errorString);
+            }
+        });
     } else {
         // Если картинка не выбрана, создаем товар без нее
         productData["product_image_path"] = "";
@@ -224,6 +227,9 @@ void AdminWindow::on_btnCreateProduct_clicked()
 
 void AdminWindow::handleAdminAction(bool success, const QString& action, const QString& message, const QString& errorString)
 {
+    if (action == "delete_category") {
+        statusBar()->clearMessage();
+    }
     if (success) {
         QMessageBox::information(this, "Успех", message);
         // Обновляем нужную часть интерфейса
@@ -7,8 +7,16 @@
 #include <QLabel>
 #include <QVBoxLayout>
 #include <QScrollArea>
+#include <QScrollBar>
+#include <QTimer>
 #include "cartwindow.h"
 
+namespace {
+// Карточек на страницу и расстояние до конца списка, с которого подгружается следующая
+constexpr int kProductPageSize = 20;
+constexpr int kLoadMoreThresholdPx = 300;
+}
+
 
 CustomerWindow::CustomerWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -20,10 +28,15 @@ CustomerWindow::CustomerWindow(QWidget *parent) :
 
     // Соединение сигналов от NetworkManager
     connect(&m_networkManager, &NetworkManager::categoriesFetched, this, &CustomerWindow::handleCategoriesFetched);
-    connect(&m_networkManager, &NetworkManager::productsFetched, this, &CustomerWindow::handleProductsFetched);
+    connect(&m_networkManager, &NetworkManager::productsPageFetched, this, &CustomerWindow::handleProductsPageFetched);
     connect(&m_networkManager, &NetworkManager::cartActionCompleted, this, &CustomerWindow::handleCartActionCompleted);
     connect(&m_networkManager, &NetworkManager::cartContentsFetched, this, &CustomerWindow::handleCartContentsFetched);
 
+    QScrollBar *productsScrollBar = ui->productsScrollArea->verticalScrollBar();
+    connect(productsScrollBar, &QScrollBar::valueChanged, this, &CustomerWindow::onProductsScrolled);
+    // Новые карточки меняют высоту списка: если он все еще не заполняет окно, нужна следующая страница
+    connect(productsScrollBar, &QScrollBar::rangeChanged, this, &CustomerWindow::loadMoreIfNeeded);
+
     // Соединение сигнала выбора категории
     connect(ui->categoriesListWidget, &QListWidget::currentItemChanged, this, &CustomerWindow::on_categoriesListWidget_currentItemChanged);
 
@@ -90,8 +103,13 @@ void CustomerWindow::on_categoriesListWidget_currentItemChanged(QListWidgetItem
     Q_UNUSED(previous);
     m_productsRequestFinished = false;
     m_cartRequestFinished = false;
-    m_currentProducts.empty();
+    m_currentProducts = QJsonArray();
     m_cartProductIds.clear();
+    m_nextCursor.clear();
+    m_pendingCursor.clear();
+    m_pageLoading = false;
+    m_visibleProductsCount = 0;
+    m_currentCategoryId = -1;
 
     qDebug() << "CustomerWindow: Category selection changed.";
     clearProductLayout();
@@ -106,7 +124,10 @@ void CustomerWindow::on_categoriesListWidget_currentItemChanged(QListWidgetItem
 
     int categoryId = current->data(Qt::UserRole).toInt();
     qDebug() << "CustomerWindow: Fetching products for category" << categoryId << "and cart contents for user" << m_currentUserId;
-    m_networkManager.fetchProducts(categoryId);
+    // Сначала загружается только первая страница, остальные - по мере прокрутки
+    m_currentCategoryId = categoryId;
+    m_pageLoading = true;
+    m_networkManager.fetchProductsPage(categoryId, QString(), kProductPageSize);
     m_networkManager.fetchCartContents(m_currentUserId);
 }
 
@@ -124,17 +145,28 @@ void CustomerWindow::clearProductLayout()
     }
 }
 
-void CustomerWindow::handleProductsFetched(bool success, const QJsonArray& products, const QString& errorString)
+void CustomerWindow::handleProductsPageFetched(bool success, int categoryId, const QString& requestedCursor,
+                                               const QJsonArray& products, const QString& nextCursor, const QString& errorString)
 {
-    qDebug() << "CustomerWindow: Products request finished, success:" << success;
-    if (success) {
-        m_currentProducts = products;
-    } else {
+    // Ответ для уже не выбранной категории или повтор уже полученной страницы
+    if (categoryId != m_currentCategoryId || !m_pageLoading || requestedCursor != m_pendingCursor) {
+        return;
+    }
+    qDebug() << "CustomerWindow: Products page finished, success:" << success << "items:" << products.size();
+    m_pageLoading = false;
+    if (!success) {
         QMessageBox::critical(this, "Ошибка загрузки товаров", errorString);
-        m_currentProducts = QJsonArray(); // Очищаем в случае ошибки
     }
-    m_productsRequestFinished = true; // Отмечаем, что запрос завершен
-    tryRenderFilteredProducts(); // Пытаемся отрисовать
+    m_nextCursor = success ? nextCursor : QString();
+
+    if (requestedCursor.isEmpty()) {
+        m_currentProducts = products;
+        m_productsRequestFinished = true; // Отмечаем, что запрос завершен
+        tryRenderFilteredProducts(); // Пытаемся отрисовать
+        return;
+    }
+    appendProductCards(products);
+    loadMoreIfNeeded();
 }
 
 void CustomerWindow::onProductCardAddToCartClicked(int productId)
@@ -201,15 +233,21 @@ void CustomerWindow::tryRenderFilteredProducts()
     qDebug() << "CustomerWindow: Both requests finished. Rendering filtered products.";
 
     clearProductLayout(); // Очищаем сообщение "Загрузка..."
+    m_visibleProductsCount = 0;
+    appendProductCards(m_currentProducts);
+    // Высота списка пересчитывается после обработки событий компоновки
+    QTimer::singleShot(0, this, &CustomerWindow::loadMoreIfNeeded);
+}
 
+void CustomerWindow::appendProductCards(const QJsonArray& products)
+{
     QLayout *layout = ui->verticalLayout;
     if (!layout) {
         qCritical() << "UI layout is null!";
         return;
     }
 
-    int visibleProductsCount = 0;
-    for (const QJsonValue& value : m_currentProducts) {
+    for (const QJsonValue& value : products) {
         QJsonObject productObj = value.toObject();
         int productId = productObj["product_id"].toInt();
 
@@ -217,12 +255,13 @@ void CustomerWindow::tryRenderFilteredProducts()
             continue; // Если товар есть в корзине, пропускаем его
         }
 
-        visibleProductsCount++;
+        m_visibleProductsCount++;
         ProductCard *card = new ProductCard(
             productId,
             productObj["product_name"].toString(),
             productObj["product_description"].toString(),
             productObj["product_price"].toDouble(),
+            productObj["product_stock"].toInt(1),
             productObj["product_image_path"].toString(),
             &m_networkManager,
             ui->productsVerticalLayout // Родитель
@@ -230,10 +269,38 @@ void CustomerWindow::tryRenderFilteredProducts()
         connect(card, &ProductCard::addToCartClicked, this, &CustomerWindow::onProductCardAddToCartClicked);
         layout->addWidget(card);
     }
+}
+
+void CustomerWindow::onProductsScrolled(int value)
+{
+    const QScrollBar *scrollBar = ui->productsScrollArea->verticalScrollBar();
+    if (value >= scrollBar->maximum() - kLoadMoreThresholdPx) {
+        loadNextPage();
+    }
+}
 
-    if (visibleProductsCount == 0) {
+void CustomerWindow::loadNextPage()
+{
+    if (m_pageLoading || m_nextCursor.isEmpty() || !m_productsRequestFinished || !m_cartRequestFinished) {
+        return;
+    }
+    m_pageLoading = true;
+    m_pendingCursor = m_nextCursor;
+    m_networkManager.fetchProductsPage(m_currentCategoryId, m_pendingCursor, kProductPageSize);
+}
+
+void CustomerWindow::loadMoreIfNeeded()
+{
+    if (!m_productsRequestFinished || !m_cartRequestFinished || m_pageLoading) {
+        return;
+    }
+    if (!m_nextCursor.isEmpty()) {
+        onProductsScrolled(ui->productsScrollArea->verticalScrollBar()->value());
+        return;
+    }
+    if (m_visibleProductsCount == 0 && ui->verticalLayout->count() == 0) {
         QLabel* emptyLabel = new QLabel("В данной категории нет доступных для покупки товаров.", this);
         emptyLabel->setAlignment(Qt::AlignCenter);
-        layout->addWidget(emptyLabel);
+        ui->verticalLayout->addWidget(emptyLabel);
     }
 }
@@ -24,7 +24,8 @@ public:
 private slots:
     // Слоты для NetworkManager
     void handleCategoriesFetched(bool success, const QJsonArray& categories, const QString& errorString);
-    void handleProductsFetched(bool success, const QJsonArray& products, const QString& errorString);
+    void handleProductsPageFetched(bool success, int categoryId, const QString& requestedCursor,
+                                   const QJsonArray& products, const QString& nextCursor, const QString& errorString);
     void handleCartActionCompleted(bool success, const QString& message, const QString& errorString);
     void handleCartContentsFetched(bool success, const QJsonObject& cartData, const QString& errorString);
 
@@ -33,6 +34,8 @@ private slots:
     void on_actionViewCart_triggered();
     void onProductCardAddToCartClicked(int productId);
     void refreshProducts();
+    // Подгрузка следующей страницы, когда список прокручен почти до конца
+    void onProductsScrolled(int value);
 
 private:
     Ui::CustumerWindow *ui; // Указатель на UI форму CustumerWindow
@@ -40,7 +43,12 @@ private:
     int m_currentUserId;
     QString m_currentUserRole;
 
-    QJsonArray m_currentProducts;      // Хранит ответ от /products
+    QJsonArray m_currentProducts;      // Первая страница ответа /products
+    int        m_currentCategoryId = -1;
+    QString    m_nextCursor;           // Курсор следующей страницы; пусто - страниц больше нет
+    QString    m_pendingCursor;        // Курсор страницы, которая сейчас загружается
+    bool       m_pageLoading = false;
+    int        m_visibleProductsCount = 0;
     QSet<int>  m_cartProductIds;       // Хранит ID товаров в корзине
     bool       m_productsRequestFinished = false; // Флаг завершения запроса товаров
     bool       m_cartRequestFinished = false;     // Флаг завершения запроса корзины
@@ -49,6 +57,10 @@ private:
     void populateCategories(const QJsonArray& categories);
     void clearProductLayout(); // Очистка карточек товаров
     void tryRenderFilteredProducts();
+    void appendProductCards(const QJsonArray& products);
+    void loadNextPage();
+    // Догружает страницы, пока карточки не заполнят видимую область, и показывает пустое состояние
+    void loadMoreIfNeeded();
 };
 
 #endif // CUSTOMERWINDOW_H
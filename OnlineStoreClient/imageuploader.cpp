@@ -0,0 +1,159 @@
+#include "imageuploader.h"
+#include "networkmanager.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+constexpr int kMaxRetries = 5;
+constexpr int kRetryDelayMs = 1000;
+}
+
+ImageUploader::ImageUploader(QNetworkAccessManager *nam, const QString &baseUrl, const QString &filePath,
+                             QObject *parent)
+    : QObject(parent),
+    m_nam(nam),
+    m_baseUrl(baseUrl),
+    m_file(filePath),
+    m_retriesLeft(kMaxRetries)
+{
+}
+
+void ImageUploader::start()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        // Откладываем, чтобы вызывающий код успел подключиться к finished
+        QTimer::singleShot(0, this, [this]() { finish(false, QString(), "Не удалось открыть файл: " + m_file.errorString()); });
+        return;
+    }
+    createUpload();
+}
+
+void ImageUploader::createUpload()
+{
+    QJsonObject json;
+    json["size"] = m_file.size();
+
+    QNetworkRequest request(QUrl(m_baseUrl + "/uploads"));
+
+    request.setRawHeader("Authorization", NetworkManager::authorizationHeader());
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+
+    QNetworkReply *reply = m_nam->post(request, QJsonDocument(json).toJson());
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        const QByteArray data = reply->readAll();
+        if (reply->error() != QNetworkReply::NoError) {
+            finish(false, QString(), reply->errorString() + " | Response: " + QString::fromUtf8(data.left(100)));
+            return;
+        }
+        const QJsonObject json = QJsonDocument::fromJson(data).object();
+        m_uploadId = json.value("upload_id").toString();
+        if (m_uploadId.isEmpty()) {
+            finish(false, QString(), "Сервер не вернул идентификатор загрузки.");
+            return;
+        }
+        const qint64 serverChunk = json.value("max_chunk_bytes").toInteger();
+        if (serverChunk > 0) {
+            m_chunkSize = qMin(m_chunkSize, serverChunk);
+        }
+        m_offset = 0;
+        sendNextChunk();
+    });
+}
+
+void ImageUploader::sendNextChunk()
+{
+    if (m_offset >= m_file.size()) {
+        finalize();
+        return;
+    }
+
+    if (!m_file.seek(m_offset)) {
+        finish(false, QString(), "Ошибка чтения файла: " + m_file.errorString());
+        return;
+    }
+    const QByteArray chunk = m_file.read(m_chunkSize);
+
+    QNetworkRequest request(QUrl(m_baseUrl + "/uploads/" + m_uploadId));
+
+    request.setRawHeader("Authorization", NetworkManager::authorizationHeader());
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+    request.setRawHeader("Upload-Offset", QByteArray::number(m_offset));
+
+    QNetworkReply *reply = m_nam->sendCustomRequest(request, "PATCH", chunk);
+    connect(reply, &QNetworkReply::uploadProgress, this, [this](qint64 sent, qint64) {
+        emit progress(m_offset + sent, m_file.size());
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() == QNetworkReply::NoError && status == 204) {
+            m_offset = reply->rawHeader("Upload-Offset").toLongLong();
+            m_retriesLeft = kMaxRetries;
+            emit progress(m_offset, m_file.size());
+            sendNextChunk();
+        } else if (status == 404 || status == 413) {
+            finish(false, QString(), reply->errorString() + " | Response: " + QString::fromUtf8(reply->readAll().left(100)));
+        } else {
+            resume(reply->errorString());
+        }
+    });
+}
+
+void ImageUploader::resume(const QString &errorString)
+{
+    if (m_retriesLeft-- <= 0) {
+        finish(false, QString(), "Загрузка прервана: " + errorString);
+        return;
+    }
+    qWarning() << "ImageUploader: Chunk failed, resuming:" << errorString;
+
+    const int delayMs = kRetryDelayMs * (kMaxRetries - m_retriesLeft);
+    QTimer::singleShot(delayMs, this, [this, errorString]() {
+        QNetworkRequest request(QUrl(m_baseUrl + "/uploads/" + m_uploadId));
+        request.setRawHeader("Authorization", NetworkManager::authorizationHeader());
+        QNetworkReply *reply = m_nam->get(request);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, errorString]() {
+            reply->deleteLater();
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (reply->error() == QNetworkReply::NoError) {
+                m_offset = QJsonDocument::fromJson(reply->readAll()).object().value("offset").toInteger();
+                sendNextChunk();
+            } else if (status == 404) {
+                finish(false, QString(), "Загрузка не найдена на сервере: " + errorString);
+            } else {
+                resume(reply->errorString());
+            }
+        });
+    });
+}
+
+void ImageUploader::finalize()
+{
+    QNetworkRequest request(QUrl(m_baseUrl + "/uploads/" + m_uploadId + "/finalize"));
+    request.setRawHeader("Authorization", NetworkManager::authorizationHeader());
+    QNetworkReply *reply = m_nam->post(request, QByteArray());
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        const QByteArray data = reply->readAll();
+        if (reply->error() != QNetworkReply::NoError) {
+            finish(false, QString(), reply->errorString() + " | Response: " + QString::fromUtf8(data.left(100)));
+            return;
+        }
+        const QString imagePath = QJsonDocument::fromJson(data).object().value("image_path").toString();
+        if (imagePath.isEmpty()) {
+            finish(false, QString(), "Сервер не вернул путь к изображению.");
+        } else {
+            finish(true, imagePath, QString());
+        }
+    });
+}
+
+void ImageUploader::finish(bool success, const QString &imagePath, const QString &errorString)
+{
+    m_file.close();
+    emit finished(success, imagePath, errorString);
+    deleteLater();
+}
@@ -0,0 +1,43 @@
+#ifndef IMAGEUPLOADER_H
+#define IMAGEUPLOADER_H
+
+#include <QObject>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+// Загрузка изображения на сервер частями по протоколу /uploads.
+// Файл читается с диска по одному фрагменту; после сетевой ошибки загрузка
+// продолжается с последнего смещения, подтвержденного сервером.
+// Объект удаляет себя сам после сигнала finished.
+class ImageUploader : public QObject
+{
+    Q_OBJECT
+public:
+    ImageUploader(QNetworkAccessManager *nam, const QString &baseUrl, const QString &filePath,
+                  QObject *parent = nullptr);
+
+    void start();
+
+signals:
+    void progress(qint64 bytesSent, qint64 bytesTotal);
+    void finished(bool success, const QString &imagePath, const QString &errorString);
+
+private:
+    void createUpload();
+    void sendNextChunk();
+    void finalize();
+    // Узнает у сервера фактическое смещение и повторяет отправку с него
+    void resume(const QString &errorString);
+    void finish(bool success, const QString &imagePath, const QString &errorString);
+
+    QNetworkAccessManager *m_nam;
+    QString m_baseUrl;
+    QFile m_file;
+    QString m_uploadId;
+    qint64 m_offset = 0;
+    qint64 m_chunkSize = 512 * 1024;
+    int m_retriesLeft = 0;
+};
+
+#endif // IMAGEUPLOADER_H
@@ -5,6 +5,8 @@
 NetworkManager::NetworkManager(QObject *parent) : QObject(parent)
 {
     m_nam = new QNetworkAccessManager(this);
+    m_refreshTimer.setSingleShot(true);
+    connect(&m_refreshTimer, &QTimer::timeout, this, &NetworkManager::refreshAccessToken);
 }
 
 void NetworkManager::setBaseUrl(const QString &baseUrl)
@@ -15,6 +17,51 @@ void NetworkManager::setBaseUrl(const QString &baseUrl)
     }
 }
 
+QByteArray NetworkManager::s_accessToken;
+QByteArray NetworkManager::s_refreshToken;
+
+QByteArray NetworkManager::authorizationHeader()
+{
+    return s_accessToken.isEmpty() ? QByteArray() : "Bearer " + s_accessToken;
+}
+
+QNetworkRequest NetworkManager::createRequest(const QUrl& url) const
+{
+    QNetworkRequest request(url);
+    // После входа каждый запрос предъявляет токен доступа вместо пароля
+    if (!s_accessToken.isEmpty()) {
+        request.setRawHeader("Authorization", authorizationHeader());
+    }
+    return request;
+}
+
+void NetworkManager::scheduleTokenRefresh(qint64 expiresInSeconds)
+{
+    // Обновляем заранее, на 80% срока, чтобы запросы не успели получить 401
+    m_refreshTimer.start(qMax<qint64>(1000, expiresInSeconds * 800));
+}
+
+void NetworkManager::refreshAccessToken()
+{
+    if (s_refreshToken.isEmpty()) {
+        return;
+    }
+    QNetworkRequest request(QUrl(m_baseUrl + "/token/refresh"));
+    request.setRawHeader("Authorization", "Bearer " + s_refreshToken);
+
+    QNetworkReply *reply = m_nam->post(request, QByteArray());
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        handleJsonResponse(reply, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
+            if (success && doc.isObject()) {
+                s_accessToken = doc.object().value("access_token").toString().toLatin1();
+                scheduleTokenRefresh(doc.object().value("expires_in").toInteger());
+            } else {
+                qWarning() << "NetworkManager: Failed to refresh access token:" << errorStr;
+            }
+        });
+    });
+}
+
 void NetworkManager::handleJsonResponse(QNetworkReply* reply,
                                         std::function<void(bool, const QJsonDocument&, const QString&)> callback)
 {
@@ -61,6 +108,9 @@ void NetworkManager::login(const QString &username, const QString &password)
     connect(reply, &QNetworkReply::finished, this, [this, reply]() {
         handleJsonResponse(reply, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
             if (success && doc.isObject()) {
+                s_accessToken = doc.object().value("access_token").toString().toLatin1();
+                s_refreshToken = doc.object().value("refresh_token").toString().toLatin1();
+                scheduleTokenRefresh(doc.object().value("expires_in").toInteger());
                 emit loginCompleted(true, doc.object());
             } else {
                 emit loginCompleted(false, QJsonObject(), errorStr.isEmpty() ? "Login failed or invalid server response" : errorStr);
@@ -69,18 +119,56 @@ void NetworkManager::login(const QString &username, const QString &password)
     });
 }
 
-void NetworkManager::fetchCategories()
+void NetworkManager::getJsonWithValidators(const QUrl& url,
+                                           std::function<void(bool, const QJsonDocument&, const QString&)> callback)
 {
-    QNetworkRequest request(QUrl(m_baseUrl + "/categories"));
+    const QString key = url.toString();
+    QNetworkRequest request = createRequest(url);
+    auto cached = m_validatedResponses.constFind(key);
+    if (cached != m_validatedResponses.constEnd()) {
+        request.setRawHeader("If-None-Match", cached->etag);
+    }
+
     QNetworkReply *reply = m_nam->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        handleJsonResponse(reply, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
-            if (success && doc.isArray()) {
-                emit categoriesFetched(true, doc.array());
+    connect(reply, &QNetworkReply::finished, this, [this, reply, key, callback]() {
+        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() != QNetworkReply::NoError) {
+            handleJsonResponse(reply, callback); // Общая обработка ошибок
+            return;
+        }
+
+        QByteArray data;
+        if (statusCode == 304 && m_validatedResponses.contains(key)) {
+            data = m_validatedResponses.value(key).body; // Данные не изменились - тело не передавалось
+        } else {
+            data = reply->readAll();
+            const QByteArray etag = reply->rawHeader("ETag");
+            if (!etag.isEmpty()) {
+                m_validatedResponses.insert(key, {etag, data});
             } else {
-                emit categoriesFetched(false, QJsonArray(), errorStr.isEmpty() ? "Failed to fetch categories" : errorStr);
+                m_validatedResponses.remove(key);
             }
-        });
+        }
+        reply->deleteLater();
+
+        QJsonParseError parseError;
+        QJsonDocument jsonDoc = QJsonDocument::fromJson(data, &parseError);
+        if (parseError.error == QJsonParseError::NoError && (jsonDoc.isObject() || jsonDoc.isArray())) {
+            callback(true, jsonDoc, QString());
+        } else {
+            callback(false, QJsonDocument(), "JSON Parse Error: " + parseError.errorString() + "\nData: " + QString::fromUtf8(data.left(100)));
+        }
+    });
+}
+
+void NetworkManager::fetchCategories()
+{
+    getJsonWithValidators(QUrl(m_baseUrl + "/categories"), [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
+        if (success && doc.isArray()) {
+            emit categoriesFetched(true, doc.array());
+        } else {
+            emit categoriesFetched(false, QJsonArray(), errorStr.isEmpty() ? "Failed to fetch categories" : errorStr);
+        }
     });
 }
 
@@ -91,20 +179,39 @@ void NetworkManager::fetchProducts(int categoryId)
     query.addQueryItem("category_id", QString::number(categoryId));
     url.setQuery(query);
 
-    QNetworkRequest request(url);
-    QNetworkReply *reply = m_nam->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        handleJsonResponse(reply, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
-            if (success && doc.isArray()) {
-                emit productsFetched(true, doc.array());
-            } else {
-                emit productsFetched(false, QJsonArray(), errorStr.isEmpty() ? "Failed to fetch products" : errorStr);
-            }
-        });
+    getJsonWithValidators(url, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
+        if (success && doc.isArray()) {
+            emit productsFetched(true, doc.array());
+        } else {
+            emit productsFetched(false, QJsonArray(), errorStr.isEmpty() ? "Failed to fetch products" : errorStr);
+        }
+    });
+}
+
+void NetworkManager::fetchProductsPage(int categoryId, const QString& cursor, int limit)
+{
+    QUrl url(m_baseUrl + "/products");
+    QUrlQuery query;
+    query.addQueryItem("category_id", QString::number(categoryId));
+    query.addQueryItem("limit", QString::number(limit));
+    if (!cursor.isEmpty()) {
+        query.addQueryItem("cursor", cursor);
+    }
+    url.setQuery(query);
+
+    getJsonWithValidators(url, [this, categoryId, cursor](bool success, const QJsonDocument& doc, const QString& errorStr) {
+        if (success && doc.isObject()) {
+            const QJsonObject page = doc.object();
+            emit productsPageFetched(true, categoryId, cursor, page.value("items").toArray(),
+                                     page.value("next_cursor").toString());
+        } else {
+            emit productsPageFetched(false, categoryId, cursor, QJsonArray(), QString(),
+                                     errorStr.isEmpty() ? "Failed to fetch products" : errorStr);
+        }
     });
 }
 
-QNetworkReply* NetworkManager::fetchImage(const QString& imageUrl)
+QNetworkReply* NetworkManager::fetchImage(const QString& imageUrl, int width)
 {
     QUrl url;
     if (imageUrl.startsWith("http://", Qt::CaseInsensitive) || imageUrl.startsWith("https://", Qt::CaseInsensitive)) {
@@ -115,6 +222,11 @@ QNetworkReply* NetworkManager::fetchImage(const QString& imageUrl)
         url.setPort(8080);
         url.setPath(imageUrl);
     }
+    if (width > 0) {
+        QUrlQuery query(url);
+        query.addQueryItem("w", QString::number(width));
+        url.setQuery(query);
+    }
     qDebug() << "NetworkManager: Fetching image from" << url.toString();
     return m_nam->get(QNetworkRequest(url));
 }
@@ -125,7 +237,7 @@ void NetworkManager::addProductToCart(int userId, int productId)
     json["user_id"] = userId;
     json["product_id"] = productId;
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/cart"));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/cart"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
     QNetworkReply *reply = m_nam->post(request, QJsonDocument(json).toJson());
 
@@ -148,6 +260,10 @@ void NetworkManager::addProductToCart(int userId, int productId)
         } else {
             errorMsg = reply->errorString() + " | " + QString::fromUtf8(reply->readAll().left(200));
         }
+        // 409: товар закончился, пока пользователь смотрел каталог
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 409) {
+            errorMsg = "Товар закончился. Обновите каталог.";
+        }
         emit cartActionCompleted(success, successMessage, errorMsg);
         reply->deleteLater();
     });
@@ -160,7 +276,7 @@ void NetworkManager::fetchCartContents(int userId)
     query.addQueryItem("user_id", QString::number(userId));
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     QNetworkReply *reply = m_nam->get(request);
     connect(reply, &QNetworkReply::finished, this, [this, reply]() {
         handleJsonResponse(reply, [this](bool success, const QJsonDocument& doc, const QString& errorStr) {
@@ -181,7 +297,7 @@ void NetworkManager::removeFromCart(int userId, int productId)
     query.addQueryItem("product_id", QString::number(productId));
     url.setQuery(query);
 
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     QNetworkReply *reply = m_nam->deleteResource(request); // Используем deleteResource для метода DELETE
 
     connect(reply, &QNetworkReply::finished, this, [this, reply]() {
@@ -207,7 +323,7 @@ void NetworkManager::placeOrder(int userId)
     json["user_id"] = userId;
 
     // 2. Создаем и настраиваем запрос
-    QNetworkRequest request(QUrl(m_baseUrl + "/order"));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/order"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     // 3. Отправляем POST-запрос
@@ -239,6 +355,10 @@ void NetworkManager::placeOrder(int userId)
             // Произошла сетевая ошибка (например, нет соединения с сервером)
             errorMsg = reply->errorString() + " | " + QString::fromUtf8(reply->readAll().left(200));
         }
+        // 409: часть товаров корзины раскупили, пока резерв был просрочен
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 409) {
+            errorMsg = "Некоторых товаров из корзины больше нет в наличии. Удалите их и повторите заказ.";
+        }
 
         // 5. Испускаем сигнал с результатом операции
         emit orderPlaced(success, successMessage, errorMsg);
@@ -253,7 +373,7 @@ void NetworkManager::addCategory(const QString& categoryName)
     QJsonObject json;
     json["category_name"] = categoryName;
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/categories"));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/categories"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     QNetworkReply *reply = m_nam->post(request, QJsonDocument(json).toJson());
@@ -270,24 +390,48 @@ void NetworkManager::addCategory(const QString& categoryName)
 
 void NetworkManager::deleteCategory(int categoryId)
 {
-    QNetworkRequest request(QUrl(m_baseUrl + "/categories/" + QString::number(categoryId)));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/categories/" + QString::number(categoryId)));
     QNetworkReply *reply = m_nam->deleteResource(request);
 
     connect(reply, &QNetworkReply::finished, this, [this, reply, categoryId]() {
-        QString errorMsg;
-        // 204 No Content - стандартный успешный ответ на DELETE
-        bool success = (reply->error() == QNetworkReply::NoError &&
-                        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 204);
+        // 202 Accepted: сервер удаляет категорию в фоне и возвращает id задачи
+        handleJsonResponse(reply, [this, categoryId](bool success, const QJsonDocument& doc, const QString& errorStr) {
+            const QString jobId = doc.object().value("job_id").toString();
+            if (success && !jobId.isEmpty()) {
+                pollCategoryDeletion(jobId, categoryId);
+            } else {
+                emit adminActionCompleted(false, "delete_category", "", success ? "Сервер не вернул id задачи" : errorStr);
+            }
+        });
+    });
+}
 
-        if (!success) errorMsg = reply->errorString();
-        emit adminActionCompleted(success, "delete_category", "Категория (ID: " + QString::number(categoryId) + ") удалена.", errorMsg);
-        reply->deleteLater();
+void NetworkManager::pollCategoryDeletion(const QString& jobId, int categoryId)
+{
+    QNetworkReply *reply = m_nam->get(createRequest(QUrl(m_baseUrl + "/jobs/" + jobId)));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, jobId, categoryId]() {
+        handleJsonResponse(reply, [this, jobId, categoryId](bool success, const QJsonDocument& doc, const QString& errorStr) {
+            if (!success) {
+                emit adminActionCompleted(false, "delete_category", "", errorStr);
+                return;
+            }
+            const QJsonObject job = doc.object();
+            const QString state = job.value("state").toString();
+            if (state == "succeeded") {
+                emit adminActionCompleted(true, "delete_category", "Категория (ID: " + QString::number(categoryId) + ") удалена.");
+            } else if (state == "failed") {
+                emit adminActionCompleted(false, "delete_category", "", job.value("error").toString());
+            } else {
+                emit categoryDeletionProgress(categoryId, job.value("processed").toInteger());
+                QTimer::singleShot(500, this, [this, jobId, categoryId]() { pollCategoryDeletion(jobId, categoryId); });
+            }
+        });
     });
 }
 
 void NetworkManager::addProduct(const QJsonObject& productData)
 {
-    QNetworkRequest request(QUrl(m_baseUrl + "/products"));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/products"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     QNetworkReply *reply = m_nam->post(request, QJsonDocument(productData).toJson());
@@ -304,7 +448,7 @@ void NetworkManager::addProduct(const QJsonObject& productData)
 
 void NetworkManager::deleteProduct(int productId)
 {
-    QNetworkRequest request(QUrl(m_baseUrl + "/products/" + QString::number(productId)));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/products/" + QString::number(productId)));
     QNetworkReply *reply = m_nam->deleteResource(request);
 
     connect(reply, &QNetworkReply::finished, this, [this, reply, productId]() {
@@ -323,7 +467,7 @@ void NetworkManager::updateProductField(int productId, const QString& fieldName,
     QJsonObject json;
     json[fieldName] = QJsonValue::fromVariant(value);
 
-    QNetworkRequest request(QUrl(m_baseUrl + "/products/" + QString::number(productId)));
+    QNetworkRequest request = createRequest(QUrl(m_baseUrl + "/products/" + QString::number(productId)));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     // Для метода PATCH используем sendCustomRequest
@@ -339,19 +483,13 @@ void NetworkManager::updateProductField(int productId, const QString& fieldName,
     });
 }
 
-QNetworkReply* NetworkManager::uploadImage(const QByteArray& imageData, const QString& fileName)
+ImageUploader* NetworkManager::uploadImage(const QString& filePath)
 {
-    Q_UNUSED(fileName); // fileName может пригодиться для Content-Disposition, но пока не используем
-
-    QNetworkRequest request(QUrl(m_baseUrl + "/upload/image"));
-    // Устанавливаем тип контента, чтобы сервер знал, что это изображение.
-    // Можно использовать "application/octet-stream" для любых бинарных данных.
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "image/jpeg");
-
-    // Отправляем сырые байты изображения в теле POST-запроса
-    // Ответ (QNetworkReply) возвращается напрямую, чтобы вызывающий код мог
-    // подключиться к его сигналу finished() и получить путь к загруженному файлу.
-    return m_nam->post(request, imageData);
+    // Файл отправляется фрагментами через /uploads, поэтому целиком в память не читается,
+    // а после обрыва соединения загрузка продолжается с места остановки
+    ImageUploader *uploader = new ImageUploader(m_nam, m_baseUrl, filePath, this);
+    uploader->start();
+    return uploader;
 }
 
 void NetworkManager::changeProductCategory(int productId, int oldCategoryId, int newCategoryId)
@@ -361,7 +499,7 @@ void NetworkManager::changeProductCategory(int productId, int oldCategoryId, int
     json["new_category_id"] = newCategoryId;
 
     QString url = m_baseUrl + "/products/" + QString::number(productId) + "/category_link";
-    QNetworkRequest request(url);
+    QNetworkRequest request = createRequest(url);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
 
     QNetworkReply *reply = m_nam->sendCustomRequest(request, "PATCH", QJsonDocument(json).toJson());
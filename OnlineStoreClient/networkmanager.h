@@ -9,7 +9,10 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QUrl>
+#include <QHash>
+#include <QTimer>
 #include <functional> // Для std::function
+#include "imageuploader.h"
 
 class NetworkManager : public QObject
 {
@@ -18,17 +21,22 @@ public:
     explicit NetworkManager(QObject *parent = nullptr);
 
     void setBaseUrl(const QString& baseUrl);
+    // Значение заголовка Authorization с текущим токеном доступа (пусто до входа)
+    static QByteArray authorizationHeader();
 
     // --- Методы для пользователя ---
     void login(const QString& username, const QString& password);
     void fetchCategories();
     void fetchProducts(int categoryId);
+    // Страница товаров категории; cursor пустой для первой страницы
+    void fetchProductsPage(int categoryId, const QString& cursor, int limit);
     void fetchCartContents(int userId);
     void addProductToCart(int userId, int productId);
     void removeFromCart(int userId, int productId);
     void placeOrder(int userId);
     QJsonObject getCartContents(int userId);
-    QNetworkReply* fetchImage(const QString& imageUrl);
+    // width > 0 запрашивает у сервера уменьшенный вариант изображения не уже этой ширины
+    QNetworkReply* fetchImage(const QString& imageUrl, int width = 0);
 
     // --- Методы для администратора ---
     void addCategory(const QString& categoryName);
@@ -36,7 +44,8 @@ public:
     void addProduct(const QJsonObject& productData);
     void deleteProduct(int productId);
     void updateProductField(int productId, const QString& fieldName, const QVariant& value);
-    QNetworkReply* uploadImage(const QByteArray& imageData, const QString& fileName); // Добавлен fileName для Content-Disposition
+    // Загружает файл частями; результат и прогресс приходят сигналами возвращенного объекта
+    ImageUploader* uploadImage(const QString& filePath);
     void changeProductCategory(int productId, int oldCategoryId, int newCategoryId);
 
 
@@ -45,6 +54,9 @@ signals:
     void loginCompleted(bool success, const QJsonObject& userData, const QString& errorString = "");
     void categoriesFetched(bool success, const QJsonArray& categories, const QString& errorString = "");
     void productsFetched(bool success, const QJsonArray& products, const QString& errorString = "");
+    // nextCursor пустой, если страница последняя; requestedCursor - курсор, с которым страница запрошена
+    void productsPageFetched(bool success, int categoryId, const QString& requestedCursor, const QJsonArray& products,
+                             const QString& nextCursor, const QString& errorString = "");
     void cartContentsFetched(bool success, const QJsonObject& cartData, const QString& errorString = "");
     void cartActionCompleted(bool success, const QString& message, const QString& errorString = "");
     void productRemovedFromCart(bool success, const QString& message, const QString& errorString = "");
@@ -52,11 +64,39 @@ signals:
 
     // --- Общий сигнал для админ-действий ---
     void adminActionCompleted(bool success, const QString& action, const QString& message, const QString& errorString = "");
+    // Ход фоновой задачи удаления категории (processed - обработано товаров)
+    void categoryDeletionProgress(int categoryId, qint64 processed);
 
 
 private:
+    // Запрос с заголовком Authorization, если пользователь уже вошел
+    QNetworkRequest createRequest(const QUrl& url) const;
+
     void handleJsonResponse(QNetworkReply* reply,
                             std::function<void(bool, const QJsonDocument&, const QString&)> callback);
+    // GET с условным запросом: отправляет If-None-Match и на 304 отдает сохраненное тело
+    void getJsonWithValidators(const QUrl& url,
+                               std::function<void(bool, const QJsonDocument&, const QString&)> callback);
+
+    struct ValidatedResponse
+    {
+        QByteArray etag;
+        QByteArray body;
+    };
+    QHash<QString, ValidatedResponse> m_validatedResponses; // Ключ - полный URL запроса
+
+    // Обновляет токен доступа по токену сессии незадолго до истечения
+    void refreshAccessToken();
+    void scheduleTokenRefresh(qint64 expiresInSeconds);
+
+    // Опрашивает GET /jobs/<id> удаления категории, пока задача не завершится
+    void pollCategoryDeletion(const QString& jobId, int categoryId);
+
+    // Токены общие для всех экземпляров: у каждого окна свой NetworkManager.
+    // Токен доступа подписан сервером и живет недолго, токен сессии нужен только для его обновления.
+    static QByteArray s_accessToken;
+    static QByteArray s_refreshToken;
+    QTimer m_refreshTimer;
 
     QNetworkAccessManager *m_nam;
     QString m_baseUrl = "http://localhost:8080"; // Сервер по умолчанию
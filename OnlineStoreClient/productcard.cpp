@@ -4,7 +4,7 @@
 #include <QDebug>
 
 ProductCard::ProductCard(int productId, const QString &name, const QString &description,
-                         double price, const QString &imageUrl,
+                         double price, int stock, const QString &imageUrl,
                          NetworkManager *networkManager, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::ProductCard),
@@ -17,10 +17,15 @@ ProductCard::ProductCard(int productId, const QString &name, const QString &desc
     ui->nameLabel->setText(name);
     ui->descriptionLabel->setText(description.left(100) + (description.length() > 100 ? "..." : "")); // Ограничиваем описание
     ui->priceLabel->setText(QString::number(price, 'f', 2) + " руб.");
+    // Остаток в каталоге обновляется с небольшой задержкой; окончательно наличие проверит сервер
+    if (stock <= 0) {
+        ui->addToCartButton->setEnabled(false);
+        ui->addToCartButton->setText("Нет в наличии");
+    }
 
     // Загрузка изображения
     if (m_networkManager && !m_imageUrl.isEmpty()) {
-        QNetworkReply* reply = m_networkManager->fetchImage(m_imageUrl);
+        QNetworkReply* reply = m_networkManager->fetchImage(m_imageUrl, 256);
         if (reply) { // fetchImage теперь возвращает QNetworkReply*
             connect(reply, &QNetworkReply::finished, this, [this, reply](){
                 onImageFetched(reply);
@@ -15,7 +15,7 @@ class ProductCard : public QWidget
 
 public:
     explicit ProductCard(int productId, const QString &name, const QString &description,
-                         double price, const QString &imageUrl,
+                         double price, int stock, const QString &imageUrl,
                          NetworkManager *networkManager, // Передаем NetworkManager
                          QWidget *parent = nullptr);
     ~ProductCard();
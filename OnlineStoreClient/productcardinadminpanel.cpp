@@ -35,12 +35,13 @@ void ProductCardInAdminPanel::updateUi()
     ui->productIdLabel->setText("ID: " + QString::number(m_productId));
     ui->productNamelabel->setText(m_productData["product_name"].toString());
     ui->productDescriptionLabel->setText(m_productData["product_description"].toString());
-    ui->productPriceLabel->setText("Цена: " + QString::number(m_productData["product_price"].toDouble(), 'f', 2) + " руб.");
+    ui->productPriceLabel->setText("Цена: " + QString::number(m_productData["product_price"].toDouble(), 'f', 2) + " руб."
+                                   + " | На складе: " + QString::number(m_productData["product_stock"].toInt()));
 
     // Загрузка изображения
     QString imageUrl = m_productData["product_image_path"].toString();
     if (m_networkManager && !imageUrl.isEmpty()) {
-        QNetworkReply* reply = m_networkManager->fetchImage(imageUrl);
+        QNetworkReply* reply = m_networkManager->fetchImage(imageUrl, 256);
         if (reply) {
             connect(reply, &QNetworkReply::finished, this, [this, reply](){ onImageFetched(reply); });
         }
@@ -155,59 +156,43 @@ void ProductCardInAdminPanel::on_btnChangePrice_clicked()
     }
 }
 
-void ProductCardInAdminPanel::on_btnChangeImage_clicked()
+void ProductCardInAdminPanel::on_btnChangeStock_clicked()
 {
-    QString filePath = QFileDialog::getOpenFileName(this, "Выбрать новое изображение", "", "Images (*.jpg)");
-    if (filePath.isEmpty()) return;
-
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::critical(this, "Ошибка", "Не удалось открыть файл изображения.");
-        return;
+    bool ok;
+    int newStock = QInputDialog::getInt(this, "Изменить остаток", "Количество на складе:", m_productData["product_stock"].toInt(), 0, 1000000, 1, &ok);
+    if (ok) {
+        updateProductField("product_stock", newStock);
     }
-    QByteArray imageData = file.readAll();
-    QFileInfo fileInfo(filePath);
-
-    QNetworkReply* reply = m_networkManager->uploadImage(imageData, fileInfo.fileName());
-    connect(reply, &QNetworkReply::finished, this, [this, reply](){ onImageUploaded(reply); });
 }
 
-void ProductCardInAdminPanel::onImageUploaded(QNetworkReply* reply)
+void ProductCardInAdminPanel::on_btnChangeImage_clicked()
 {
-    bool success;
-    QJsonDocument doc;
-    QString errorStr;
-    // Используем лямбду для обработки JSON
-    auto callback = [&](bool s, const QJsonDocument& d, const QString& e) {
-        success = s;
-        doc = d;
-        errorStr = e;
-    };
-    // Это вспомогательный обработчик, который нужно будет создать в NetworkManager или здесь
-    // Пока что реализуем логику прямо тут:
-    if (reply->error() == QNetworkReply::NoError) {
-        QJsonParseError parseError;
-        doc = QJsonDocument::fromJson(reply->readAll(), &parseError);
-        success = (parseError.error == QJsonParseError::NoError);
-        if (!success) errorStr = "JSON Parse Error: " + parseError.errorString();
-    } else {
-        success = false;
-        errorStr = reply->errorString();
-    }
-
+    QString filePath = QFileDialog::getOpenFileName(this, "Выбрать новое изображение", "", "Images (*.jpg *.jpeg *.png *.gif *.webp)");
+    if (filePath.isEmpty()) return;
 
-    if (success && doc.isObject()) {
-        QString newPath = doc.object()["image_path"].toString();
-        if (!newPath.isEmpty()) {
-            updateProductField("product_image_path", newPath);
-        } else {
-            QMessageBox::critical(this, "Ошибка", "Сервер не вернул путь к изображению.");
+    ImageUploader* uploader = m_networkManager->uploadImage(filePath);
+    ui->btnChangeImage->setEnabled(false);
+    const QString buttonText = ui->btnChangeImage->text();
+    connect(uploader, &ImageUploader::progress, this, [this](qint64 sent, qint64 total) {
+        if (total > 0) {
+            ui->btnChangeImage->setText(QString("%1%").arg(sent * 100 / total));
         }
+    });
+    connect(uploader, &ImageUploader::finished, this,
+            [this, buttonText](bool success, const QString& imagePath, const QString& errorString) {
+        ui->btnChangeImage->setText(buttonText);
+        ui->btnChangeImage->setEnabled(true);
+        onImageUploaded(success, imagePath, errorString);
+    });
+}
+
+void ProductCardInAdminPanel::onImageUploaded(bool success, const QString& imagePath, const QString& errorString)
+{
+    if (success) {
+        updateProductField("product_image_path", imagePath);
     } else {
-        QMessageBox::critical(this, "Ошибка загрузки изображения", errorStr);
+        QMessageBox::critical(this, "Ошибка загрузки изображения", errorString);
     }
-
-    reply->deleteLater();
 }
 
 void ProductCardInAdminPanel::updateProductField(const QString& fieldName, const QVariant& value)
@@ -35,12 +35,13 @@ private slots:
     void on_btnChangeName_clicked();
     void on_btnChangeDescription_clicked();
     void on_btnChangePrice_clicked();
+    void on_btnChangeStock_clicked();
     void on_btnChangeImage_clicked();
     void on_comboBoxCategories_currentIndexChanged(int index);
 
     // Слоты для обработки ответов от NetworkManager
     void onImageFetched(QNetworkReply* reply);
-    void onImageUploaded(QNetworkReply* reply);
+    void onImageUploaded(bool success, const QString& imagePath, const QString& errorString);
 
 private:
     Ui::ProductCardInAdminPanel *ui;
@@ -17,7 +17,7 @@ ProductCardInCart::ProductCardInCart(int productId, const QString &name, double
     ui->productPriceLabel->setText("Цена: " + QString::number(price, 'f', 2) + " руб.");
 
     if (networkManager && !imageUrl.isEmpty()) {
-        QNetworkReply* reply = networkManager->fetchImage(imageUrl);
+        QNetworkReply* reply = networkManager->fetchImage(imageUrl, 96);
         connect(reply, &QNetworkReply::finished, this, [this, reply](){ onImageFetched(reply); });
     }
 }
@@ -0,0 +1,780 @@
+#include "catalogcache.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Фильтр in_stock проверяется блоками такого размера: сначала вся пачка без ветвлений, потом выдача
+constexpr qsizetype kFilterBlock = 256;
+
+void insertSorted(QList<int> &list, int value)
+{
+    auto it = std::lower_bound(list.begin(), list.end(), value);
+    if (it == list.end() || *it != value) {
+        list.insert(it, value);
+    }
+}
+
+void removeSorted(QList<int> &list, int value)
+{
+    auto it = std::lower_bound(list.begin(), list.end(), value);
+    if (it != list.end() && *it == value) {
+        list.erase(it);
+    }
+}
+
+QJsonObject productJson(const CatalogProduct &product)
+{
+    QJsonObject object;
+    object["product_id"] = product.id;
+    object["product_name"] = product.name;
+    object["product_price"] = product.price;
+    object["product_description"] = product.description;
+    object["product_image_path"] = product.imagePath;
+    object["product_stock"] = product.stock;
+    return object;
+}
+
+// Сравнение (ключ сортировки, product_id) позиции курсора с товаром
+bool cursorBefore(const ProductPageCursor &cursor, const CatalogProduct &product)
+{
+    switch (cursor.sort) {
+    case ProductSort::Price:
+        if (cursor.price != product.price) {
+            return cursor.price < product.price;
+        }
+        break;
+    case ProductSort::Name:
+        if (const int order = cursor.name.compare(product.name)) {
+            return order < 0;
+        }
+        break;
+    case ProductSort::Id:
+        break;
+    }
+    return cursor.id < product.id;
+}
+
+QString sortName(ProductSort sort)
+{
+    switch (sort) {
+    case ProductSort::Price:
+        return "price";
+    case ProductSort::Name:
+        return "name";
+    case ProductSort::Id:
+        break;
+    }
+    return "id";
+}
+}
+
+QByteArray ProductPageCursor::encode() const
+{
+    QJsonObject object;
+    object["s"] = sortName(sort);
+    object["i"] = id;
+    if (sort == ProductSort::Price) {
+        object["p"] = price;
+    } else if (sort == ProductSort::Name) {
+        object["n"] = name;
+    }
+    return QJsonDocument(object).toJson(QJsonDocument::Compact)
+        .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
+
+std::optional<ProductPageCursor> ProductPageCursor::decode(const QByteArray &encoded)
+{
+    const QByteArray::FromBase64Result decoded = QByteArray::fromBase64Encoding(
+        encoded, QByteArray::Base64UrlEncoding | QByteArray::AbortOnBase64DecodingErrors);
+    if (!decoded) {
+        return std::nullopt;
+    }
+    const QJsonDocument json = QJsonDocument::fromJson(*decoded);
+    if (!json.isObject()) {
+        return std::nullopt;
+    }
+    const QJsonObject object = json.object();
+    const std::optional<ProductSort> sort = sortFromString(object.value("s").toString());
+    if (!sort || !object.value("i").isDouble()) {
+        return std::nullopt;
+    }
+    ProductPageCursor cursor;
+    cursor.sort = *sort;
+    cursor.id = object.value("i").toInt();
+    cursor.price = object.value("p").toDouble();
+    cursor.name = object.value("n").toString();
+    return cursor;
+}
+
+std::optional<ProductSort> ProductPageCursor::sortFromString(const QString &name)
+{
+    if (name == "id") {
+        return ProductSort::Id;
+    }
+    if (name == "price") {
+        return ProductSort::Price;
+    }
+    if (name == "name") {
+        return ProductSort::Name;
+    }
+    return std::nullopt;
+}
+
+QJsonArray CatalogSnapshot::categoriesJson() const
+{
+    QList<const CatalogCategory *> sorted;
+    sorted.reserve(categories.size());
+    for (const CatalogCategory &category : categories) {
+        sorted.append(&category);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const CatalogCategory *a, const CatalogCategory *b) {
+        return a->name < b->name;
+    });
+
+    QJsonArray categoriesArray;
+    for (const CatalogCategory *category : std::as_const(sorted)) {
+        QJsonObject object;
+        object["category_id"] = category->id;
+        object["category_name"] = category->name;
+        object["number_of_products"] = qint64(categoryBitmaps.value(category->id).cardinality());
+        categoriesArray.append(object);
+    }
+    return categoriesArray;
+}
+
+RoaringBitmap CatalogSnapshot::selectProducts(const QList<int> &categoryIds, bool matchAll) const
+{
+    if (categoryIds.isEmpty()) {
+        return RoaringBitmap();
+    }
+    // Для пересечения сначала самые маленькие карты: промежуточный результат быстро сужается
+    QList<const RoaringBitmap *> bitmaps;
+    bitmaps.reserve(categoryIds.size());
+    for (int categoryId : categoryIds) {
+        auto it = categoryBitmaps.constFind(categoryId);
+        if (it == categoryBitmaps.constEnd()) {
+            if (matchAll) {
+                return RoaringBitmap();
+            }
+            continue;
+        }
+        bitmaps.append(&*it);
+    }
+    if (bitmaps.isEmpty()) {
+        return RoaringBitmap();
+    }
+    if (matchAll) {
+        std::sort(bitmaps.begin(), bitmaps.end(), [](const RoaringBitmap *a, const RoaringBitmap *b) {
+            return a->cardinality() < b->cardinality();
+        });
+    }
+    RoaringBitmap result = *bitmaps.constFirst();
+    for (qsizetype i = 1; i < bitmaps.size() && !result.isEmpty(); ++i) {
+        result = matchAll ? RoaringBitmap::intersected(result, *bitmaps.at(i))
+                          : RoaringBitmap::united(result, *bitmaps.at(i));
+    }
+    return result;
+}
+
+QJsonArray CatalogSnapshot::productsJson(const RoaringBitmap &selection, int afterId, int limit, bool *more) const
+{
+    QJsonArray productsArray;
+    const QList<int> productIds = selection.values(afterId, limit, more);
+    for (int productId : productIds) {
+        auto it = products.constFind(productId);
+        if (it != products.constEnd()) {
+            productsArray.append(productJson(*it));
+        }
+    }
+    return productsArray;
+}
+
+QJsonArray CatalogSnapshot::facetCounts(const RoaringBitmap &selection) const
+{
+    QList<QPair<const CatalogCategory *, qint64>> counts;
+    for (auto it = categoryBitmaps.cbegin(); it != categoryBitmaps.cend(); ++it) {
+        auto category = categories.constFind(it.key());
+        if (category == categories.constEnd()) {
+            continue;
+        }
+        const qint64 count = selection.intersectionCardinality(*it);
+        if (count > 0) {
+            counts.append({&*category, count});
+        }
+    }
+    std::sort(counts.begin(), counts.end(), [](const auto &a, const auto &b) { return a.first->name < b.first->name; });
+
+    QJsonArray facets;
+    for (const auto &[category, count] : std::as_const(counts)) {
+        QJsonObject object;
+        object["category_id"] = category->id;
+        object["category_name"] = category->name;
+        object["count"] = count;
+        facets.append(object);
+    }
+    return facets;
+}
+
+QJsonObject CatalogSnapshot::bitmapStats() const
+{
+    qint64 containers = 0;
+    qint64 bitmapContainers = 0;
+    qint64 memoryBytes = 0;
+    for (const RoaringBitmap &bitmap : categoryBitmaps) {
+        containers += bitmap.containerCount();
+        bitmapContainers += bitmap.bitmapContainerCount();
+        memoryBytes += bitmap.memoryBytes();
+    }
+    QJsonObject result;
+    result["categories"] = int(categoryBitmaps.size());
+    result["containers"] = containers;
+    result["bitmap_containers"] = bitmapContainers;
+    result["memory_bytes"] = memoryBytes;
+    return result;
+}
+
+QJsonArray CatalogSnapshot::productsJson(int categoryId) const
+{
+    QJsonArray productsArray;
+    const QList<int> productIds = productsByCategory.value(categoryId);
+    for (int productId : productIds) {
+        auto it = products.constFind(productId);
+        if (it == products.constEnd()) {
+            continue;
+        }
+        productsArray.append(productJson(*it));
+    }
+    return productsArray;
+}
+
+QJsonArray CatalogSnapshot::productsPage(int categoryId, ProductSort sort, const std::optional<ProductPageCursor> &after,
+                                         int limit, std::optional<ProductPageCursor> *next) const
+{
+    if (sort == ProductSort::Price) {
+        return productsByPrice(categoryId, PriceFilter(), after, limit, next);
+    }
+    next->reset();
+    const QList<int> &order = orderList(sort, categoryId);
+    auto it = order.cbegin();
+    if (after) {
+        // Первый товар строго после курсора; сам товар курсора мог быть уже удален
+        it = std::upper_bound(order.cbegin(), order.cend(), *after, [this](const ProductPageCursor &cursor, int productId) {
+            const auto product = products.constFind(productId);
+            return product == products.constEnd() ? cursor.id < productId : cursorBefore(cursor, *product);
+        });
+    }
+
+    QJsonArray page;
+    const CatalogProduct *last = nullptr;
+    for (; it != order.cend() && page.size() < limit; ++it) {
+        auto product = products.constFind(*it);
+        if (product == products.constEnd()) {
+            continue;
+        }
+        page.append(productJson(*product));
+        last = &*product;
+    }
+    if (last && it != order.cend()) {
+        ProductPageCursor cursor;
+        cursor.sort = sort;
+        cursor.id = last->id;
+        cursor.price = last->price;
+        cursor.name = last->name;
+        *next = cursor;
+    }
+    return page;
+}
+
+QJsonArray CatalogSnapshot::productsByPrice(int categoryId, const PriceFilter &filter,
+                                            const std::optional<ProductPageCursor> &after,
+                                            int limit, std::optional<ProductPageCursor> *next) const
+{
+    next->reset();
+    QJsonArray page;
+    const auto found = productsByCategoryPrice.constFind(categoryId);
+    if (found == productsByCategoryPrice.constEnd() || limit <= 0) {
+        return page;
+    }
+    const CategoryPriceIndex &index = *found;
+
+    // Границы среза: [min_price, max_price] и строго после курсора
+    qsizetype begin = 0;
+    qsizetype end = index.productIds.size();
+    if (filter.minPrice) {
+        begin = index.upperBound(*filter.minPrice, std::numeric_limits<int>::min());
+    }
+    if (after) {
+        begin = qMax(begin, index.upperBound(after->price, after->id));
+    }
+    if (filter.maxPrice) {
+        end = index.upperBound(*filter.maxPrice, std::numeric_limits<int>::max());
+    }
+
+    auto append = [&](qsizetype row) {
+        const auto product = products.constFind(index.productIds.at(row));
+        if (product != products.constEnd()) {
+            page.append(productJson(*product));
+        }
+    };
+
+    qsizetype lastRow = -1;
+    if (!filter.inStockOnly) {
+        for (qsizetype row = begin; row < end && page.size() < limit; ++row) {
+            append(row);
+            lastRow = row;
+        }
+    } else {
+        // Позиции подходящих строк пачки собираются без условных переходов,
+        // цикл по плотному массиву остатков компилятор может векторизовать
+        std::array<qsizetype, kFilterBlock> selected;
+        const int *stocks = index.stocks.constData();
+        for (qsizetype blockStart = begin; blockStart < end && page.size() < limit; blockStart += kFilterBlock) {
+            const qsizetype blockEnd = qMin(blockStart + kFilterBlock, end);
+            qsizetype count = 0;
+            for (qsizetype row = blockStart; row < blockEnd; ++row) {
+                selected[count] = row;
+                count += stocks[row] > 0;
+            }
+            for (qsizetype i = 0; i < count && page.size() < limit; ++i) {
+                append(selected[i]);
+                lastRow = selected[i];
+            }
+        }
+    }
+
+    bool more = lastRow >= 0 && page.size() == limit && lastRow + 1 < end;
+    if (more && filter.inStockOnly) {
+        // Страница могла закончиться последним товаром в наличии: курсор выдается, только если
+        // до конца среза есть еще хотя бы одна строка с остатком, иначе клиент получит пустую страницу
+        const int *stocks = index.stocks.constData();
+        more = std::any_of(stocks + lastRow + 1, stocks + end, [](int stock) { return stock > 0; });
+    }
+    if (more) {
+        ProductPageCursor cursor;
+        cursor.sort = ProductSort::Price;
+        cursor.id = index.productIds.at(lastRow);
+        cursor.price = index.prices.at(lastRow);
+        *next = cursor;
+    }
+    return page;
+}
+
+QString CatalogSnapshot::imageFileName(const QString &imagePath)
+{
+    if (imagePath.isEmpty()) {
+        return QString();
+    }
+    return imagePath.section('/', -1);
+}
+
+double CatalogSnapshot::roundPrice(double price)
+{
+    return std::round(price * 100.0) / 100.0;
+}
+
+void CatalogSnapshot::addCategory(const CatalogCategory &category)
+{
+    categories.insert(category.id, category);
+}
+
+void CatalogSnapshot::removeCategory(int categoryId)
+{
+    productsByCategoryPrice.remove(categoryId);
+    productsByCategoryName.remove(categoryId);
+    categoryBitmaps.remove(categoryId);
+    const QList<int> productIds = productsByCategory.take(categoryId);
+    for (int productId : productIds) {
+        auto it = categoriesByProduct.find(productId);
+        if (it != categoriesByProduct.end()) {
+            removeSorted(*it, categoryId);
+        }
+    }
+    categories.remove(categoryId);
+}
+
+void CatalogSnapshot::addProduct(const CatalogProduct &product, const QList<int> &categoryIds)
+{
+    CatalogProduct &added = products.insert(product.id, product).value();
+    added.price = roundPrice(product.price);
+    const QString imageName = imageFileName(product.imagePath);
+    if (!imageName.isEmpty()) {
+        ++imageReferences[imageName];
+    }
+    for (int categoryId : categoryIds) {
+        linkProduct(product.id, categoryId);
+    }
+}
+
+void CatalogSnapshot::removeProduct(int productId)
+{
+    const QList<int> categoryIds = categoriesByProduct.take(productId);
+    for (int categoryId : categoryIds) {
+        auto it = productsByCategory.find(categoryId);
+        if (it != productsByCategory.end()) {
+            removeSorted(*it, productId);
+        }
+        removeOrdered(productId, categoryId);
+        auto bitmap = categoryBitmaps.find(categoryId);
+        if (bitmap != categoryBitmaps.end()) {
+            bitmap->remove(quint32(productId));
+        }
+    }
+    setProductImage(productId, QString());
+    products.remove(productId);
+}
+
+void CatalogSnapshot::setProductImage(int productId, const QString &imagePath)
+{
+    const auto current = products.constFind(productId);
+    if (current == products.constEnd() || current->imagePath == imagePath) {
+        return;
+    }
+    const QString oldName = imageFileName(current->imagePath);
+    if (!oldName.isEmpty()) {
+        auto ref = imageReferences.find(oldName);
+        if (ref != imageReferences.end() && --(*ref) <= 0) {
+            imageReferences.erase(ref);
+        }
+    }
+    products.find(productId)->imagePath = imagePath;
+    const QString newName = imageFileName(imagePath);
+    if (!newName.isEmpty()) {
+        ++imageReferences[newName];
+    }
+}
+
+void CatalogSnapshot::setProductName(int productId, const QString &name)
+{
+    const auto current = products.constFind(productId);
+    if (current == products.constEnd() || current->name == name) {
+        return;
+    }
+    const QList<int> categoryIds = categoriesByProduct.value(productId);
+    for (int categoryId : categoryIds) {
+        removeOrdered(productId, categoryId);
+    }
+    products.find(productId)->name = name;
+    for (int categoryId : categoryIds) {
+        insertOrdered(productId, categoryId);
+    }
+}
+
+void CatalogSnapshot::setProductPrice(int productId, double price)
+{
+    price = roundPrice(price);
+    const auto current = products.constFind(productId);
+    if (current == products.constEnd() || current->price == price) {
+        return;
+    }
+    const QList<int> categoryIds = categoriesByProduct.value(productId);
+    for (int categoryId : categoryIds) {
+        removeOrdered(productId, categoryId);
+    }
+    products.find(productId)->price = price;
+    for (int categoryId : categoryIds) {
+        insertOrdered(productId, categoryId);
+    }
+}
+
+void CatalogSnapshot::setProductStock(int productId, int stock)
+{
+    const auto current = products.constFind(productId);
+    if (current == products.constEnd() || current->stock == stock) {
+        return;
+    }
+    const double price = current->price;
+    products.find(productId)->stock = stock;
+    const QList<int> categoryIds = categoriesByProduct.value(productId);
+    for (int categoryId : categoryIds) {
+        const auto index = productsByCategoryPrice.constFind(categoryId);
+        if (index == productsByCategoryPrice.constEnd()) {
+            continue;
+        }
+        const qsizetype row = index->find(price, productId);
+        if (row >= 0) {
+            productsByCategoryPrice[categoryId].stocks[row] = stock;
+        }
+    }
+}
+
+void CatalogSnapshot::linkProduct(int productId, int categoryId)
+{
+    if (!products.contains(productId) || !categories.contains(categoryId)) {
+        return;
+    }
+    insertSorted(productsByCategory[categoryId], productId);
+    insertSorted(categoriesByProduct[productId], categoryId);
+    insertOrdered(productId, categoryId);
+    categoryBitmaps[categoryId].add(quint32(productId));
+}
+
+void CatalogSnapshot::unlinkProduct(int productId, int categoryId)
+{
+    removeOrdered(productId, categoryId);
+    auto byCategory = productsByCategory.find(categoryId);
+    if (byCategory != productsByCategory.end()) {
+        removeSorted(*byCategory, productId);
+    }
+    auto byProduct = categoriesByProduct.find(productId);
+    if (byProduct != categoriesByProduct.end()) {
+        removeSorted(*byProduct, categoryId);
+    }
+    auto bitmap = categoryBitmaps.find(categoryId);
+    if (bitmap != categoryBitmaps.end()) {
+        bitmap->remove(quint32(productId));
+    }
+}
+
+void CatalogSnapshot::rebuildOrders()
+{
+    for (auto it = categoriesByProduct.begin(); it != categoriesByProduct.end(); ++it) {
+        std::sort(it->begin(), it->end());
+    }
+    for (auto it = productsByCategory.begin(); it != productsByCategory.end(); ++it) {
+        std::sort(it->begin(), it->end());
+        QList<int> byPrice = *it;
+        std::sort(byPrice.begin(), byPrice.end(), [this](int a, int b) { return lessThan(ProductSort::Price, a, b); });
+        CategoryPriceIndex index;
+        index.prices.reserve(byPrice.size());
+        index.productIds.reserve(byPrice.size());
+        index.stocks.reserve(byPrice.size());
+        for (int productId : std::as_const(byPrice)) {
+            const CatalogProduct &product = *products.constFind(productId);
+            index.prices.append(product.price);
+            index.productIds.append(productId);
+            index.stocks.append(product.stock);
+        }
+        productsByCategoryPrice.insert(it.key(), index);
+
+        RoaringBitmap bitmap;
+        for (int productId : std::as_const(*it)) {
+            bitmap.add(quint32(productId));
+        }
+        categoryBitmaps.insert(it.key(), bitmap);
+        QList<int> byName = *it;
+        std::sort(byName.begin(), byName.end(), [this](int a, int b) { return lessThan(ProductSort::Name, a, b); });
+        productsByCategoryName.insert(it.key(), byName);
+    }
+}
+
+QList<int> *CatalogSnapshot::orderList(ProductSort sort, int categoryId)
+{
+    return sort == ProductSort::Name ? &productsByCategoryName[categoryId] : &productsByCategory[categoryId];
+}
+
+const QList<int> &CatalogSnapshot::orderList(ProductSort sort, int categoryId) const
+{
+    static const QList<int> empty;
+    const QHash<int, QList<int>> &lists = sort == ProductSort::Name ? productsByCategoryName : productsByCategory;
+    auto it = lists.constFind(categoryId);
+    return it == lists.constEnd() ? empty : *it;
+}
+
+bool CatalogSnapshot::lessThan(ProductSort sort, int a, int b) const
+{
+    const auto first = products.constFind(a);
+    const auto second = products.constFind(b);
+    if (first == products.constEnd() || second == products.constEnd()) {
+        return a < b;
+    }
+    switch (sort) {
+    case ProductSort::Price:
+        if (first->price != second->price) {
+            return first->price < second->price;
+        }
+        break;
+    case ProductSort::Name:
+        if (const int order = first->name.compare(second->name)) {
+            return order < 0;
+        }
+        break;
+    case ProductSort::Id:
+        break;
+    }
+    return a < b;
+}
+
+void CatalogSnapshot::insertOrdered(int productId, int categoryId)
+{
+    // Список по product_id ведут linkProduct/unlinkProduct, здесь только индексы по цене и названию
+    const auto product = products.constFind(productId);
+    if (product == products.constEnd()) {
+        return;
+    }
+    productsByCategoryPrice[categoryId].insert(product->price, productId, product->stock);
+
+    QList<int> &list = *orderList(ProductSort::Name, categoryId);
+    auto it = std::lower_bound(list.begin(), list.end(), productId, [this](int a, int b) {
+        return lessThan(ProductSort::Name, a, b);
+    });
+    if (it == list.end() || *it != productId) {
+        list.insert(it, productId);
+    }
+}
+
+void CatalogSnapshot::removeOrdered(int productId, int categoryId)
+{
+    const auto product = products.constFind(productId);
+    if (product == products.constEnd()) {
+        return;
+    }
+    auto index = productsByCategoryPrice.find(categoryId);
+    if (index != productsByCategoryPrice.end()) {
+        index->remove(product->price, productId);
+    }
+
+    auto found = productsByCategoryName.find(categoryId);
+    if (found == productsByCategoryName.end()) {
+        return;
+    }
+    QList<int> &list = *found;
+    auto it = std::lower_bound(list.begin(), list.end(), productId, [this](int a, int b) {
+        return lessThan(ProductSort::Name, a, b);
+    });
+    if (it != list.end() && *it == productId) {
+        list.erase(it);
+    }
+}
+
+qsizetype CategoryPriceIndex::upperBound(double price, int productId) const
+{
+    qsizetype low = 0;
+    qsizetype high = prices.size();
+    while (low < high) {
+        const qsizetype middle = low + (high - low) / 2;
+        const double middlePrice = prices.at(middle);
+        if (middlePrice < price || (middlePrice == price && productIds.at(middle) <= productId)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+qsizetype CategoryPriceIndex::find(double price, int productId) const
+{
+    const qsizetype row = upperBound(price, productId) - 1;
+    return (row >= 0 && productIds.at(row) == productId) ? row : -1;
+}
+
+void CategoryPriceIndex::insert(double price, int productId, int stock)
+{
+    if (find(price, productId) >= 0) {
+        return;
+    }
+    const qsizetype row = upperBound(price, productId);
+    prices.insert(row, price);
+    productIds.insert(row, productId);
+    stocks.insert(row, stock);
+}
+
+void CategoryPriceIndex::remove(double price, int productId)
+{
+    const qsizetype row = find(price, productId);
+    if (row < 0) {
+        return;
+    }
+    prices.remove(row);
+    productIds.remove(row);
+    stocks.remove(row);
+}
+
+CatalogCache::CatalogCache()
+    : m_current(std::make_shared<const CatalogSnapshot>())
+{
+}
+
+bool CatalogCache::load(QSqlDatabase &db)
+{
+    // Писатели ждут от чтения до публикации: иначе изменение, опубликованное через update()
+    // во время чтения, пропало бы при замене снимка. Изменение, записанное в БД до чтения,
+    // но еще ждущее блокировку, применится поверх загруженного снимка.
+    QMutexLocker locker(&m_writeMutex);
+    auto next = std::make_shared<CatalogSnapshot>();
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT category_id, category_name FROM Categories")) {
+        qWarning() << "CatalogCache: Failed to load categories:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        next->addCategory({query.value(0).toInt(), query.value(1).toString()});
+    }
+
+    if (!query.exec("SELECT product_id, product_name, product_price, product_description, product_image_path, product_stock FROM Products "
+                    "WHERE product_is_active")) {
+        qWarning() << "CatalogCache: Failed to load products:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        CatalogProduct product;
+        product.id = query.value(0).toInt();
+        product.name = query.value(1).toString();
+        product.price = query.value(2).toDouble();
+        product.description = query.value(3).toString();
+        product.imagePath = query.value(4).toString();
+        product.stock = query.value(5).toInt();
+        next->addProduct(product, {});
+    }
+
+    if (!query.exec("SELECT pc.product_id, pc.category_id FROM Products_Categories pc "
+                    "JOIN Products p ON p.product_id = pc.product_id WHERE p.product_is_active")) {
+        qWarning() << "CatalogCache: Failed to load product categories:" << query.lastError().text();
+        return false;
+    }
+    // Связи добавляются без сортировки, списки упорядочиваются один раз в конце
+    while (query.next()) {
+        const int productId = query.value(0).toInt();
+        const int categoryId = query.value(1).toInt();
+        if (next->products.contains(productId) && next->categories.contains(categoryId)) {
+            next->productsByCategory[categoryId].append(productId);
+            next->categoriesByProduct[productId].append(categoryId);
+        }
+    }
+    next->rebuildOrders();
+
+    next->loaded = true;
+    next->version = snapshot()->version + 1;
+    next->structureVersion = snapshot()->structureVersion + 1;
+    qDebug() << "CatalogCache: Loaded" << next->categories.size() << "categories and"
+             << next->products.size() << "products, version" << next->version;
+    std::atomic_store(&m_current, SnapshotPtr(std::move(next)));
+    return true;
+}
+
+CatalogCache::SnapshotPtr CatalogCache::snapshot() const
+{
+    return std::atomic_load(&m_current);
+}
+
+void CatalogCache::update(const std::function<void(CatalogSnapshot &)> &mutation)
+{
+    publish(mutation, true);
+}
+
+void CatalogCache::updateStock(const std::function<void(CatalogSnapshot &)> &mutation)
+{
+    publish(mutation, false);
+}
+
+void CatalogCache::publish(const std::function<void(CatalogSnapshot &)> &mutation, bool structural)
+{
+    QMutexLocker locker(&m_writeMutex);
+    // Копия дешевая: контейнеры Qt разделяются неявно и отделяются только там, где меняются
+    auto next = std::make_shared<CatalogSnapshot>(*snapshot());
+    mutation(*next);
+    next->version += 1;
+    if (structural) {
+        next->structureVersion += 1;
+    }
+    std::atomic_store(&m_current, SnapshotPtr(std::move(next)));
+}
@@ -0,0 +1,173 @@
+#ifndef CATALOGCACHE_H
+#define CATALOGCACHE_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSqlDatabase>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "roaringbitmap.h"
+
+struct CatalogCategory
+{
+    int id = 0;
+    QString name;
+};
+
+struct CatalogProduct
+{
+    int id = 0;
+    QString name;
+    double price = 0.0;
+    QString description;
+    QString imagePath;
+    int stock = 0; // product_stock в БД; обновляется при списании продаж, а не при каждом резерве
+};
+
+enum class ProductSort {
+    Id,
+    Price,
+    Name
+};
+
+// Позиция в выдаче GET /products: ключ сортировки и product_id последнего отданного товара.
+// Следующая страница начинается строго после этой пары, поэтому удаление или добавление
+// товаров между запросами не сдвигает выдачу (в отличие от OFFSET).
+struct ProductPageCursor
+{
+    ProductSort sort = ProductSort::Id;
+    double price = 0.0;
+    QString name;
+    int id = 0;
+
+    // Непрозрачная для клиента строка (base64url от JSON)
+    QByteArray encode() const;
+    static std::optional<ProductPageCursor> decode(const QByteArray &encoded);
+    static std::optional<ProductSort> sortFromString(const QString &name);
+};
+
+// Товары одной категории по (цена, product_id) в виде параллельных массивов (structure of arrays).
+// Диапазон цен находится двоичным поиском по prices и отдается непрерывным срезом,
+// а остальные фильтры проходят по плотному массиву без обращения к products.
+struct CategoryPriceIndex
+{
+    QList<double> prices;
+    QList<int> productIds;
+    QList<int> stocks; // product_stock, для фильтра in_stock
+
+    // Первая позиция, где (цена, id) строго больше (price, productId)
+    qsizetype upperBound(double price, int productId) const;
+    // Позиция товара или -1; price - текущая цена товара в индексе
+    qsizetype find(double price, int productId) const;
+    void insert(double price, int productId, int stock);
+    void remove(double price, int productId);
+};
+
+// Условия выборки товаров категории по цене (границы включительно)
+struct PriceFilter
+{
+    std::optional<double> minPrice;
+    std::optional<double> maxPrice;
+    bool inStockOnly = false;
+};
+
+// Неизменяемая версия каталога. После публикации не меняется, поэтому читается без блокировок.
+struct CatalogSnapshot
+{
+    quint64 version = 0;          // растет при каждой публикации
+    quint64 structureVersion = 0; // растет при всех изменениях, кроме остатков (CatalogCache::updateStock)
+    QHash<int, CatalogCategory> categories;
+    QHash<int, CatalogProduct> products;
+    QHash<int, QList<int>> productsByCategory;  // отсортированные product_id
+    QHash<int, CategoryPriceIndex> productsByCategoryPrice;
+    QHash<int, QList<int>> productsByCategoryName;  // product_id по (название, product_id)
+    QHash<int, QList<int>> categoriesByProduct; // отсортированные category_id
+    QHash<int, RoaringBitmap> categoryBitmaps;  // product_id категории: пересечения, фасеты и число товаров
+    QHash<QString, int> imageReferences;        // имя файла в images/ -> число товаров с этой картинкой
+    bool loaded = false;                        // снимок заполнен из БД, а не пустой начальный
+
+    // Имя файла из product_image_path вида "/images/<имя>"
+    static QString imageFileName(const QString &imagePath);
+    // Цена в том виде, в каком ее хранит БД (NUMERIC(10, 2)): иначе цена из запроса вида 9.999
+    // отличалась бы в снимке от сохраненной 10.00 и сортировка расходилась бы с БД
+    static double roundPrice(double price);
+
+    // То же, что vw_CategoriesWithProductCount (сортировка по имени); число товаров - мощность битовой карты
+    QJsonArray categoriesJson() const;
+    // Товары, входящие во все (matchAll) или хотя бы в одну из категорий
+    RoaringBitmap selectProducts(const QList<int> &categoryIds, bool matchAll) const;
+    // Товары выборки по возрастанию product_id после afterId; *more = true, если есть еще
+    QJsonArray productsJson(const RoaringBitmap &selection, int afterId, int limit, bool *more) const;
+    // Сколько товаров выборки в каждой категории (только непустые, сортировка по имени категории)
+    QJsonArray facetCounts(const RoaringBitmap &selection) const;
+    QJsonObject bitmapStats() const;
+    // То же, что fn_GetProductsByCategory (сортировка по product_id)
+    QJsonArray productsJson(int categoryId) const;
+    // Страница товаров категории после after (с начала, если after не задан): поиск позиции
+    // двоичный по упорядоченному списку. *next заполняется, если после страницы есть товары.
+    QJsonArray productsPage(int categoryId, ProductSort sort, const std::optional<ProductPageCursor> &after,
+                            int limit, std::optional<ProductPageCursor> *next) const;
+    // Страница товаров категории по возрастанию цены с фильтром: срез индекса по цене,
+    // внутри которого остальные условия проверяются блоками
+    QJsonArray productsByPrice(int categoryId, const PriceFilter &filter, const std::optional<ProductPageCursor> &after,
+                               int limit, std::optional<ProductPageCursor> *next) const;
+
+    // Изменения применяются к копии снимка перед публикацией. Товар ищется через constFind,
+    // и хеш отделяется от предыдущей версии, только если в нем действительно что-то меняется.
+    void addCategory(const CatalogCategory &category);
+    void removeCategory(int categoryId);
+    void addProduct(const CatalogProduct &product, const QList<int> &categoryIds);
+    void removeProduct(int productId);
+    void setProductImage(int productId, const QString &imagePath);
+    // Название и цена - ключи сортировки, поэтому меняются вместе с позицией в упорядоченных списках
+    void setProductName(int productId, const QString &name);
+    void setProductPrice(int productId, double price);
+    void setProductStock(int productId, int stock);
+    void linkProduct(int productId, int categoryId);
+    void unlinkProduct(int productId, int categoryId);
+    // Упорядочивает все списки после массовой загрузки без сортировки по одному
+    void rebuildOrders();
+
+private:
+    // Списки по product_id и по названию; по цене - productsByCategoryPrice
+    QList<int> *orderList(ProductSort sort, int categoryId);
+    const QList<int> &orderList(ProductSort sort, int categoryId) const;
+    bool lessThan(ProductSort sort, int a, int b) const;
+    void insertOrdered(int productId, int categoryId);
+    void removeOrdered(int productId, int categoryId);
+};
+
+// Каталог в памяти в стиле RCU: читатели атомарно берут указатель на текущий снимок,
+// писатели копируют снимок, применяют изменение и атомарно публикуют новую версию.
+class CatalogCache
+{
+public:
+    using SnapshotPtr = std::shared_ptr<const CatalogSnapshot>;
+
+    CatalogCache();
+
+    // Полная загрузка из БД (при старте и после импорта); писатели ждут до публикации
+    bool load(QSqlDatabase &db);
+
+    SnapshotPtr snapshot() const;
+
+    // Публикует новую версию, применив mutation к копии текущего снимка
+    void update(const std::function<void(CatalogSnapshot &)> &mutation);
+    // То же для изменений только product_stock: structureVersion не меняется,
+    // поэтому ответы, которые от остатков не зависят (/categories), остаются в кэше
+    void updateStock(const std::function<void(CatalogSnapshot &)> &mutation);
+
+private:
+    void publish(const std::function<void(CatalogSnapshot &)> &mutation, bool structural);
+
+    SnapshotPtr m_current;
+    QMutex m_writeMutex; // Писатели сериализуются, читатели его не трогают
+};
+
+#endif // CATALOGCACHE_H
@@ -1,389 +1,729 @@
 #include "databasehandler.h"
+#include "passwordverifier.h"
 #include <QDebug>
 #include <QJsonValue>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QSqlDriver>
+#include <QSqlField>
+#include <QElapsedTimer>
+#include <QThread>
+#include <libpq-fe.h>
+
+namespace {
+// Строки COPY отправляются серверу блоками примерно такого размера
+constexpr int kImportCopyBufferBytes = 64 * 1024;
+// Ход импорта сообщается через это число записей
+constexpr qint64 kImportProgressInterval = 5000;
+// Заказ, не дождавшийся блокировки строк товаров (lock_timeout в fn_PlaceOrder), повторяется
+// с растущей паузой: покупатель горячего товара ждет своей очереди, а не получает отказ
+constexpr int kPlaceOrderAttempts = 3;
+constexpr int kPlaceOrderRetryDelayMs = 50;
+
+// Массив для параметра вида CAST(:ids AS INT[]): QPSQL не привязывает списки напрямую
+QString intArrayLiteral(const QList<int> &values)
+{
+    QStringList items;
+    items.reserve(values.size());
+    for (int value : values) {
+        items.append(QString::number(value));
+    }
+    return '{' + items.join(',') + '}';
+}
+
+QString numericArrayLiteral(const QList<double> &values)
+{
+    QStringList items;
+    items.reserve(values.size());
+    for (double value : values) {
+        items.append(QString::number(value, 'f', 2));
+    }
+    return '{' + items.join(',') + '}';
+}
+
+// Значение INT[] в том виде, в каком его отдает QPSQL: "{1,2,3}"
+QList<int> parseIntArray(const QString &literal)
+{
+    QList<int> values;
+    const QStringList items = literal.mid(1, literal.size() - 2).split(',', Qt::SkipEmptyParts);
+    values.reserve(items.size());
+    for (const QString &item : items) {
+        values.append(item.toInt());
+    }
+    return values;
+}
+
+// Каждый элемент в кавычках: запятые, скобки и пробелы внутри строк не ломают литерал
+QString textArrayLiteral(const QStringList &values)
+{
+    QStringList items;
+    items.reserve(values.size());
+    for (QString value : values) {
+        value.replace('\\', "\\\\").replace('"', "\\\"");
+        items.append('"' + value + '"');
+    }
+    return '{' + items.join(',') + '}';
+}
+}
 
 DatabaseHandler::DatabaseHandler(QObject *parent) : QObject(parent)
 {
-    if (QSqlDatabase::isDriverAvailable("QPSQL")) {
-        m_db = QSqlDatabase::addDatabase("QPSQL");
-    } else {
+    m_driverAvailable = QSqlDatabase::isDriverAvailable("QPSQL");
+    if (!m_driverAvailable) {
         qWarning() << "PostgreSQL driver not available!";
     }
 }
 
 DatabaseHandler::~DatabaseHandler()
 {
-    if (m_db.isOpen()) {
-        m_db.close();
-    }
+}
+
+void DatabaseHandler::setPoolSettings(const DatabasePool::Settings& settings)
+{
+    m_poolSettings = settings;
 }
 
 bool DatabaseHandler::connectToDatabase(const QString& host, int port, const QString& dbName,
                                         const QString& userName, const QString& password)
 {
-    if (!m_db.isValid()) {
+    if (!m_driverAvailable) {
         qWarning() << "Database object is not valid (driver not loaded?).";
         return false;
     }
-    m_db.setHostName(host);
-    m_db.setPort(port);
-    m_db.setDatabaseName(dbName);
-    m_db.setUserName(userName);
-    m_db.setPassword(password);
-
-    if (!m_db.open()) {
-        qWarning() << "Failed to connect to database:" << m_db.lastError().text();
+    m_poolSettings.host = host;
+    m_poolSettings.port = port;
+    m_poolSettings.dbName = dbName;
+    m_poolSettings.userName = userName;
+    m_poolSettings.password = password;
+    m_pool.setSettings(m_poolSettings);
+
+    if (!m_pool.warmUp()) {
+        qWarning() << "Failed to connect to database.";
         return false;
     }
     qDebug() << "Successfully connected to database.";
-    return true;
+
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!m_catalog.load(db)) {
+        qWarning() << "Failed to load the catalog into memory.";
+        return false;
+    }
+    const CatalogCache::SnapshotPtr catalog = m_catalog.snapshot();
+    QHash<int, int> stock;
+    stock.reserve(catalog->products.size());
+    for (auto it = catalog->products.cbegin(); it != catalog->products.cend(); ++it) {
+        m_productIds.insert(it.key());
+        stock.insert(it.key(), it->stock);
+    }
+    m_stock.reset(stock);
+    m_suggest.build(catalog->products);
+    return loadUserIds(db);
 }
 
-QJsonArray DatabaseHandler::getCategories()
+bool DatabaseHandler::loadUserIds(QSqlDatabase& db)
 {
-    QJsonArray categoriesArray;
-    if (!m_db.isOpen()) {
-        qWarning() << "Database is not open.";
-        return categoriesArray;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT user_id FROM Users")) {
+        qWarning() << "DatabaseHandler: Failed to load user ids:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        m_userIds.insert(query.value(0).toLongLong());
     }
+    return true;
+}
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT category_id, category_name, number_of_products FROM vw_CategoriesWithProductCount");
+QJsonObject DatabaseHandler::idIndexStats() const
+{
+    QJsonObject result;
+    result["users"] = m_userIds.stats();
+    result["products"] = m_productIds.stats();
+    return result;
+}
 
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject category;
-            category["category_id"] = query.value("category_id").toInt();
-            category["category_name"] = query.value("category_name").toString();
-            category["number_of_products"] = query.value("number_of_products").toInt();
-            categoriesArray.append(category);
-        }
-    } else {
-        qWarning() << "Failed to get categories:" << query.lastError().text();
+
+void DatabaseHandler::setReservationTtlMs(qint64 ttlMs)
+{
+    m_stock.setReservationTtlMs(ttlMs);
+}
+
+QJsonObject DatabaseHandler::stockStats() const
+{
+    return m_stock.stats();
+}
+
+int DatabaseHandler::expireReservations()
+{
+    return m_stock.removeExpired();
+}
+
+int DatabaseHandler::publishStock()
+{
+    QSet<int> changed;
+    {
+        QMutexLocker locker(&m_stockChangesMutex);
+        changed.swap(m_stockChanges);
+    }
+    if (changed.isEmpty()) {
+        return 0;
     }
-    return categoriesArray;
+
+    // Все заказы за период - одна публикация снимка, а не копия каталога на каждого покупателя.
+    // Остаток читается из StockLedger внутри update(), поэтому публикуется самое свежее значение.
+    m_catalog.updateStock([&](CatalogSnapshot &catalog) {
+        for (int productId : std::as_const(changed)) {
+            const int stock = m_stock.onHand(productId);
+            if (stock >= 0) {
+                catalog.setProductStock(productId, stock);
+            }
+        }
+    });
+    qDebug() << "DatabaseHandler: Published stock for" << changed.size() << "product(s)";
+    return int(changed.size());
+}
+
+QJsonObject DatabaseHandler::poolStats() const
+{
+    return m_pool.stats();
+}
+
+QJsonArray DatabaseHandler::getCategories()
+{
+    // Каталог отдается из снимка в памяти, без обращения к БД
+    return m_catalog.snapshot()->categoriesJson();
 }
 
 QJsonArray DatabaseHandler::getProductsByCategory(int categoryId)
 {
-    QJsonArray productsArray;
-    if (!m_db.isOpen()) {
-        qWarning() << "Database is not open.";
-        return productsArray;
+    return m_catalog.snapshot()->productsJson(categoryId);
+}
+
+CatalogCache::SnapshotPtr DatabaseHandler::catalogSnapshot() const
+{
+    return m_catalog.snapshot();
+}
+
+SearchResult DatabaseHandler::searchProducts(const QString& text, const std::optional<SearchCursor>& after, int limit)
+{
+    SearchResult result;
+    QElapsedTimer timer;
+    timer.start();
+    ++m_searches;
+
+    // Короткий statement_timeout: медленный поиск не должен занимать соединение и рабочий поток
+    PooledConnection connection = m_pool.acquire(kSearchStatementTimeoutMs);
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for searchProducts.";
+        ++m_searchErrors;
+        return result;
     }
 
-    QSqlQuery query(m_db);
-    query.prepare("SELECT product_id, product_name, product_price, product_description, product_image_path "
-                  "FROM fn_GetProductsByCategory(:categoryId)");
-    query.bindValue(":categoryId", categoryId);
+    // QSqlQuery::prepare() в QPSQL на каждый вызов делает PREPARE и DEALLOCATE на сервере,
+    // поэтому запрос готовится один раз на соединение, а поиск - один EXECUTE.
+    // Берется на строку больше limit, чтобы узнать, есть ли следующая страница.
+    QSqlField textField(QString(), QMetaType(QMetaType::QString));
+    textField.setValue(text);
+    // 'Infinity' - первая страница: подходит любой ранг
+    const QString execute = QString("EXECUTE search_products(%1, '%2', %3, %4)")
+        .arg(db.driver()->formatValue(textField),
+             after ? QString::number(after->rank, 'g', 9) : QString("Infinity"),
+             QString::number(after ? after->productId : 0),
+             QString::number(limit + 1));
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    bool found = prepareSearch(db) && query.exec(execute);
+    // 26000 invalid_sql_statement_name: пул переоткрыл соединение, и подготовленный запрос пропал
+    if (!found && query.lastError().nativeErrorCode() == "26000") {
+        {
+            QMutexLocker locker(&m_searchPreparedMutex);
+            m_searchPrepared.remove(db.connectionName());
+        }
+        found = prepareSearch(db) && query.exec(execute);
+    }
 
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject product;
-            product["product_id"] = query.value("product_id").toInt();
-            product["product_name"] = query.value("product_name").toString();
-            product["product_price"] = query.value("product_price").toDouble();
-            product["product_description"] = query.value("product_description").toString();
-            product["product_image_path"] = query.value("product_image_path").toString();
-            productsArray.append(product);
+    if (!found) {
+        // 57014 query_canceled: запрос совпал со слишком большой частью каталога
+        if (query.lastError().nativeErrorCode() == "57014") {
+            qDebug() << "DatabaseHandler: Search for" << text << "exceeded statement_timeout.";
+            ++m_searchTimeouts;
+            result.timedOut = true;
+            return result;
         }
-    } else {
-        qWarning() << "Failed to get products by category:" << query.lastError().text();
+        qWarning() << "DatabaseHandler: Failed to search products. Error:" << query.lastError().text();
+        ++m_searchErrors;
+        return result;
     }
-    return productsArray;
+
+    SearchCursor last;
+    while (query.next()) {
+        if (result.items.size() == limit) {
+            result.next = last;
+            break;
+        }
+        QJsonObject product;
+        product["product_id"] = query.value("product_id").toInt();
+        product["product_name"] = query.value("product_name").toString();
+        product["product_price"] = query.value("product_price").toDouble();
+        product["product_description"] = query.value("product_description").toString();
+        product["product_image_path"] = query.value("product_image_path").toString();
+        product["product_stock"] = query.value("product_stock").toInt();
+        result.items.append(product);
+        last.rank = query.value("search_rank").toFloat();
+        last.productId = product["product_id"].toInt();
+    }
+    result.ok = true;
+
+    const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+    m_searchTotalUs += elapsedUs;
+    if (elapsedUs > kSearchSlowUs) {
+        ++m_searchSlow;
+    }
+    qint64 maxUs = m_searchMaxUs.load();
+    while (elapsedUs > maxUs && !m_searchMaxUs.compare_exchange_weak(maxUs, elapsedUs)) {
+    }
+    return result;
 }
 
-bool DatabaseHandler::addProduct(const QJsonObject& productData)
+bool DatabaseHandler::prepareSearch(QSqlDatabase &db)
 {
-    if (!m_db.isOpen()) {
-        qWarning() << "DatabaseHandler: Database is not open for addProduct.";
-        return false;
+    {
+        QMutexLocker locker(&m_searchPreparedMutex);
+        if (m_searchPrepared.contains(db.connectionName())) {
+            return true;
+        }
     }
-
-    // === НАЧАЛО ТРАНЗАКЦИИ ===
-    if (!m_db.transaction()) {
-        qWarning() << "DatabaseHandler: Failed to start transaction for addProduct:" << m_db.lastError().text();
+    // Соединение в каждый момент выдано одному потоку, поэтому гонки за PREPARE нет;
+    // 42P05 duplicate_prepared_statement значит, что запрос на соединении уже есть
+    QSqlQuery query(db);
+    if (!query.exec("PREPARE search_products(TEXT, REAL, INT, INT) AS "
+                    "SELECT product_id, product_name, product_price, product_description, "
+                    "product_image_path, product_stock, search_rank "
+                    "FROM fn_SearchProducts($1, $2, $3, $4)")
+        && query.lastError().nativeErrorCode() != "42P05") {
+        qWarning() << "DatabaseHandler: Failed to prepare search query. Error:" << query.lastError().text();
         return false;
     }
+    QMutexLocker locker(&m_searchPreparedMutex);
+    m_searchPrepared.insert(db.connectionName());
+    return true;
+}
 
-    bool success = false; // Флаг общего успеха операции
+QList<Suggestion> DatabaseHandler::suggestProducts(const QString& text, int limit) const
+{
+    return m_suggest.suggest(text, limit);
+}
 
-    // 1. Извлечение данных из JSON (как и было)
-    QString name = productData.value("product_name").toString();
-    double price = productData.value("product_price").toDouble();
-    QString description = productData.value("product_description").toString();
-    QString imagePath = productData.value("product_image_path").toString();
-    QJsonArray categoryIdsJson = productData.value("category_ids").toArray();
+QJsonObject DatabaseHandler::suggestStats() const
+{
+    return m_suggest.stats();
+}
 
-    if (name.isEmpty() || price <= 0) {
-        qWarning() << "DatabaseHandler: Invalid product data (name or price).";
-        m_db.rollback();
-        return false;
-    }
+QJsonObject DatabaseHandler::searchStats() const
+{
+    const quint64 searches = m_searches.load();
+    QJsonObject result;
+    result["searches"] = qint64(searches);
+    result["errors"] = qint64(m_searchErrors.load());
+    result["timeouts"] = qint64(m_searchTimeouts.load());
+    result["slow"] = qint64(m_searchSlow.load());
+    result["avg_us"] = searches ? m_searchTotalUs.load() / qint64(searches) : 0;
+    result["max_us"] = m_searchMaxUs.load();
+    return result;
+}
 
-    // 2. Вставка товара в таблицу Products и получение ID
-    QSqlQuery productInsertQuery(m_db);
-    productInsertQuery.prepare("INSERT INTO Products (product_name, product_price, product_description, product_image_path) "
-                               "VALUES (:name, :price, :description, :imagePath) "
-                               "RETURNING product_id");
-    productInsertQuery.bindValue(":name", name);
-    productInsertQuery.bindValue(":price", price);
-    productInsertQuery.bindValue(":description", description);
-    productInsertQuery.bindValue(":imagePath", imagePath);
-    int newProductId = -1;
-    if (productInsertQuery.exec()) {
-        if (productInsertQuery.next()) {
-            newProductId = productInsertQuery.value(0).toInt();
-            qDebug() << "DatabaseHandler: Product inserted with ID:" << newProductId;
-        } else {
-            qWarning() << "DatabaseHandler: Failed to retrieve new product_id after insert.";
+QList<ProductInsertResult> DatabaseHandler::addProducts(const QJsonArray& productsData)
+{
+    QList<ProductInsertResult> results(productsData.size());
+
+    // 1. Проверка в памяти: неверные элементы и повторы имен внутри пакета в БД не уходят
+    struct PendingProduct
+    {
+        int index;
+        CatalogProduct product;
+        QList<int> categoryIds;
+    };
+    QList<PendingProduct> pending;
+    QHash<QString, int> indexByName;
+    for (int i = 0; i < productsData.size(); ++i) {
+        const QJsonObject productData = productsData.at(i).toObject();
+        CatalogProduct product;
+        product.name = productData.value("product_name").toString();
+        product.price = productData.value("product_price").toDouble();
+        product.description = productData.value("product_description").toString();
+        product.imagePath = productData.value("product_image_path").toString();
+        product.stock = productData.value("product_stock").toInt(1);
+
+        if (product.name.isEmpty() || product.name.size() > 255 || product.price <= 0 || product.stock < 0) {
+            results[i] = {DbStatus::Invalid, -1, "Invalid product data (name, price or stock)."};
+            continue;
         }
-    } else {
-        qWarning() << "DatabaseHandler: Failed to insert into Products table. Error:" << productInsertQuery.lastError().text();
-    }
-
-    if (newProductId == -1) {
-        m_db.rollback();
-        return false; // Не удалось вставить товар или получить ID
-    }
-
-    // 3. Привязка товара к категориям в Products_Categories
-    bool allCategoryLinksSuccessful = true;
-    if (!categoryIdsJson.isEmpty()) {
-        QSqlQuery ProductCategoryInsertQuery(m_db);
-        // Сначала проверим существование категорий (как в процедуре)
-        for (const QJsonValue& val : categoryIdsJson) {
-            int categoryId = val.toInt();
-            if (categoryId <= 0) continue; // Пропускаем невалидные ID
-
-            // Проверка существования категории
-            QSqlQuery checkCategoryQuery(m_db);
-            checkCategoryQuery.prepare("SELECT 1 FROM Categories WHERE category_id = :catId");
-            checkCategoryQuery.bindValue(":catId", categoryId);
-            if (!checkCategoryQuery.exec() || !checkCategoryQuery.next()) {
-                qWarning() << "DatabaseHandler: Category with ID" << categoryId << "not found. Skipping link for product ID" << newProductId;
-                continue; // Пропускаем эту категорию, но не прерываем всю операцию (согласно RAISE WARNING в процедуре)
+        if (indexByName.contains(product.name)) {
+            results[i] = {DbStatus::Conflict, -1, "Duplicate product_name in request."};
+            continue;
+        }
+        QList<int> categoryIds;
+        for (const QJsonValue& val : productData.value("category_ids").toArray()) {
+            if (val.toInt() > 0) {
+                categoryIds.append(val.toInt());
             }
+        }
+        indexByName.insert(product.name, i);
+        pending.append({i, product, categoryIds});
+    }
+    if (pending.isEmpty()) {
+        return results;
+    }
 
-            // Категория существует, пытаемся вставить связь
-            ProductCategoryInsertQuery.prepare("INSERT INTO Products_Categories (product_id, category_id) "
-                                               "VALUES (:productId, :categoryId) "
-                                               "ON CONFLICT (product_id, category_id) DO NOTHING");
-            ProductCategoryInsertQuery.bindValue(":productId", newProductId);
-            ProductCategoryInsertQuery.bindValue(":categoryId", categoryId);
-
-            if (!ProductCategoryInsertQuery.exec()) {
-                qWarning() << "DatabaseHandler: Failed to insert into Products_Categories for product_id"
-                           << newProductId << "and category_id" << categoryId
-                           << ". Error:" << ProductCategoryInsertQuery.lastError().text();
-                allCategoryLinksSuccessful = false; // Отмечаем, что не все связи успешны
-                // В оригинальной процедуре это был RAISE WARNING, операция не откатывалась полностью из-за этого.
-                // Если нужна строгая атомарность (все или ничего), здесь можно сделать break и откатить.
-                // Пока что продолжаем, как в процедуре (предупреждение и продолжение).
-            } else {
-                qDebug() << "DatabaseHandler: Linked product" << newProductId << "to category" << categoryId;
-            }
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    auto failAll = [&](const QString &error) {
+        for (const PendingProduct &item : std::as_const(pending)) {
+            results[item.index] = {DbStatus::Error, -1, error};
         }
+        return results;
+    };
+    if (!db.isOpen() || !db.transaction()) {
+        qWarning() << "DatabaseHandler: Failed to start transaction for addProducts:" << db.lastError().text();
+        return failAll("Database error.");
     }
-    // В данном случае, даже если не все связи с категориями удались (были WARNINGS),
-    // сам товар добавлен. Логика процедуры не предполагала откат из-за отсутствия категории.
-    success = true;
 
+    // 2. Все товары пакета - один INSERT из массивов. Имя, уже занятое активным товаром,
+    // не вставляется (ON CONFLICT по частичному уникальному индексу) и не ломает остальные.
+    QStringList names, descriptions, imagePaths;
+    QList<double> prices;
+    QList<int> stocks;
+    for (const PendingProduct &item : std::as_const(pending)) {
+        names.append(item.product.name);
+        descriptions.append(item.product.description);
+        imagePaths.append(item.product.imagePath);
+        prices.append(item.product.price);
+        stocks.append(item.product.stock);
+    }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("INSERT INTO Products (product_name, product_price, product_description, product_image_path, product_stock) "
+                  "SELECT * FROM unnest(CAST(:names AS TEXT[]), CAST(:prices AS NUMERIC[]), CAST(:descriptions AS TEXT[]), "
+                  "                     CAST(:imagePaths AS TEXT[]), CAST(:stocks AS INT[])) "
+                  "ON CONFLICT (product_name) WHERE product_is_active DO NOTHING "
+                  "RETURNING product_id, product_name");
+    query.bindValue(":names", textArrayLiteral(names));
+    query.bindValue(":prices", numericArrayLiteral(prices));
+    query.bindValue(":descriptions", textArrayLiteral(descriptions));
+    query.bindValue(":imagePaths", textArrayLiteral(imagePaths));
+    query.bindValue(":stocks", intArrayLiteral(stocks));
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to insert products. Error:" << query.lastError().text();
+        db.rollback();
+        return failAll("Database error while inserting products.");
+    }
+    QHash<QString, int> insertedIds;
+    while (query.next()) {
+        insertedIds.insert(query.value(1).toString(), query.value(0).toInt());
+    }
 
-    if (success) {
-        if (!m_db.commit()) {
-            qWarning() << "DatabaseHandler: Failed to commit transaction for addProduct:" << m_db.lastError().text();
-            m_db.rollback(); // Попытка отката, если commit не удался
-            return false;
+    // 3. Все связи с категориями - второй и последний запрос. Несуществующие категории
+    // отсекает JOIN, как раньше отдельная проверка SELECT 1 FROM Categories на каждую.
+    QList<int> linkProductIds, linkCategoryIds;
+    for (PendingProduct &item : pending) {
+        item.product.id = insertedIds.value(item.product.name, -1);
+        if (item.product.id == -1) {
+            continue;
+        }
+        for (int categoryId : std::as_const(item.categoryIds)) {
+            linkProductIds.append(item.product.id);
+            linkCategoryIds.append(categoryId);
+        }
+    }
+    QHash<int, QList<int>> linkedCategories;
+    if (!linkProductIds.isEmpty()) {
+        query.prepare("INSERT INTO Products_Categories (product_id, category_id) "
+                      "SELECT l.product_id, l.category_id "
+                      "FROM unnest(CAST(:productIds AS INT[]), CAST(:categoryIds AS INT[])) AS l(product_id, category_id) "
+                      "JOIN Categories c ON c.category_id = l.category_id "
+                      "ON CONFLICT (product_id, category_id) DO NOTHING "
+                      "RETURNING product_id, category_id");
+        query.bindValue(":productIds", intArrayLiteral(linkProductIds));
+        query.bindValue(":categoryIds", intArrayLiteral(linkCategoryIds));
+        if (!query.exec()) {
+            qWarning() << "DatabaseHandler: Failed to link products to categories. Error:" << query.lastError().text();
+            db.rollback();
+            return failAll("Database error while linking categories.");
+        }
+        while (query.next()) {
+            linkedCategories[query.value(0).toInt()].append(query.value(1).toInt());
         }
-        qDebug() << "DatabaseHandler: Product added successfully (ID:" << newProductId << ") and transaction committed.";
-        return true;
-    } else {
-        qWarning() << "DatabaseHandler: addProduct failed, rolling back transaction.";
-        m_db.rollback();
-        return false;
     }
-}
 
-bool DatabaseHandler::addToCart(int userId, int productId)
-{
-    if (!m_db.isOpen()) {
-        qWarning() << "DatabaseHandler: Database is not open.";
-        return false;
+    if (!db.commit()) {
+        qWarning() << "DatabaseHandler: Failed to commit transaction for addProducts:" << db.lastError().text();
+        db.rollback();
+        return failAll("Database error while committing.");
     }
 
-    QSqlQuery checkUserQuery(m_db);
-    checkUserQuery.prepare("SELECT 1 FROM Users WHERE user_id = :userId");
-    checkUserQuery.bindValue(":userId", userId);
-    if (!checkUserQuery.exec()) {
-        qWarning() << "DatabaseHandler: addToCart - Failed to check user existence. Error:" << checkUserQuery.lastError().text();
-        return false;
+    QHash<int, int> newStock;
+    for (const PendingProduct &item : std::as_const(pending)) {
+        if (item.product.id == -1) {
+            results[item.index] = {DbStatus::Conflict, -1, "Product with this name already exists."};
+        } else {
+            results[item.index] = {DbStatus::Ok, item.product.id, QString()};
+            newStock.insert(item.product.id, item.product.stock);
+        }
     }
-    if (!checkUserQuery.next()) { // Пользователь не найден
-        qWarning() << "DatabaseHandler: addToCart - User with ID" << userId << "not found.";
-        return false;
+    qDebug() << "DatabaseHandler: Added" << newStock.size() << "of" << productsData.size() << "product(s)";
+    if (newStock.isEmpty()) {
+        return results;
     }
 
-    QSqlQuery checkProductQuery(m_db);
-    checkProductQuery.prepare("SELECT 1 FROM Products WHERE product_id = :productId");
-    checkProductQuery.bindValue(":productId", productId);
-    if (!checkProductQuery.exec()) {
-        qWarning() << "DatabaseHandler: addToCart - Failed to check product existence. Error:" << checkProductQuery.lastError().text();
-        return false;
+    m_catalog.update([&](CatalogSnapshot &catalog) {
+        for (const PendingProduct &item : std::as_const(pending)) {
+            if (item.product.id != -1) {
+                catalog.addProduct(item.product, linkedCategories.value(item.product.id));
+            }
+        }
+    });
+    for (const PendingProduct &item : std::as_const(pending)) {
+        if (item.product.id != -1) {
+            m_productIds.insert(item.product.id);
+            m_suggest.insert(item.product.id, item.product.name);
+        }
+    }
+    m_stock.addProducts(newStock);
+    return results;
+}
+
+DbStatus DatabaseHandler::addToCart(int userId, int productId)
+{
+    // Несуществующие id отсекаются в памяти, без обращения к БД
+    if (!m_userIds.contains(userId)) {
+        qWarning() << "DatabaseHandler: addToCart - User with ID" << userId << "not found.";
+        return DbStatus::NotFound;
     }
-    if (!checkProductQuery.next()) { // Товар не найден
+    if (!m_productIds.contains(productId)) {
         qWarning() << "DatabaseHandler: addToCart - Product with ID" << productId << "not found or no longer available.";
-        return false;
+        return DbStatus::NotFound;
     }
 
-    // 3. Вставка в корзину
-    QSqlQuery insertQuery(m_db);
+    // Единица товара резервируется в памяти до записи в БД: если товар кончился, запроса нет вовсе
+    switch (m_stock.reserve(userId, productId)) {
+    case StockLedger::Status::Ok:
+        break;
+    case StockLedger::Status::SoldOut:
+        qDebug() << "DatabaseHandler: addToCart - Product" << productId << "is sold out.";
+        return DbStatus::SoldOut;
+    case StockLedger::Status::NotFound:
+        qWarning() << "DatabaseHandler: addToCart - Product with ID" << productId << "has no stock record.";
+        return DbStatus::NotFound;
+    }
+
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open.";
+        m_stock.release(userId, productId);
+        return DbStatus::Error;
+    }
+
+    // Единственный запрос: если строку успели удалить, его отклонят внешние ключи Cart
+    QSqlQuery insertQuery(db);
     insertQuery.prepare("INSERT INTO Cart (user_id, product_id) VALUES (:userId, :productId) "
                         "ON CONFLICT (user_id, product_id) DO NOTHING");
     insertQuery.bindValue(":userId", userId);
     insertQuery.bindValue(":productId", productId);
 
-    qDebug() << "DatabaseHandler: Attempting to add to cart (direct SQL). UserID:" << userId << "ProductID:" << productId;
-    qDebug() << "DatabaseHandler: Executing insert query:" << insertQuery.lastQuery(); // Показывает запрос с плейсхолдерами
-
     if (insertQuery.exec()) {
-        qDebug() << "DatabaseHandler: INSERT INTO Cart executed for UserID:" << userId << "ProductID:" << productId
-                 << ". Rows affected:" << insertQuery.numRowsAffected();
-        return true;
-    } else {
-        qWarning() << "DatabaseHandler: Failed to add to cart (direct SQL insert). Error:" << insertQuery.lastError().text()
-        << "Native Error Code:" << insertQuery.lastError().nativeErrorCode()
-        << "Prepared Query:" << insertQuery.lastQuery();
-        return false;
+        return DbStatus::Ok;
     }
+
+    m_stock.release(userId, productId);
+    const QSqlError error = insertQuery.lastError();
+    // 23503 foreign_key_violation: пользователь или товар удален после проверки по карте
+    if (error.nativeErrorCode() == "23503") {
+        const QString details = error.databaseText();
+        if (details.contains("fk_user_id")) {
+            m_userIds.remove(userId);
+        } else if (details.contains("fk_product_id")) {
+            m_productIds.remove(productId);
+        }
+        qWarning() << "DatabaseHandler: addToCart - Referenced row is gone:" << details;
+        return DbStatus::NotFound;
+    }
+    qWarning() << "DatabaseHandler: Failed to add to cart. Error:" << error.text()
+               << "Native Error Code:" << error.nativeErrorCode();
+    return DbStatus::Error;
 }
 
-bool DatabaseHandler::placeOrder(int userId)
+DbStatus DatabaseHandler::placeOrder(int userId)
 {
-    if (!m_db.isOpen()) {
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
         qWarning() << "DatabaseHandler: Database is not open for placeOrder.";
-        return false;
-    }
-
-    // === НАЧАЛО ТРАНЗАКЦИИ (Обязательно) ===
-    if (!m_db.transaction()) {
-        qWarning() << "DatabaseHandler: Failed to start transaction for placeOrder:" << m_db.lastError().text();
-        return false;
+        return DbStatus::Error;
     }
 
-    // 1. Получаем ID товаров в корзине
-    QSqlQuery getCartQuery(m_db);
-    getCartQuery.prepare("SELECT product_id FROM Cart WHERE user_id = :userId");
-    getCartQuery.bindValue(":userId", userId);
-
-    if (!getCartQuery.exec()) {
-        qWarning() << "DatabaseHandler: Failed to query cart for placeOrder. Error:" << getCartQuery.lastError().text();
-        m_db.rollback();
-        return false;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    // Удаленные, но еще не очищенные товары остаются в корзине до фоновой очистки и не покупаются
+    query.prepare("SELECT c.product_id FROM Cart c JOIN Products p ON p.product_id = c.product_id "
+                  "WHERE c.user_id = :userId AND p.product_is_active");
+    query.bindValue(":userId", userId);
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to read cart for user" << userId << ". Error:" << query.lastError().text();
+        return DbStatus::Error;
     }
-
-    QList<int> productIdsInCart;
-    while (getCartQuery.next()) {
-        productIdsInCart.append(getCartQuery.value(0).toInt());
+    QList<int> productIds;
+    while (query.next()) {
+        productIds.append(query.value(0).toInt());
     }
-
-    if (productIdsInCart.isEmpty()) {
+    if (productIds.isEmpty()) {
         qDebug() << "DatabaseHandler: Cart is empty for user" << userId << ". Order cannot be placed.";
-        m_db.commit(); // Завершаем "пустую" транзакцию
-        return true;
+        return DbStatus::Ok;
     }
 
-    qDebug() << "DatabaseHandler: Placing order for user" << userId << ". Deleting products:" << productIdsInCart;
+    // Резервы в памяти - быстрая проверка: покупатель, которому не хватило товара,
+    // получает отказ без блокировки строк Products
+    QList<int> soldOut;
+    if (m_stock.claim(userId, productIds, &soldOut) != StockLedger::Status::Ok) {
+        qDebug() << "DatabaseHandler: Order for user" << userId << "rejected, sold out:" << soldOut;
+        return DbStatus::SoldOut;
+    }
 
-    // 2. Удаление каждого товара из таблицы Products
-    QSqlQuery deleteProductQuery(m_db);
-    for (int productId : productIdsInCart) {
-        deleteProductQuery.prepare("DELETE FROM Products WHERE product_id = :productId");
-        deleteProductQuery.bindValue(":productId", productId);
-        if (!deleteProductQuery.exec()) {
-            qWarning() << "DatabaseHandler: Failed to delete product ID" << productId << ". Error:" << deleteProductQuery.lastError().text();
-            m_db.rollback();
-            return false;
+    // Списание остатка и удаление строк корзины - одна транзакция (fn_PlaceOrder):
+    // подтвержденный заказ не теряется при падении сервера
+    query.prepare("SELECT purchased_product_id, remaining_stock FROM fn_PlaceOrder(:userId, CAST(:productIds AS INT[]))");
+    query.bindValue(":userId", userId);
+    query.bindValue(":productIds", intArrayLiteral(productIds));
+    bool placed = query.exec();
+    // 55P03 lock_not_available: блокировку строк слишком долго держат другие заказы.
+    // Единицы остаются забранными за покупателем, поэтому повтор не может их потерять.
+    for (int attempt = 1; !placed && attempt < kPlaceOrderAttempts
+                          && query.lastError().nativeErrorCode() == "55P03"; ++attempt) {
+        qDebug() << "DatabaseHandler: placeOrder for user" << userId << "timed out on row locks, retry" << attempt;
+        QThread::msleep(kPlaceOrderRetryDelayMs * attempt);
+        placed = query.exec();
+    }
+    if (!placed) {
+        const QSqlError error = query.lastError();
+        m_stock.cancelClaim(userId, productIds);
+        if (error.nativeErrorCode() == "55P03") {
+            qWarning() << "DatabaseHandler: placeOrder for user" << userId << "gave up waiting for row locks.";
+            return DbStatus::Conflict;
+        }
+        // 23514 check_violation: в БД товара меньше, чем считает StockLedger
+        if (error.nativeErrorCode() == "23514") {
+            qWarning() << "DatabaseHandler: Stock in database is lower than in memory, order for user"
+                       << userId << "rejected. Products:" << productIds;
+            return DbStatus::SoldOut;
         }
+        qWarning() << "DatabaseHandler: Failed to place order for user" << userId << ". Error:" << error.text();
+        return DbStatus::Error;
     }
-
-    // 3. Очистка корзины пользователя (это может быть избыточно, если настроено каскадное удаление, но для надежности оставляем)
-    QSqlQuery clearCartQuery(m_db);
-    clearCartQuery.prepare("DELETE FROM Cart WHERE user_id = :userId");
-    clearCartQuery.bindValue(":userId", userId);
-    if (!clearCartQuery.exec()) {
-        qWarning() << "DatabaseHandler: Failed to clear cart for user ID" << userId << ". Error:" << clearCartQuery.lastError().text();
-        m_db.rollback();
-        return false;
+    QSet<int> purchased;
+    while (query.next()) {
+        purchased.insert(query.value(0).toInt());
     }
-
-    // === ЗАВЕРШЕНИЕ ТРАНЗАКЦИИ ===
-    if (!m_db.commit()) {
-        qWarning() << "DatabaseHandler: Failed to commit transaction for placeOrder:" << m_db.lastError().text();
-        m_db.rollback();
-        return false;
+    // Товар, снятый с продажи во время оформления, не списан: его единица возвращается покупателю
+    QList<int> notPurchased;
+    for (int productId : std::as_const(productIds)) {
+        if (!purchased.contains(productId)) {
+            notPurchased.append(productId);
+        }
+    }
+    if (!notPurchased.isEmpty()) {
+        m_stock.cancelClaim(userId, notPurchased);
+    }
+    {
+        QMutexLocker locker(&m_stockChangesMutex);
+        m_stockChanges.unite(purchased);
     }
 
-    qDebug() << "DatabaseHandler: Order placed successfully for user" << userId;
-    return true;
+    qDebug() << "DatabaseHandler: Order placed successfully for user" << userId << ". Products:" << purchased.values();
+    return DbStatus::Ok;
 }
 
 QJsonObject DatabaseHandler::authenticateUser(const QString& login, const QString& password)
 {
     QJsonObject userData;
-    if (!m_db.isOpen()) {
-        qWarning() << "Database is not open.";
-        return userData;
-    }
-
-    QSqlQuery query(m_db);
-    // Вызываем функцию fn_AuthenticateUser
-    query.prepare("SELECT user_id, user_role FROM fn_AuthenticateUser(:login, :password)");
-    query.bindValue(":login", login);
-    query.bindValue(":password", password);
+    QByteArray passwordHash;
+    {
+        // Соединение нужно только чтобы прочитать хеш: bcrypt считается уже после его возврата в пул
+        PooledConnection connection = m_pool.acquire();
+        QSqlDatabase db = connection.database();
+        if (!db.isOpen()) {
+            qWarning() << "Database is not open.";
+            return userData;
+        }
 
-    if (query.exec()) {
-        if (query.next()) { // Если пользователь найден и пароль верный
-            userData["user_id"] = query.value("user_id").toInt();
-            userData["user_role"] = query.value("user_role").toString();
-        } else {
-            qDebug() << "Authentication failed for user:" << login;
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT user_id, user_role, user_password FROM Users WHERE user_name = :login");
+        query.bindValue(":login", login);
+        if (!query.exec()) {
+            qWarning() << "Authentication query failed:" << query.lastError().text();
+            return userData;
         }
-    } else {
-        qWarning() << "Authentication query failed:" << query.lastError().text();
+        if (query.next()) {
+            userData["user_id"] = query.value(0).toInt();
+            userData["user_role"] = query.value(1).toString();
+            passwordHash = query.value(2).toString().toLatin1();
+        }
+    }
+
+    if (userData.isEmpty()) {
+        PasswordVerifier::verifyDummy(password.toUtf8());
+        qDebug() << "Authentication failed for user:" << login;
+        return userData;
+    }
+    if (!PasswordVerifier::verify(password.toUtf8(), passwordHash)) {
+        qDebug() << "Authentication failed for user:" << login;
+        return QJsonObject();
     }
+    // Пользователей добавляют в БД напрямую, поэтому карта id пополняется и при входе
+    m_userIds.insert(userData["user_id"].toInt());
     return userData;
 }
 
 bool DatabaseHandler::addCategory(const QString& categoryName)
 {
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
     if (categoryName.isEmpty()) return false;
-    QSqlQuery query(m_db);
-    query.prepare("INSERT INTO Categories (category_name) VALUES (:name) ON CONFLICT (category_name) DO NOTHING");
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO Categories (category_name) VALUES (:name) ON CONFLICT (category_name) DO NOTHING "
+                  "RETURNING category_id");
     query.bindValue(":name", categoryName);
     if (!query.exec()) {
         qWarning() << "DatabaseHandler: Failed to add category. Error:" << query.lastError().text();
         return false;
     }
+    if (query.next()) { // Пустой результат - категория с таким именем уже есть
+        CatalogCategory category{query.value(0).toInt(), categoryName};
+        m_catalog.update([&](CatalogSnapshot &catalog) { catalog.addCategory(category); });
+    }
     return true;
 }
 
 QJsonObject DatabaseHandler::getCartContents(int userId)
 {
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
     QJsonObject result;
     QJsonArray itemsArray;
     double totalPrice = 0.0;
 
-    if (!m_db.isOpen()) {
+    if (!db.isOpen()) {
         qWarning() << "DatabaseHandler: Database is not open for getCartContents.";
         result["error"] = "Database connection failed.";
         return result;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     query.prepare("SELECT p.product_id, p.product_name, p.product_price, p.product_image_path "
                   "FROM Cart c JOIN Products p ON c.product_id = p.product_id "
-                  "WHERE c.user_id = :userId");
+                  "WHERE c.user_id = :userId AND p.product_is_active");
     query.bindValue(":userId", userId);
 
     if (query.exec()) {
@@ -408,17 +748,20 @@ QJsonObject DatabaseHandler::getCartContents(int userId)
 
 bool DatabaseHandler::removeFromCart(int userId, int productId)
 {
-    if (!m_db.isOpen()) {
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
         qWarning() << "DatabaseHandler: Database is not open for removeFromCart.";
         return false;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     query.prepare("DELETE FROM Cart WHERE user_id = :userId AND product_id = :productId");
     query.bindValue(":userId", userId);
     query.bindValue(":productId", productId);
 
     if (query.exec()) {
+        m_stock.release(userId, productId);
         qDebug() << "DatabaseHandler: removeFromCart executed for UserID:" << userId << "ProductID:" << productId
                  << ". Rows affected:" << query.numRowsAffected();
         return true;
@@ -428,119 +771,306 @@ bool DatabaseHandler::removeFromCart(int userId, int productId)
     }
 }
 
-bool DatabaseHandler::deleteProduct(int productId)
+DbStatus DatabaseHandler::deleteProduct(int productId)
 {
-    QSqlQuery query(m_db);
-    query.prepare("DELETE FROM Products WHERE product_id = :id");
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for deleteProduct.";
+        return DbStatus::Error;
+    }
+    // Товар только помечается удаленным: каскады в Cart и Products_Categories
+    // выполнит фоновая очистка, а не запрос администратора
+    QSqlQuery query(db);
+    query.prepare("UPDATE Products SET product_is_active = FALSE, product_deleted_at = now() "
+                  "WHERE product_id = :id AND product_is_active");
     query.bindValue(":id", productId);
     if (!query.exec()) {
         qWarning() << "DatabaseHandler: Failed to delete product. Error:" << query.lastError().text();
-        return false;
+        return DbStatus::Error;
+    }
+    if (query.numRowsAffected() <= 0) {
+        qDebug() << "DatabaseHandler: Product" << productId << "not found for delete.";
+        return DbStatus::NotFound;
     }
-    return query.numRowsAffected() > 0;
+    m_catalog.update([&](CatalogSnapshot &catalog) { catalog.removeProduct(productId); });
+    m_productIds.remove(productId);
+    m_suggest.remove(productId);
+    m_stock.removeProducts({productId});
+    return DbStatus::Ok;
 }
 
-bool DatabaseHandler::deleteCategory(int categoryId)
+int DatabaseHandler::deleteCategoryBatch(int categoryId, int batchSize)
 {
-    // Требование: каскадное удаление товаров, которые находятся ТОЛЬКО в этой категории
-    if (!m_db.transaction()) {
-        qWarning() << "DatabaseHandler: Failed to start transaction for deleteCategory.";
-        return false;
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for deleteCategoryBatch.";
+        return -1;
     }
 
-    // 1. Находим продукты, которые состоят только в удаляемой категории
-    QSqlQuery findProductsQuery(m_db);
-    findProductsQuery.prepare(
-        "SELECT p.product_id FROM Products p "
-        "JOIN Products_Categories pc ON p.product_id = pc.product_id "
-        "LEFT JOIN Products_Categories pc2 ON p.product_id = pc2.product_id AND pc2.category_id != :cat_id "
-        "WHERE pc.category_id = :cat_id "
-        "GROUP BY p.product_id "
-        "HAVING COUNT(pc2.category_id) = 0"
+    // Одна пачка - один оператор и одна короткая транзакция: снимаются до batchSize связей
+    // с категорией, а товары, у которых не остается других категорий, помечаются удаленными.
+    // Все подзапросы видят один снимок, поэтому NOT EXISTS учитывает связи до удаления.
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(
+        "WITH batch AS ("
+        "    SELECT product_id FROM Products_Categories "
+        "    WHERE category_id = :cat_id ORDER BY product_id LIMIT :limit"
+        "), deactivated AS ("
+        "    UPDATE Products p SET product_is_active = FALSE, product_deleted_at = now() "
+        "    FROM batch b "
+        "    WHERE p.product_id = b.product_id AND p.product_is_active "
+        "    AND NOT EXISTS (SELECT 1 FROM Products_Categories pc2 "
+        "                    WHERE pc2.product_id = p.product_id AND pc2.category_id != :cat_id) "
+        "    RETURNING p.product_id"
+        "), unlinked AS ("
+        "    DELETE FROM Products_Categories pc USING batch b "
+        "    WHERE pc.category_id = :cat_id AND pc.product_id = b.product_id "
+        "    RETURNING pc.product_id"
+        ") "
+        "SELECT u.product_id, d.product_id IS NOT NULL "
+        "FROM unlinked u LEFT JOIN deactivated d ON d.product_id = u.product_id"
         );
-    findProductsQuery.bindValue(":cat_id", categoryId);
-    if (!findProductsQuery.exec()) {
-        qWarning() << "DatabaseHandler: Failed to find unique products for category. Error:" << findProductsQuery.lastError().text();
-        m_db.rollback();
-        return false;
+    query.bindValue(":cat_id", categoryId);
+    query.bindValue(":limit", batchSize);
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to delete a batch of category" << categoryId
+                   << ". Error:" << query.lastError().text();
+        return -1;
     }
 
-    QList<int> productsToDelete;
-    while (findProductsQuery.next()) {
-        productsToDelete.append(findProductsQuery.value(0).toInt());
+    QList<int> unlinked;
+    QList<int> deactivated;
+    while (query.next()) {
+        const int productId = query.value(0).toInt();
+        if (query.value(1).toBool()) {
+            deactivated.append(productId);
+        } else {
+            unlinked.append(productId);
+        }
+    }
+    if (unlinked.isEmpty() && deactivated.isEmpty()) {
+        return 0;
     }
 
-    // 2. Удаляем эти продукты
-    if (!productsToDelete.isEmpty()) {
-        for (int prodId : productsToDelete) {
-            if (!deleteProduct(prodId)) { // Используем уже созданный метод
-                qWarning() << "DatabaseHandler: Failed during cascade delete of product" << prodId;
-                m_db.rollback();
-                return false;
-            }
+    m_catalog.update([&](CatalogSnapshot &catalog) {
+        for (int productId : std::as_const(deactivated)) {
+            catalog.removeProduct(productId);
         }
+        for (int productId : std::as_const(unlinked)) {
+            catalog.unlinkProduct(productId, categoryId);
+        }
+    });
+    for (int productId : std::as_const(deactivated)) {
+        m_productIds.remove(productId);
+        m_suggest.remove(productId);
+    }
+    m_stock.removeProducts(deactivated);
+    return int(unlinked.size() + deactivated.size());
+}
+
+bool DatabaseHandler::deleteCategoryRow(int categoryId)
+{
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for deleteCategoryRow.";
+        return false;
     }
 
-    // 3. Удаляем саму категорию (связи в Products_Categories удалятся каскадно благодаря FK)
-    QSqlQuery deleteCatQuery(m_db);
-    deleteCatQuery.prepare("DELETE FROM Categories WHERE category_id = :id");
-    deleteCatQuery.bindValue(":id", categoryId);
-    if (!deleteCatQuery.exec()) {
-        qWarning() << "DatabaseHandler: Failed to delete category itself. Error:" << deleteCatQuery.lastError().text();
-        m_db.rollback();
+    // Связей к этому моменту уже нет (или осталось столько, сколько добавили во время удаления)
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM Categories WHERE category_id = :id");
+    query.bindValue(":id", categoryId);
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to delete category itself. Error:" << query.lastError().text();
         return false;
     }
+    m_catalog.update([&](CatalogSnapshot &catalog) { catalog.removeCategory(categoryId); });
+    return true;
+}
+
+int DatabaseHandler::purgeInactiveProducts(int batchSize)
+{
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for purgeInactiveProducts.";
+        return -1;
+    }
+
+    // Самые давно удаленные строки идут первыми (частичный индекс ix_products_inactive);
+    // строки, занятые другими транзакциями, пропускаются до следующей пачки.
+    // Каскады в Cart и Products_Categories ограничены размером пачки.
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM Products WHERE product_id IN ("
+                  "SELECT product_id FROM Products "
+                  "WHERE NOT product_is_active AND product_deleted_at < now() - interval '10 minutes' "
+                  "ORDER BY product_deleted_at LIMIT :limit FOR UPDATE SKIP LOCKED)");
+    query.bindValue(":limit", batchSize);
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to purge inactive products. Error:" << query.lastError().text();
+        return -1;
+    }
+    const int purged = query.numRowsAffected();
+    if (purged > 0) {
+        m_purgedProducts += purged;
+        ++m_purgeBatches;
+        qDebug() << "DatabaseHandler: Purged" << purged << "inactive product(s)";
+    }
+    return purged;
+}
 
-    return m_db.commit();
+QJsonObject DatabaseHandler::purgeStats() const
+{
+    QJsonObject result;
+    result["purged_products"] = qint64(m_purgedProducts.load());
+    result["batches"] = qint64(m_purgeBatches.load());
+    return result;
 }
 
 
-bool DatabaseHandler::updateProductField(int productId, const QString& fieldName, const QVariant& value)
+DbStatus DatabaseHandler::updateProductField(int productId, const QString& fieldName, const QVariant& value)
 {
+    if (fieldName == "product_stock") {
+        return updateProductStock(productId, value.toInt());
+    }
+
     // Внимание: динамическое формирование имени столбца - потенциально небезопасно.
     // Убедимся, что fieldName - одно из разрешенных полей.
     const QSet<QString> allowedFields = {"product_name", "product_description", "product_price", "product_image_path"};
     if (!allowedFields.contains(fieldName)) {
         qWarning() << "DatabaseHandler: Attempt to update a non-allowed field:" << fieldName;
-        return false;
+        return DbStatus::Invalid;
+    }
+
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for updateProductField.";
+        return DbStatus::Error;
     }
 
-    QSqlQuery query(m_db);
+    QSqlQuery query(db);
     // Формируем запрос с плейсхолдером для имени столбца
-    query.prepare(QString("UPDATE Products SET %1 = :value WHERE product_id = :id").arg(fieldName));
+    query.prepare(QString("UPDATE Products SET %1 = :value WHERE product_id = :id AND product_is_active").arg(fieldName));
     query.bindValue(":value", value);
     query.bindValue(":id", productId);
 
     if (!query.exec()) {
-        qWarning() << "DatabaseHandler: Failed to update product field" << fieldName << ". Error:" << query.lastError().text();
-        return false;
+        const QSqlError error = query.lastError();
+        // 23505 unique_violation: активный товар с таким названием уже есть
+        if (error.nativeErrorCode() == "23505") {
+            qDebug() << "DatabaseHandler: Product name" << value.toString() << "is already taken.";
+            return DbStatus::Conflict;
+        }
+        qWarning() << "DatabaseHandler: Failed to update product field" << fieldName << ". Error:" << error.text();
+        return DbStatus::Error;
     }
-    return true;
+    // Несуществующий или удаленный товар: снимок и индекс подсказок не трогаются
+    if (query.numRowsAffected() <= 0) {
+        qDebug() << "DatabaseHandler: Product" << productId << "not found for update.";
+        return DbStatus::NotFound;
+    }
+
+    m_catalog.update([&](CatalogSnapshot &catalog) {
+        if (fieldName == "product_name") {
+            catalog.setProductName(productId, value.toString());
+        } else if (fieldName == "product_description") {
+            auto it = catalog.products.find(productId);
+            if (it != catalog.products.end()) {
+                it->description = value.toString();
+            }
+        } else if (fieldName == "product_price") {
+            catalog.setProductPrice(productId, value.toDouble());
+        } else if (fieldName == "product_image_path") {
+            catalog.setProductImage(productId, value.toString());
+        }
+    });
+    if (fieldName == "product_name") {
+        m_suggest.rename(productId, value.toString());
+    }
+    return DbStatus::Ok;
+}
+
+DbStatus DatabaseHandler::updateProductStock(int productId, int stock)
+{
+    if (stock < 0) {
+        qWarning() << "DatabaseHandler: Invalid stock" << stock << "for product" << productId;
+        return DbStatus::Invalid;
+    }
+
+    // Резервы в памяти отсчитываются от остатка в БД, поэтому в памяти остаток меняется
+    // на ту же разницу, а не заменяется новым значением. Строка заблокирована FOR UPDATE,
+    // поэтому заказы не изменят ее между чтением старого остатка и записью нового.
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen() || !db.transaction()) {
+        qWarning() << "DatabaseHandler: Failed to start transaction for updateProductStock.";
+        return DbStatus::Error;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("SELECT product_stock FROM Products WHERE product_id = :id AND product_is_active FOR UPDATE");
+    query.bindValue(":id", productId);
+    if (!query.exec()) {
+        qWarning() << "DatabaseHandler: Failed to lock product for stock update. Error:" << query.lastError().text();
+        db.rollback();
+        return DbStatus::Error;
+    }
+    if (!query.next()) {
+        qDebug() << "DatabaseHandler: Product" << productId << "not found for stock update.";
+        db.rollback();
+        return DbStatus::NotFound;
+    }
+    const int oldStock = query.value(0).toInt();
+
+    query.prepare("UPDATE Products SET product_stock = :stock WHERE product_id = :id");
+    query.bindValue(":stock", stock);
+    query.bindValue(":id", productId);
+    if (!query.exec() || !db.commit()) {
+        qWarning() << "DatabaseHandler: Failed to update product stock. Error:" << query.lastError().text();
+        db.rollback();
+        return DbStatus::Error;
+    }
+
+    m_stock.adjust(productId, stock - oldStock);
+    m_catalog.updateStock([&](CatalogSnapshot &catalog) { catalog.setProductStock(productId, stock); });
+    return DbStatus::Ok;
 }
 
 bool DatabaseHandler::changeProductCategory(int productId, int oldCategoryId, int newCategoryId)
 {
     if (oldCategoryId == newCategoryId) return true; // Категория не изменилась
 
-    if (!m_db.transaction()) {
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for changeProductCategory.";
+        return false;
+    }
+
+    if (!db.transaction()) {
         qWarning() << "DatabaseHandler: Failed to start transaction for changeProductCategory.";
         return false;
     }
 
     // 1. Удаляем старую связь
-    QSqlQuery deleteQuery(m_db);
+    QSqlQuery deleteQuery(db);
     deleteQuery.prepare("DELETE FROM Products_Categories WHERE product_id = :prodId AND category_id = :oldCatId");
     deleteQuery.bindValue(":prodId", productId);
     deleteQuery.bindValue(":oldCatId", oldCategoryId);
 
     if (!deleteQuery.exec()) {
         qWarning() << "changeProductCategory: Failed to delete old category link. Error:" << deleteQuery.lastError().text();
-        m_db.rollback();
+        db.rollback();
         return false;
     }
 
     // 2. Добавляем новую связь (с проверкой на существование, если нужно)
-    QSqlQuery insertQuery(m_db);
+    QSqlQuery insertQuery(db);
     insertQuery.prepare("INSERT INTO Products_Categories (product_id, category_id) VALUES (:prodId, :newCatId) "
                         "ON CONFLICT (product_id, category_id) DO NOTHING");
     insertQuery.bindValue(":prodId", productId);
@@ -548,10 +1078,285 @@ bool DatabaseHandler::changeProductCategory(int productId, int oldCategoryId, in
 
     if (!insertQuery.exec()) {
         qWarning() << "changeProductCategory: Failed to insert new category link. Error:" << insertQuery.lastError().text();
-        m_db.rollback();
+        db.rollback();
         return false;
     }
 
     qDebug() << "DatabaseHandler: Changed category for product" << productId << "from" << oldCategoryId << "to" << newCategoryId;
-    return m_db.commit();
+    if (!db.commit()) {
+        return false;
+    }
+    m_catalog.update([&](CatalogSnapshot &catalog) {
+        catalog.unlinkProduct(productId, oldCategoryId);
+        catalog.linkProduct(productId, newCategoryId);
+    });
+    return true;
+}
+
+ImportResult DatabaseHandler::importProducts(ProductImportReader &reader,
+                                             const std::function<bool(const ImportProgress&)> &onProgress)
+{
+    ImportResult result;
+    ImportProgress &progress = result.progress;
+    QElapsedTimer timer;
+    timer.start();
+    auto report = [&]() {
+        progress.bytesRead = reader.bytesRead();
+        progress.rowsPerSecond = progress.rowsRead * 1000.0 / qMax<qint64>(1, timer.elapsed());
+        return onProgress(progress);
+    };
+
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    if (!db.isOpen()) {
+        qWarning() << "DatabaseHandler: Database is not open for importProducts.";
+        result.error = "Database is not open.";
+        return result;
+    }
+    // QSqlQuery не умеет COPY FROM STDIN, поэтому данные передаются через libpq
+    // по тому же соединению и в той же транзакции
+    const QVariant handle = db.driver()->handle();
+    PGconn *pg = nullptr;
+    if (handle.isValid() && qstrcmp(handle.typeName(), "PGconn*") == 0) {
+        pg = *static_cast<PGconn *const *>(handle.constData());
+    }
+    if (!pg || !db.transaction()) {
+        qWarning() << "DatabaseHandler: Failed to start transaction for importProducts:" << db.lastError().text();
+        result.error = "Database error.";
+        return result;
+    }
+    auto fail = [&](const QString &error) {
+        db.rollback();
+        result.error = error;
+        return result;
+    };
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SET LOCAL statement_timeout = 0")
+        || !query.exec("CREATE TEMP TABLE import_staging ("
+                       "line_no BIGINT, product_name TEXT, product_price NUMERIC(10, 2), product_description TEXT, "
+                       "product_image_path TEXT, product_stock INT, category_ids INT[]) ON COMMIT DROP")) {
+        qWarning() << "DatabaseHandler: Failed to create import staging table:" << query.lastError().text();
+        return fail("Database error while preparing import.");
+    }
+
+    // 1. Записи файла потоком идут в import_staging: в памяти только текущий блок строк
+    PGresult *copyStart = PQexec(pg, "COPY import_staging (line_no, product_name, product_price, product_description, "
+                                     "product_image_path, product_stock, category_ids) FROM STDIN");
+    const bool copyReady = PQresultStatus(copyStart) == PGRES_COPY_IN;
+    PQclear(copyStart);
+    if (!copyReady) {
+        qWarning() << "DatabaseHandler: Failed to start COPY:" << PQerrorMessage(pg);
+        return fail("Database error while starting COPY.");
+    }
+
+    QByteArray buffer;
+    buffer.reserve(kImportCopyBufferBytes * 2);
+    QByteArray row;
+    QString rejectReason;
+    bool sent = true;
+    bool cancelled = false;
+    while (reader.next(&row, &rejectReason)) {
+        ++progress.rowsRead;
+        if (row.isEmpty()) {
+            ++progress.rowsRejected;
+            if (result.rejects.size() < kMaxImportRejects) {
+                result.rejects.append({reader.recordNumber(), rejectReason});
+            }
+        } else {
+            buffer += row;
+            ++progress.rowsCopied;
+            if (buffer.size() >= kImportCopyBufferBytes) {
+                sent = PQputCopyData(pg, buffer.constData(), int(buffer.size())) == 1;
+                buffer.resize(0);
+                if (!sent) {
+                    break;
+                }
+            }
+        }
+        if (progress.rowsRead % kImportProgressInterval == 0 && !report()) {
+            cancelled = true;
+            break;
+        }
+    }
+    if (sent && !cancelled && !buffer.isEmpty()) {
+        sent = PQputCopyData(pg, buffer.constData(), int(buffer.size())) == 1;
+    }
+
+    // Сообщение об ошибке в PQputCopyEnd прерывает COPY на сервере
+    const bool abort = !sent || cancelled || !reader.error().isEmpty();
+    bool copied = PQputCopyEnd(pg, abort ? "Import aborted" : nullptr) == 1;
+    while (PGresult *copyResult = PQgetResult(pg)) {
+        if (PQresultStatus(copyResult) != PGRES_COMMAND_OK) {
+            copied = false;
+        }
+        PQclear(copyResult);
+    }
+    if (cancelled) {
+        return fail("Import cancelled.");
+    }
+    if (!reader.error().isEmpty()) {
+        return fail(reader.error());
+    }
+    if (!sent || !copied) {
+        qWarning() << "DatabaseHandler: COPY into import staging failed:" << PQerrorMessage(pg);
+        return fail("Database error while copying rows.");
+    }
+
+    progress.phase = "merge";
+    if (!report()) {
+        return fail("Import cancelled.");
+    }
+
+    // 2. Слияние одним запросом. Если имя встречается в файле несколько раз, побеждает последняя запись.
+    // Остатки в памяти отсчитываются от остатка в БД, поэтому, как и при изменении остатка
+    // администратором, обновляемые строки сначала блокируются: заказы не изменят их до фиксации.
+    // Запись без product_stock (NULL в import_staging) не трогает остаток существующего товара,
+    // а новый товар получает остаток 1, как по умолчанию у столбца. Имя, которое другая транзакция
+    // добавила уже после блокировки, пропускается (ON CONFLICT DO NOTHING).
+    if (!query.exec("WITH incoming AS ("
+                    "  SELECT DISTINCT ON (product_name) product_name, product_price, product_description, "
+                    "         product_image_path, product_stock "
+                    "  FROM import_staging ORDER BY product_name, line_no DESC), "
+                    "previous AS ("
+                    "  SELECT p.product_id, p.product_name, p.product_stock FROM Products p "
+                    "  JOIN incoming i ON i.product_name = p.product_name WHERE p.product_is_active FOR UPDATE OF p), "
+                    "updated AS ("
+                    "  UPDATE Products p SET "
+                    "    product_price = i.product_price, product_description = i.product_description, "
+                    "    product_image_path = i.product_image_path, "
+                    "    product_stock = COALESCE(i.product_stock, p.product_stock) "
+                    "  FROM previous pr JOIN incoming i ON i.product_name = pr.product_name "
+                    "  WHERE p.product_id = pr.product_id "
+                    "  RETURNING p.product_id, p.product_stock, pr.product_stock AS previous_stock), "
+                    "inserted AS ("
+                    "  INSERT INTO Products (product_name, product_price, product_description, product_image_path, product_stock) "
+                    "  SELECT i.product_name, i.product_price, i.product_description, i.product_image_path, "
+                    "         COALESCE(i.product_stock, 1) "
+                    "  FROM incoming i WHERE NOT EXISTS (SELECT 1 FROM previous pr WHERE pr.product_name = i.product_name) "
+                    "  ON CONFLICT (product_name) WHERE product_is_active DO NOTHING "
+                    "  RETURNING product_id, product_stock) "
+                    "SELECT product_id, product_stock, previous_stock FROM updated "
+                    "UNION ALL SELECT product_id, product_stock, NULL FROM inserted")) {
+        qWarning() << "DatabaseHandler: Failed to merge imported products. Error:" << query.lastError().text();
+        return fail("Database error while merging products.");
+    }
+    QHash<int, int> newStock;
+    QHash<int, int> stockDelta;
+    while (query.next()) {
+        const int productId = query.value(0).toInt();
+        const int stock = query.value(1).toInt();
+        if (query.isNull(2)) {
+            newStock.insert(productId, stock);
+            ++result.inserted;
+            continue;
+        }
+        ++result.updated;
+        if (stock != query.value(2).toInt()) {
+            stockDelta.insert(productId, stock - query.value(2).toInt());
+        }
+    }
+
+    // 3. Связи с категориями добавляются к уже существующим; несуществующие категории отсекает JOIN
+    if (!query.exec("INSERT INTO Products_Categories (product_id, category_id) "
+                    "SELECT DISTINCT p.product_id, c.category_id "
+                    "FROM import_staging s "
+                    "JOIN Products p ON p.product_name = s.product_name "
+                    "CROSS JOIN LATERAL unnest(s.category_ids) AS l(category_id) "
+                    "JOIN Categories c ON c.category_id = l.category_id "
+                    "WHERE p.product_is_active "
+                    "ON CONFLICT (product_id, category_id) DO NOTHING")) {
+        qWarning() << "DatabaseHandler: Failed to link imported products. Error:" << query.lastError().text();
+        return fail("Database error while linking categories.");
+    }
+    result.linked = query.numRowsAffected();
+
+    if (!db.commit()) {
+        qWarning() << "DatabaseHandler: Failed to commit import:" << db.lastError().text();
+        return fail("Database error while committing.");
+    }
+
+    // Импорт может затронуть большую часть каталога, поэтому снимок перечитывается целиком
+    if (!m_catalog.load(db)) {
+        qWarning() << "DatabaseHandler: Catalog reload after import failed, snapshot is stale";
+    } else {
+        m_suggest.build(m_catalog.snapshot()->products);
+    }
+    for (auto it = newStock.cbegin(); it != newStock.cend(); ++it) {
+        m_productIds.insert(it.key());
+    }
+    m_stock.addProducts(newStock);
+    for (auto it = stockDelta.cbegin(); it != stockDelta.cend(); ++it) {
+        m_stock.adjust(it.key(), it.value());
+    }
+
+    progress.phase = "done";
+    report();
+    result.ok = true;
+    qInfo() << "DatabaseHandler: Imported" << progress.rowsCopied << "row(s):" << result.inserted << "inserted,"
+            << result.updated << "updated," << progress.rowsRejected << "rejected";
+    return result;
+}
+
+bool DatabaseHandler::exportProducts(const std::function<bool(const CatalogProduct&, const QList<int>&)> &onRow)
+{
+    PooledConnection connection = m_pool.acquire();
+    QSqlDatabase db = connection.database();
+    // Курсор без WITH HOLD живет только внутри транзакции
+    if (!db.isOpen() || !db.transaction()) {
+        qWarning() << "DatabaseHandler: Failed to start transaction for exportProducts:" << db.lastError().text();
+        return false;
+    }
+
+    // Результат остается на сервере БД: в памяти только очередная порция FETCH,
+    // поэтому выгрузка не зависит от размера каталога
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("DECLARE export_products NO SCROLL CURSOR FOR "
+                    "SELECT p.product_id, p.product_name, p.product_price, p.product_description, "
+                    "       p.product_image_path, p.product_stock, "
+                    "       ARRAY(SELECT pc.category_id FROM Products_Categories pc "
+                    "             WHERE pc.product_id = p.product_id ORDER BY pc.category_id) "
+                    "FROM Products p WHERE p.product_is_active ORDER BY p.product_id")) {
+        qWarning() << "DatabaseHandler: Failed to declare export cursor. Error:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    const QString fetch = QString("FETCH %1 FROM export_products").arg(kExportFetchSize);
+    qint64 exported = 0;
+    for (;;) {
+        if (!query.exec(fetch)) {
+            qWarning() << "DatabaseHandler: Failed to fetch export rows. Error:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+        int rows = 0;
+        while (query.next()) {
+            ++rows;
+            CatalogProduct product;
+            product.id = query.value(0).toInt();
+            product.name = query.value(1).toString();
+            product.price = query.value(2).toDouble();
+            product.description = query.value(3).toString();
+            product.imagePath = query.value(4).toString();
+            product.stock = query.value(5).toInt();
+            if (!onRow(product, parseIntArray(query.value(6).toString()))) {
+                // Клиент отключился или не забирает данные: откат закрывает курсор и освобождает снимок
+                qInfo() << "DatabaseHandler: Export stopped after" << exported << "product(s)";
+                db.rollback();
+                return false;
+            }
+            ++exported;
+        }
+        if (rows < kExportFetchSize) {
+            break;
+        }
+    }
+
+    // Транзакция только читала данные
+    db.rollback();
+    qDebug() << "DatabaseHandler: Exported" << exported << "product(s)";
+    return true;
 }
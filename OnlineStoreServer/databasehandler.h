@@ -8,6 +8,74 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QVariantMap>
+#include <QMutex>
+#include <QSet>
+#include <atomic>
+#include <functional>
+#include <optional>
+
+#include "databasepool.h"
+#include "catalogcache.h"
+#include "idbitmap.h"
+#include "stockledger.h"
+#include "productimportreader.h"
+#include "suggestindex.h"
+#include "searchcursor.h"
+
+// Результат операции, для которой клиенту важна причина отказа
+enum class DbStatus {
+    Ok,
+    NotFound, // строка, на которую ссылается запрос, не существует
+    Conflict, // строку изменила параллельная транзакция
+    SoldOut,  // товара нет в наличии
+    Invalid,  // данные запроса не прошли проверку
+    Error
+};
+
+// Результат добавления одного товара из пакета POST /products
+struct ProductInsertResult
+{
+    DbStatus status = DbStatus::Error;
+    int productId = -1;
+    QString error; // причина отказа для клиента
+};
+
+// Ход импорта каталога из файла (POST /imports)
+struct ImportProgress
+{
+    QString phase = "copy"; // copy -> merge -> done
+    qint64 rowsRead = 0;
+    qint64 rowsRejected = 0;
+    qint64 rowsCopied = 0;
+    qint64 bytesRead = 0;
+    double rowsPerSecond = 0;
+};
+
+// Запись файла импорта, не прошедшая проверку
+struct ImportReject
+{
+    qint64 record = 0; // номер записи в файле, с 1
+    QString reason;
+};
+
+struct ImportResult
+{
+    bool ok = false;
+    QString error;
+    ImportProgress progress;
+    qint64 inserted = 0;
+    qint64 updated = 0;
+    qint64 linked = 0;
+    QList<ImportReject> rejects; // первые kMaxImportRejects отказов
+};
+
+struct SearchResult
+{
+    bool ok = false;
+    QJsonArray items;                 // по убыванию релевантности, при равном ранге по product_id
+    std::optional<SearchCursor> next; // пусто, если страница последняя
+    bool timedOut = false;            // ранжирование не уложилось в statement_timeout
+};
 
 class DatabaseHandler : public QObject
 {
@@ -16,30 +84,104 @@ public:
     explicit DatabaseHandler(QObject *parent = nullptr);
     ~DatabaseHandler();
 
+    // Настройки пула применяются при connectToDatabase()
+    void setPoolSettings(const DatabasePool::Settings& settings);
     bool connectToDatabase(const QString& host, int port, const QString& dbName,
                            const QString& userName, const QString& password);
+    QJsonObject poolStats() const;
 
-    // Методы для всех ролей
+    // Методы для всех ролей (каталог читается из снимка в памяти)
     QJsonArray getCategories();
     QJsonArray getProductsByCategory(int categoryId);
+    // Хеш пароля читается из БД, а bcrypt считается в вызывающем потоке без соединения (см. PasswordVerifier)
     QJsonObject authenticateUser(const QString& login, const QString& password);
+    CatalogCache::SnapshotPtr catalogSnapshot() const;
+    // Полнотекстовый поиск по названию и описанию (fn_SearchProducts, русская морфология).
+    // Ранжируются все совпадения; слишком общий запрос прерывает kSearchStatementTimeoutMs,
+    // и результат помечается timedOut. after - курсор предыдущей страницы.
+    SearchResult searchProducts(const QString& text, const std::optional<SearchCursor>& after, int limit);
+    QJsonObject searchStats() const;
+    // Подсказки названий при наборе из индекса триграмм в памяти, без запроса к БД
+    QList<Suggestion> suggestProducts(const QString& text, int limit) const;
+    QJsonObject suggestStats() const;
+    static constexpr int kSearchStatementTimeoutMs = 2000;
+    // Статистика битовых карт существующих пользователей и товаров
+    QJsonObject idIndexStats() const;
+
+    // Остатки и резервы (см. StockLedger)
+    void setReservationTtlMs(qint64 ttlMs);
+    QJsonObject stockStats() const;
+    // Переносит остатки товаров, проданных после прошлого вызова, в снимок каталога
+    // одной публикацией; возвращает число товаров. Остаток в БД списывает сам заказ.
+    int publishStock();
+    int expireReservations();
+
+    // Физическое удаление помеченных товаров небольшой пачкой; возвращает число строк или -1
+    int purgeInactiveProducts(int batchSize);
+    QJsonObject purgeStats() const;
 
     // Методы для корзины
     QJsonObject getCartContents(int userId);
-    bool addToCart(int userId, int productId);
+    DbStatus addToCart(int userId, int productId);
     bool removeFromCart(int userId, int productId);
-    bool placeOrder(int userId);
+    DbStatus placeOrder(int userId);
 
     // Методы для администратора
     bool addCategory(const QString& categoryName);
-    bool deleteCategory(int categoryId);
-    bool addProduct(const QJsonObject& productData);
-    bool deleteProduct(int productId);
-    bool updateProductField(int productId, const QString& fieldName, const QVariant& value);
+    // Удаление категории выполняется фоновой задачей по пачкам: deleteCategoryBatch вызывается,
+    // пока не вернет 0 (число обработанных товаров, -1 при ошибке), затем deleteCategoryRow
+    int deleteCategoryBatch(int categoryId, int batchSize);
+    bool deleteCategoryRow(int categoryId);
+    // Пакет товаров добавляется двумя запросами (товары и связи с категориями) в одной транзакции;
+    // результат по каждому элементу в том же порядке
+    QList<ProductInsertResult> addProducts(const QJsonArray& productsData);
+    // NotFound - товара нет или он уже удален; Invalid - поле нельзя менять или значение неверно
+    DbStatus deleteProduct(int productId);
+    DbStatus updateProductField(int productId, const QString& fieldName, const QVariant& value);
     bool changeProductCategory(int productId, int oldCategoryId, int newCategoryId);
+    // Импорт каталога: записи потоком идут через COPY FROM STDIN во временную таблицу,
+    // затем одним запросом сливаются с Products (новые имена добавляются, существующие
+    // активные товары обновляются). onProgress вызывается периодически; false отменяет импорт.
+    ImportResult importProducts(ProductImportReader &reader,
+                                const std::function<bool(const ImportProgress&)> &onProgress);
+    static constexpr int kMaxImportRejects = 100;
+    // Выгрузка всех активных товаров через курсор на сервере БД порциями по kExportFetchSize строк.
+    // onRow вызывается для каждого товара по порядку product_id; false прерывает выгрузку.
+    // Возвращает false при ошибке БД или прерывании.
+    bool exportProducts(const std::function<bool(const CatalogProduct&, const QList<int>&)> &onRow);
+    static constexpr int kExportFetchSize = 1000;
 
 private:
-    QSqlDatabase m_db;
+    bool loadUserIds(QSqlDatabase& db);
+    // PREPARE search_products на соединении, если его там еще нет
+    bool prepareSearch(QSqlDatabase& db);
+    DbStatus updateProductStock(int productId, int stock);
+
+    bool m_driverAvailable = false;
+    DatabasePool::Settings m_poolSettings;
+    DatabasePool m_pool;
+    CatalogCache m_catalog;
+    // Названия активных товаров для подсказок; меняется вместе со снимком каталога
+    SuggestIndex m_suggest;
+    // Существующие user_id и product_id: addToCart отсекает неверные id без запросов к БД
+    IdBitmap m_userIds;
+    IdBitmap m_productIds;
+    // Резервы берутся в памяти, а остаток в БД меняется в транзакции заказа
+    StockLedger m_stock;
+    QMutex m_stockChangesMutex;
+    QSet<int> m_stockChanges; // товары, остаток которых в снимке каталога устарел
+    std::atomic<quint64> m_purgedProducts{0};
+    std::atomic<quint64> m_purgeBatches{0};
+    // Соединения пула, на которых уже выполнен PREPARE search_products
+    QMutex m_searchPreparedMutex;
+    QSet<QString> m_searchPrepared;
+    std::atomic<quint64> m_searches{0};
+    std::atomic<quint64> m_searchErrors{0};
+    std::atomic<quint64> m_searchTimeouts{0};
+    std::atomic<quint64> m_searchSlow{0}; // дольше kSearchSlowUs
+    std::atomic<qint64> m_searchTotalUs{0};
+    std::atomic<qint64> m_searchMaxUs{0};
+    static constexpr qint64 kSearchSlowUs = 20000;
 };
 
 #endif // DATABASEHANDLER_H
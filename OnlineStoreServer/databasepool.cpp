@@ -0,0 +1,379 @@
+#include "databasepool.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlDriver>
+#include <QThread>
+#include <QDebug>
+#include <utility>
+#include <libpq-fe.h>
+
+thread_local DatabasePool::ThreadState DatabasePool::t_state;
+
+PooledConnection::PooledConnection(PooledConnection &&other) noexcept
+    : m_pool(std::exchange(other.m_pool, nullptr))
+{
+}
+
+PooledConnection &PooledConnection::operator=(PooledConnection &&other) noexcept
+{
+    if (this != &other) {
+        if (m_pool) {
+            m_pool->release();
+        }
+        m_pool = std::exchange(other.m_pool, nullptr);
+    }
+    return *this;
+}
+
+PooledConnection::~PooledConnection()
+{
+    if (m_pool) {
+        m_pool->release();
+    }
+}
+
+QSqlDatabase PooledConnection::database() const
+{
+    return m_pool ? DatabasePool::t_state.entry.db : QSqlDatabase();
+}
+
+DatabasePool::~DatabasePool()
+{
+    QMutexLocker locker(&m_mutex);
+    for (Entry &entry : m_idle) {
+        entry.db.moveToThread(QThread::currentThread());
+        discard(entry);
+    }
+    m_idle.clear();
+}
+
+void DatabasePool::setSettings(const Settings &settings)
+{
+    QMutexLocker locker(&m_mutex);
+    m_settings = settings;
+    m_settings.minSize = qBound(0, m_settings.minSize, m_settings.maxSize);
+}
+
+bool DatabasePool::warmUp()
+{
+    const int minSize = qMax(1, m_settings.minSize);
+    QList<Entry> opened;
+    for (int i = 0; i < minSize; ++i) {
+        Entry entry = createEntry();
+        if (!entry.db.open()) {
+            qWarning() << "DatabasePool: Failed to open connection during warm-up:" << entry.db.lastError().text();
+            discard(entry);
+            break;
+        }
+        opened.append(entry);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    for (Entry &entry : opened) {
+        entry.idleSince.start();
+        entry.db.moveToThread(nullptr);
+        m_idle.append(entry);
+        ++m_total;
+    }
+    qDebug() << "DatabasePool: Warmed up" << opened.size() << "of" << minSize << "connections.";
+    return !opened.isEmpty();
+}
+
+PooledConnection DatabasePool::acquire(int statementTimeoutMs)
+{
+    if (t_state.pool == this) {
+        ++t_state.depth; // Вложенный вызов в том же потоке - то же соединение и та же транзакция
+        return PooledConnection(this);
+    }
+
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+    const QDeadlineTimer deadline(m_settings.acquireTimeoutMs);
+    if (statementTimeoutMs <= 0) {
+        statementTimeoutMs = m_settings.statementTimeoutMs;
+    }
+
+    forever {
+        Entry entry;
+        bool reused = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_idle.isEmpty() && m_total >= m_settings.maxSize) {
+                if (!m_available.wait(&m_mutex, deadline)) {
+                    ++m_acquireTimeouts;
+                    qWarning() << "DatabasePool: Timed out waiting for a free connection after"
+                               << waitTimer.elapsed() << "ms (in use:" << m_inUse << ")";
+                    return PooledConnection();
+                }
+            }
+            ++m_inUse;
+            if (!m_idle.isEmpty()) {
+                entry = m_idle.takeLast(); // LIFO: самое "теплое" соединение
+                reused = true;
+            } else {
+                ++m_total;
+            }
+        }
+
+        if (reused) {
+            // Свободное соединение не принадлежит ни одному потоку - забираем его в текущий
+            if (!entry.db.moveToThread(QThread::currentThread())) {
+                qWarning() << "DatabasePool: Failed to move connection" << entry.db.connectionName() << "to worker thread.";
+                discard(entry);
+                {
+                    QMutexLocker locker(&m_mutex);
+                    --m_total;
+                    --m_inUse;
+                }
+                refill();
+                continue;
+            }
+            // Лишние сверх minSize соединения, простаивавшие слишком долго, закрываем
+            if (entry.idleSince.elapsed() > m_settings.maxIdleMs) {
+                QMutexLocker locker(&m_mutex);
+                if (m_total > m_settings.minSize) {
+                    --m_total;
+                    --m_inUse;
+                    locker.unlock();
+                    discard(entry);
+                    continue;
+                }
+            }
+        } else {
+            entry = createEntry();
+        }
+
+        if (!prepareForCheckout(entry, statementTimeoutMs, deadline)) {
+            discard(entry);
+            {
+                QMutexLocker locker(&m_mutex);
+                --m_total;
+                --m_inUse;
+                m_available.wakeOne();
+            }
+            refill();
+            return PooledConnection();
+        }
+
+        // Ожидание учитывается один раз за выдачу, вместе с повторами после отброшенных соединений
+        recordWait(waitTimer.nsecsElapsed());
+        t_state.pool = this;
+        t_state.entry = entry;
+        t_state.depth = 1;
+        return PooledConnection(this);
+    }
+}
+
+bool DatabasePool::prepareForCheckout(Entry &entry, int statementTimeoutMs, const QDeadlineTimer &deadline)
+{
+    // Проверка простаивавшего соединения: после рестарта PostgreSQL или сбоя сети
+    // isOpen() остается true, и ошибку мы бы увидели только на запросе клиента
+    if (entry.db.isOpen() && entry.idleSince.isValid()
+        && entry.idleSince.elapsed() > m_settings.validateAfterIdleMs) {
+        QSqlQuery ping(entry.db);
+        if (!ping.exec("SELECT 1")) {
+            qWarning() << "DatabasePool: Idle validation failed for" << entry.db.connectionName()
+                       << ":" << ping.lastError().text();
+            QMutexLocker locker(&m_mutex);
+            ++m_validationFailures;
+            locker.unlock();
+            entry.db.close();
+            entry.statementTimeoutMs = -1;
+        }
+    }
+
+    if (!entry.db.isOpen()) {
+        if (!openWithBackoff(entry.db, deadline)) {
+            return false;
+        }
+        entry.statementTimeoutMs = -1;
+    }
+
+    if (entry.statementTimeoutMs != statementTimeoutMs) {
+        QSqlQuery setTimeout(entry.db);
+        if (!setTimeout.exec(QString("SET statement_timeout = %1").arg(statementTimeoutMs))) {
+            qWarning() << "DatabasePool: Failed to set statement_timeout:" << setTimeout.lastError().text();
+            return false;
+        }
+        entry.statementTimeoutMs = statementTimeoutMs;
+    }
+    return true;
+}
+
+bool DatabasePool::openWithBackoff(QSqlDatabase &db, const QDeadlineTimer &deadline)
+{
+    int backoffMs = 50;
+    forever {
+        if (db.open()) {
+            QMutexLocker locker(&m_mutex);
+            ++m_connectionOpens;
+            return true;
+        }
+        const qint64 remaining = deadline.remainingTime();
+        qWarning() << "DatabasePool: Failed to open connection" << db.connectionName() << ":" << db.lastError().text()
+                   << "- retrying in" << backoffMs << "ms";
+        if (remaining <= 0) {
+            return false;
+        }
+        QThread::msleep(qMin<qint64>(backoffMs, remaining));
+        backoffMs = qMin(backoffMs * 2, m_settings.reconnectBackoffMaxMs);
+    }
+}
+
+DatabasePool::Entry DatabasePool::createEntry()
+{
+    QString connectionName;
+    {
+        QMutexLocker locker(&m_mutex);
+        connectionName = QString("OnlineStore_%1").arg(m_connectionCounter++);
+    }
+
+    Entry entry;
+    entry.db = QSqlDatabase::addDatabase("QPSQL", connectionName);
+    entry.db.setHostName(m_settings.host);
+    entry.db.setPort(m_settings.port);
+    entry.db.setDatabaseName(m_settings.dbName);
+    entry.db.setUserName(m_settings.userName);
+    entry.db.setPassword(m_settings.password);
+    return entry;
+}
+
+void DatabasePool::discard(Entry &entry)
+{
+    const QString connectionName = entry.db.connectionName();
+    if (entry.db.isOpen()) {
+        entry.db.close();
+    }
+    entry.db = QSqlDatabase(); // removeDatabase требует, чтобы копий соединения не осталось
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+void DatabasePool::release()
+{
+    if (--t_state.depth > 0) {
+        return;
+    }
+
+    Entry entry = std::move(t_state.entry);
+    t_state.entry = Entry();
+    t_state.pool = nullptr;
+
+    // Соединение, потерявшее связь с сервером, не возвращаем: следующая выдача откроет новое
+    bool reusable = entry.db.isOpen() && resetTransaction(entry.db);
+    if (reusable) {
+        entry.idleSince.start();
+        reusable = entry.db.moveToThread(nullptr);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    --m_inUse;
+    if (reusable) {
+        m_idle.append(entry);
+        m_available.wakeOne();
+        return;
+    }
+    --m_total;
+    m_available.wakeOne();
+    locker.unlock();
+    discard(entry);
+    refill();
+}
+
+bool DatabasePool::resetTransaction(QSqlDatabase &db)
+{
+    // Состояние транзакции libpq знает локально, без запроса к серверу
+    const QVariant handle = db.driver()->handle();
+    if (!handle.isValid() || qstrcmp(handle.typeName(), "PGconn*") != 0) {
+        return true;
+    }
+    PGconn *pg = *static_cast<PGconn *const *>(handle.constData());
+    switch (PQtransactionStatus(pg)) {
+    case PQTRANS_IDLE:
+        return true;
+    case PQTRANS_INTRANS:
+    case PQTRANS_INERROR:
+        break;
+    default: // запрос еще выполняется или связь потеряна
+        qWarning() << "DatabasePool: Connection" << db.connectionName() << "released in a bad state, dropping it.";
+        return false;
+    }
+
+    qWarning() << "DatabasePool: Connection" << db.connectionName() << "released inside a transaction, rolling back.";
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_releaseRollbacks;
+    }
+    QSqlQuery rollback(db);
+    if (!rollback.exec("ROLLBACK")) {
+        qWarning() << "DatabasePool: Rollback on release failed:" << rollback.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+void DatabasePool::refill()
+{
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_total >= m_settings.minSize || m_refilling
+                || (m_lastRefill.isValid() && m_lastRefill.elapsed() < m_settings.reconnectBackoffMaxMs)) {
+                return;
+            }
+            m_refilling = true;
+            ++m_total; // место занято заранее, чтобы acquire() не открыл соединение сверх maxSize
+        }
+
+        Entry entry = createEntry();
+        const bool opened = entry.db.open();
+        if (opened) {
+            entry.idleSince.start();
+            entry.db.moveToThread(nullptr);
+        }
+
+        QMutexLocker locker(&m_mutex);
+        m_refilling = false;
+        if (!opened) {
+            qWarning() << "DatabasePool: Failed to refill connection:" << entry.db.lastError().text();
+            m_lastRefill.start();
+            --m_total;
+            m_available.wakeOne();
+            locker.unlock();
+            discard(entry);
+            return;
+        }
+        ++m_connectionOpens;
+        ++m_refills;
+        m_idle.append(entry);
+        m_available.wakeOne();
+    }
+}
+
+void DatabasePool::recordWait(qint64 waitNs)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_acquisitions;
+    m_totalWaitNs += waitNs;
+    m_maxWaitNs = qMax(m_maxWaitNs, waitNs);
+}
+
+QJsonObject DatabasePool::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject result;
+    result["min_size"] = m_settings.minSize;
+    result["max_size"] = m_settings.maxSize;
+    result["open_connections"] = m_total;
+    result["in_use"] = m_inUse;
+    result["idle"] = int(m_idle.size());
+    result["utilisation"] = m_settings.maxSize > 0 ? double(m_inUse) / m_settings.maxSize : 0.0;
+    result["acquisitions"] = qint64(m_acquisitions);
+    result["acquire_timeouts"] = qint64(m_acquireTimeouts);
+    result["connection_opens"] = qint64(m_connectionOpens);
+    result["validation_failures"] = qint64(m_validationFailures);
+    result["release_rollbacks"] = qint64(m_releaseRollbacks);
+    result["refills"] = qint64(m_refills);
+    result["avg_wait_ms"] = m_acquisitions ? double(m_totalWaitNs) / m_acquisitions / 1e6 : 0.0;
+    result["max_wait_ms"] = double(m_maxWaitNs) / 1e6;
+    return result;
+}
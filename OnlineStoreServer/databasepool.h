@@ -0,0 +1,127 @@
+#ifndef DATABASEPOOL_H
+#define DATABASEPOOL_H
+
+#include <QSqlDatabase>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
+#include <QJsonObject>
+#include <QList>
+
+class DatabasePool;
+
+// Соединение, выданное пулом. Возвращается в пул в деструкторе.
+// Копии QSqlDatabase, полученные через database(), должны быть уничтожены раньше этого объекта.
+class PooledConnection
+{
+public:
+    PooledConnection() = default;
+    PooledConnection(PooledConnection &&other) noexcept;
+    PooledConnection &operator=(PooledConnection &&other) noexcept;
+    PooledConnection(const PooledConnection &) = delete;
+    PooledConnection &operator=(const PooledConnection &) = delete;
+    ~PooledConnection();
+
+    bool isValid() const { return m_pool != nullptr; }
+    QSqlDatabase database() const;
+
+private:
+    friend class DatabasePool;
+    explicit PooledConnection(DatabasePool *pool) : m_pool(pool) {}
+
+    DatabasePool *m_pool = nullptr;
+};
+
+// Пул соединений PostgreSQL с ограниченным размером.
+// QSqlDatabase привязан к потоку: свободные соединения открепляются от потоков
+// (QSqlDatabase::moveToThread(nullptr)) и забираются потоком, который их получил.
+class DatabasePool
+{
+public:
+    struct Settings
+    {
+        QString host;
+        int port = 5432;
+        QString dbName;
+        QString userName;
+        QString password;
+
+        int minSize = 2;                  // соединений открывается при старте и не закрывается по простою
+        int maxSize = 16;                 // одновременно открытых соединений
+        int acquireTimeoutMs = 5000;      // сколько ждать свободного соединения
+        int validateAfterIdleMs = 5000;   // после такого простоя соединение проверяется SELECT 1
+        int maxIdleMs = 300000;           // сверх minSize соединения закрываются после такого простоя
+        int statementTimeoutMs = 15000;   // statement_timeout по умолчанию для выдачи
+        int reconnectBackoffMaxMs = 2000; // верхняя граница паузы между попытками переподключения
+    };
+
+    DatabasePool() = default;
+    ~DatabasePool();
+
+    void setSettings(const Settings &settings);
+    // Открывает minSize соединений; false, если не удалось открыть ни одного
+    bool warmUp();
+
+    // Выдает соединение с установленным statement_timeout (<= 0 - значение из настроек).
+    // Повторный вызов в том же потоке, пока соединение выдано, возвращает то же соединение,
+    // чтобы вложенные вызовы работали внутри одной транзакции.
+    PooledConnection acquire(int statementTimeoutMs = 0);
+
+    QJsonObject stats() const;
+
+private:
+    friend class PooledConnection;
+
+    struct Entry
+    {
+        QSqlDatabase db;
+        QElapsedTimer idleSince;
+        int statementTimeoutMs = -1;
+    };
+
+    bool openWithBackoff(QSqlDatabase &db, const QDeadlineTimer &deadline);
+    bool prepareForCheckout(Entry &entry, int statementTimeoutMs, const QDeadlineTimer &deadline);
+    Entry createEntry();
+    void discard(Entry &entry);
+    // Открытая транзакция (BEGIN без COMMIT, ошибка внутри транзакции) откатывается,
+    // чтобы следующий поток не продолжил чужую; false - соединение нельзя вернуть в пул
+    bool resetTransaction(QSqlDatabase &db);
+    // Открывает соединения до minSize после того, как часть из них отброшена;
+    // попытки не чаще раза в reconnectBackoffMaxMs
+    void refill();
+    void release();
+    void recordWait(qint64 waitNs);
+
+    // Соединение, выданное текущему потоку
+    struct ThreadState
+    {
+        DatabasePool *pool = nullptr;
+        Entry entry;
+        int depth = 0;
+    };
+    static thread_local ThreadState t_state;
+
+    Settings m_settings;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_available;
+    QList<Entry> m_idle;
+    int m_total = 0;
+    int m_inUse = 0;
+    int m_connectionCounter = 0;
+    bool m_refilling = false;
+    QElapsedTimer m_lastRefill;
+
+    // Метрики (под m_mutex)
+    quint64 m_acquisitions = 0;
+    quint64 m_acquireTimeouts = 0;
+    quint64 m_connectionOpens = 0;
+    quint64 m_validationFailures = 0;
+    quint64 m_releaseRollbacks = 0;
+    quint64 m_refills = 0;
+    qint64 m_totalWaitNs = 0;
+    qint64 m_maxWaitNs = 0;
+};
+
+#endif // DATABASEPOOL_H
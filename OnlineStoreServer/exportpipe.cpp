@@ -0,0 +1,93 @@
+#include "exportpipe.h"
+#include <QElapsedTimer>
+#include <QMetaObject>
+
+namespace {
+// Производитель просыпается с таким шагом, чтобы заметить отмену, даже если читатель молчит
+constexpr int kWaitSliceMs = 100;
+}
+
+ExportPipe::ExportPipe(qint64 capacityBytes, qint64 stallTimeoutMs)
+    : m_capacityBytes(capacityBytes),
+    m_stallTimeoutMs(stallTimeoutMs)
+{
+}
+
+bool ExportPipe::write(const QByteArray &data, const std::function<bool()> &cancelled)
+{
+    QMutexLocker locker(&m_mutex);
+    QElapsedTimer stalled;
+    stalled.start();
+    // Один блок принимается и в пустой буфер, даже если он больше capacityBytes
+    while (!m_readerClosed && m_bytes > 0 && m_bytes + data.size() > m_capacityBytes) {
+        if (cancelled() || stalled.hasExpired(m_stallTimeoutMs)) {
+            return false;
+        }
+        m_notFull.wait(&m_mutex, kWaitSliceMs);
+    }
+    if (m_readerClosed) {
+        return false;
+    }
+    m_chunks.enqueue(data);
+    m_bytes += data.size();
+    notifyReader();
+    return true;
+}
+
+void ExportPipe::finish(bool ok)
+{
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_ok = ok;
+    notifyReader();
+}
+
+void ExportPipe::setReader(QObject *reader, const char *slot)
+{
+    QMutexLocker locker(&m_mutex);
+    m_reader = reader;
+    m_slot = slot;
+    // Данные могли прийти раньше, чем появился читатель
+    if (m_bytes > 0 || m_finished) {
+        notifyReader();
+    }
+}
+
+QByteArray ExportPipe::take(qint64 maxBytes, bool *finished)
+{
+    QMutexLocker locker(&m_mutex);
+    QByteArray data;
+    while (!m_chunks.isEmpty() && (data.isEmpty() || data.size() + m_chunks.head().size() <= maxBytes)) {
+        const QByteArray chunk = m_chunks.dequeue();
+        m_bytes -= chunk.size();
+        data += chunk;
+    }
+    *finished = m_finished && m_chunks.isEmpty();
+    m_notFull.wakeAll();
+    return data;
+}
+
+bool ExportPipe::isOk() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_ok;
+}
+
+void ExportPipe::closeReader()
+{
+    QMutexLocker locker(&m_mutex);
+    m_readerClosed = true;
+    m_reader = nullptr;
+    m_chunks.clear();
+    m_bytes = 0;
+    m_notFull.wakeAll();
+}
+
+void ExportPipe::notifyReader()
+{
+    // Вызывается под m_mutex: читатель не может быть уничтожен, пока событие ставится в очередь.
+    // Событие для уже удаленного объекта Qt просто отбрасывает.
+    if (m_reader) {
+        QMetaObject::invokeMethod(m_reader, m_slot, Qt::QueuedConnection);
+    }
+}
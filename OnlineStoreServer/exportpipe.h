@@ -0,0 +1,51 @@
+#ifndef EXPORTPIPE_H
+#define EXPORTPIPE_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QObject>
+#include <functional>
+
+// Ограниченный буфер между потоком, который читает выгрузку из курсора БД, и потоком
+// реактора, который отправляет ее клиенту. Если буфер полон, производитель ждет,
+// поэтому в памяти не больше capacityBytes данных одной выгрузки, каким бы ни был каталог.
+class ExportPipe
+{
+public:
+    explicit ExportPipe(qint64 capacityBytes, qint64 stallTimeoutMs);
+
+    // Поток-производитель. Ждет места в буфере; false - читатель закрыт, cancelled() вернул true
+    // или читатель ничего не забирал дольше stallTimeoutMs
+    bool write(const QByteArray &data, const std::function<bool()> &cancelled);
+    // Данных больше не будет; ok = false - выгрузка оборвалась с ошибкой
+    void finish(bool ok);
+
+    // Поток реактора. Объект получает вызов slot (через очередь событий) при новых данных и в конце
+    void setReader(QObject *reader, const char *slot);
+    // Забирает накопленные блоки, пока их сумма не превысит maxBytes (хотя бы один блок);
+    // *finished = true, если после них данных не будет
+    QByteArray take(qint64 maxBytes, bool *finished);
+    bool isOk() const;
+    // Читатель больше не нужен (ответ завершен или уничтожен): производитель останавливается.
+    // Читатель обязан вызвать это до своего уничтожения
+    void closeReader();
+
+private:
+    void notifyReader();
+
+    const qint64 m_capacityBytes;
+    const qint64 m_stallTimeoutMs;
+    mutable QMutex m_mutex;
+    QWaitCondition m_notFull;
+    QQueue<QByteArray> m_chunks;
+    qint64 m_bytes = 0;
+    bool m_finished = false;
+    bool m_ok = true;
+    bool m_readerClosed = false;
+    QObject *m_reader = nullptr; // сбрасывается в closeReader() до уничтожения читателя
+    const char *m_slot = nullptr;
+};
+
+#endif // EXPORTPIPE_H
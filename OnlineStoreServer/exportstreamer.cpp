@@ -0,0 +1,69 @@
+#include "exportstreamer.h"
+#include <QDebug>
+
+ExportStreamer::ExportStreamer(QHttpServerResponder &&responder, std::shared_ptr<ExportPipe> pipe,
+                               QTcpSocket *socket, qint64 maxSocketBacklog, QObject *parent)
+    : QObject(parent),
+    m_responder(std::move(responder)),
+    m_pipe(std::move(pipe)),
+    m_socket(socket),
+    m_maxSocketBacklog(maxSocketBacklog)
+{
+    // Клиент забрал часть данных - можно взять из ExportPipe следующие
+    connect(socket, &QTcpSocket::bytesWritten, this, &ExportStreamer::drain);
+    connect(socket, &QTcpSocket::disconnected, this, &ExportStreamer::abort);
+    connect(socket, &QObject::destroyed, this, &ExportStreamer::abort);
+}
+
+ExportStreamer::~ExportStreamer()
+{
+    // Если ответ не дописан (клиент отключился, поток реактора останавливается),
+    // производитель больше не ждет места и закрывает курсор
+    m_pipe->closeReader();
+}
+
+void ExportStreamer::start(QHttpHeaders headers)
+{
+    headers.replaceOrAppend("Trailer", "Export-Status");
+    m_responder.writeBeginChunked(headers, QHttpServerResponder::StatusCode::Ok);
+    m_pipe->setReader(this, "drain");
+}
+
+void ExportStreamer::drain()
+{
+    while (!m_done && m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
+        const qint64 room = m_maxSocketBacklog - m_socket->bytesToWrite();
+        if (room <= 0) {
+            // Продолжим по bytesWritten
+            return;
+        }
+        bool finished = false;
+        const QByteArray data = m_pipe->take(room, &finished);
+        if (!data.isEmpty()) {
+            m_responder.writeChunk(data);
+        }
+        if (finished) {
+            m_done = true;
+            QHttpHeaders trailers;
+            trailers.append("Export-Status", m_pipe->isOk() ? "complete" : "failed");
+            m_responder.writeEndChunked(QByteArrayView(), trailers);
+            deleteLater();
+            return;
+        }
+        if (data.isEmpty()) {
+            // Продолжим, когда ExportPipe сообщит о новых данных
+            return;
+        }
+    }
+}
+
+void ExportStreamer::abort()
+{
+    if (m_done) {
+        return;
+    }
+    m_done = true;
+    qInfo() << "ExportStreamer: Client disconnected, aborting export";
+    m_pipe->closeReader();
+    deleteLater();
+}
@@ -0,0 +1,42 @@
+#ifndef EXPORTSTREAMER_H
+#define EXPORTSTREAMER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTcpSocket>
+#include <QHttpServerResponder>
+#include <QHttpHeaders>
+#include <memory>
+
+#include "exportpipe.h"
+
+// Отправляет клиенту данные из ExportPipe ответом с Transfer-Encoding: chunked.
+// Живет в потоке реактора, которому принадлежит соединение, и удаляет себя после последнего блока.
+// Итог выгрузки передается в трейлере Export-Status: complete | failed, потому что
+// статус 200 уже отправлен до того, как прочитана первая строка.
+// Новые данные забираются из ExportPipe, только пока в сокете ждут отправки меньше
+// maxSocketBacklog байт, поэтому медленный клиент останавливает чтение курсора через
+// заполненный ExportPipe. При разрыве соединения выгрузка прерывается.
+class ExportStreamer : public QObject
+{
+    Q_OBJECT
+public:
+    ExportStreamer(QHttpServerResponder &&responder, std::shared_ptr<ExportPipe> pipe,
+                   QTcpSocket *socket, qint64 maxSocketBacklog, QObject *parent = nullptr);
+    ~ExportStreamer() override;
+
+    void start(QHttpHeaders headers);
+
+private slots:
+    void drain();
+    void abort();
+
+private:
+    QHttpServerResponder m_responder;
+    std::shared_ptr<ExportPipe> m_pipe;
+    QPointer<QTcpSocket> m_socket;
+    const qint64 m_maxSocketBacklog;
+    bool m_done = false;
+};
+
+#endif // EXPORTSTREAMER_H
@@ -0,0 +1,171 @@
+#include "httpreactor.h"
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#endif
+
+namespace {
+thread_local HttpReactor *currentReactor = nullptr;
+
+// QTcpServer, который сообщает о каждом принятом сокете до того, как его заберет QHttpServer
+class ReactorTcpServer : public QTcpServer
+{
+public:
+    using Accepted = std::function<void(QTcpSocket *)>;
+
+    ReactorTcpServer(Accepted accepted, QObject *parent)
+        : QTcpServer(parent),
+        m_accepted(std::move(accepted))
+    {
+    }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        // То же, что делает QTcpServer по умолчанию, плюс регистрация сокета
+        auto *socket = new QTcpSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+        m_accepted(socket);
+        addPendingConnection(socket);
+    }
+
+private:
+    Accepted m_accepted;
+};
+}
+
+HttpReactor::HttpReactor(int index, QObject *parent)
+    : QObject(parent),
+    m_index(index)
+{
+}
+
+bool HttpReactor::start(quint16 port, bool reusePort, const RouteSetup &setupRoutes)
+{
+    currentReactor = this;
+
+    m_tcpServer = new ReactorTcpServer([this](QTcpSocket *socket) { registerConnection(socket); }, this);
+    m_httpServer = new QHttpServer(this);
+    setupRoutes(*m_httpServer);
+
+    // Сигнал приходит на каждое принятое соединение, до того как его заберет QHttpServer
+    connect(m_tcpServer, &QTcpServer::pendingConnectionAvailable, this, [this]() {
+        m_acceptedConnections.fetchAndAddRelaxed(1);
+    });
+
+    bool listening = reusePort ? listenReusePort(port) : m_tcpServer->listen(QHostAddress::Any, port);
+    if (!listening) {
+        qWarning() << "HttpReactor" << m_index << ": QTcpServer failed to listen on port" << port
+                   << ". Error:" << m_tcpServer->errorString();
+        return false;
+    }
+    if (!m_httpServer->bind(m_tcpServer)) {
+        qWarning() << "HttpReactor" << m_index << ": Failed to bind QHttpServer to QTcpServer instance.";
+        m_tcpServer->close();
+        return false;
+    }
+    qDebug() << "HttpReactor" << m_index << ": listening on port" << m_tcpServer->serverPort();
+    return true;
+}
+
+bool HttpReactor::listenReusePort(quint16 port)
+{
+#ifdef Q_OS_LINUX
+    // QTcpServer не умеет выставлять SO_REUSEPORT, поэтому сокет создается вручную
+    // (двойной стек IPv6/IPv4, как у QHostAddress::Any) и передается через setSocketDescriptor
+    int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        qWarning() << "HttpReactor" << m_index << ": socket() failed, errno" << errno;
+        return false;
+    }
+
+    const int on = 1;
+    const int off = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        qWarning() << "HttpReactor" << m_index << ": SO_REUSEPORT is not supported, errno" << errno;
+        ::close(fd);
+        return false;
+    }
+
+    sockaddr_in6 address = {};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0
+        || ::listen(fd, SOMAXCONN) < 0) {
+        qWarning() << "HttpReactor" << m_index << ": bind/listen failed on port" << port << ", errno" << errno;
+        ::close(fd);
+        return false;
+    }
+
+    if (!m_tcpServer->setSocketDescriptor(fd)) {
+        ::close(fd);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(port);
+    qWarning() << "HttpReactor: SO_REUSEPORT listeners are only supported on Linux.";
+    return false;
+#endif
+}
+
+quint16 HttpReactor::serverPort() const
+{
+    return m_tcpServer ? m_tcpServer->serverPort() : 0;
+}
+
+QJsonObject HttpReactor::stats() const
+{
+    QJsonObject result;
+    result["reactor"] = m_index;
+    result["accepted_connections"] = qint64(m_acceptedConnections.loadRelaxed());
+    result["requests"] = qint64(m_requests.loadRelaxed());
+    return result;
+}
+
+void HttpReactor::countRequestInCurrent()
+{
+    if (currentReactor) {
+        currentReactor->m_requests.fetchAndAddRelaxed(1);
+    }
+}
+
+HttpReactor::PeerKey HttpReactor::peerKey(const QHostAddress &address, quint16 port)
+{
+    // Слушающий сокет двойного стека отдает IPv4-клиентов как ::ffff:a.b.c.d
+    bool isIPv4 = false;
+    const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    return {isIPv4 ? QHostAddress(ipv4) : address, port};
+}
+
+void HttpReactor::registerConnection(QTcpSocket *socket)
+{
+    const PeerKey key = peerKey(socket->peerAddress(), socket->peerPort());
+    m_connections.insert(key, socket);
+    // Сокет удаляется после закрытия соединения; запись под тем же ключом уже может
+    // принадлежать новому соединению, поэтому удаляется только своя
+    connect(socket, &QObject::destroyed, this, [this, key](QObject *destroyed) {
+        const auto it = m_connections.constFind(key);
+        if (it != m_connections.constEnd() && it.value() == destroyed) {
+            m_connections.erase(it);
+        }
+    });
+}
+
+QTcpSocket *HttpReactor::connectionInCurrent(const QHostAddress &peerAddress, quint16 peerPort)
+{
+    if (!currentReactor) {
+        return nullptr;
+    }
+    return currentReactor->m_connections.value(peerKey(peerAddress, peerPort));
+}
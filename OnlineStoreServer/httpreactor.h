@@ -0,0 +1,56 @@
+#ifndef HTTPREACTOR_H
+#define HTTPREACTOR_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QHttpServer>
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QHash>
+#include <functional>
+#include <utility>
+
+// Один "реактор" сервера: свой QTcpServer + QHttpServer в своем потоке.
+// В многопоточном режиме все реакторы слушают один порт через SO_REUSEPORT,
+// а ядро распределяет между ними входящие соединения.
+class HttpReactor : public QObject
+{
+    Q_OBJECT
+public:
+    using RouteSetup = std::function<void(QHttpServer &)>;
+
+    explicit HttpReactor(int index, QObject *parent = nullptr);
+
+    // Вызывается в потоке реактора: создает серверы, регистрирует маршруты и начинает слушать порт
+    bool start(quint16 port, bool reusePort, const RouteSetup &setupRoutes);
+
+    int index() const { return m_index; }
+    quint16 serverPort() const;
+    QJsonObject stats() const;
+
+    // Учитывает запрос в реакторе, в потоке которого выполняется вызов
+    static void countRequestInCurrent();
+    // Сокет соединения реактора текущего потока по адресу и порту клиента (из QHttpServerRequest).
+    // QHttpServerResponder не дает доступа к сокету, а ответам, которые пишутся частями,
+    // нужно знать, сколько данных еще не ушло клиенту, и когда соединение закрыто.
+    // Поиск по таблице открытых соединений, которую реактор ведет при их приеме.
+    static QTcpSocket *connectionInCurrent(const QHostAddress &peerAddress, quint16 peerPort);
+
+private:
+    // Адрес клиента без IPv4-mapped формы и порт: ключ таблицы соединений
+    using PeerKey = std::pair<QHostAddress, quint16>;
+    static PeerKey peerKey(const QHostAddress &address, quint16 port);
+
+    bool listenReusePort(quint16 port);
+    void registerConnection(QTcpSocket *socket);
+
+    int m_index;
+    QTcpServer *m_tcpServer = nullptr;
+    QHttpServer *m_httpServer = nullptr;
+    QHash<PeerKey, QTcpSocket *> m_connections; // только в потоке реактора
+    QAtomicInteger<quint64> m_acceptedConnections;
+    QAtomicInteger<quint64> m_requests;
+};
+
+#endif // HTTPREACTOR_H
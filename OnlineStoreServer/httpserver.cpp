@@ -4,83 +4,529 @@
 #include <QJsonArray>
 #include <QUrlQuery> // Для request.query()
 #include <QDebug>
+#include <QThread>
+#include <QFileInfo>
+#include <QDateTime>
+
+namespace {
+
+// Файлы больше этого размера не читаются в память, а отдаются потоком
+constexpr qint64 kStreamingThresholdBytes = 1024 * 1024;
+// Сколько изображений без ссылок удаляется за один проход сборщика
+constexpr int kImageSweepBatchSize = 50;
+// Не больше одной пачки за срабатывание таймера: очистка не создает всплесков записи в БД
+constexpr int kProductPurgeBatchSize = 100;
+// Удаление категории: каждая пачка - короткая транзакция, между пачками пауза для других запросов
+constexpr int kCategoryDeleteBatchSize = 500;
+constexpr int kCategoryDeleteBatchPauseMs = 10;
+constexpr qint64 kFinishedJobRetentionMs = 60 * 60 * 1000;
+// Пакет POST /products вставляется одной транзакцией; больше - отдельными запросами
+constexpr int kMaxProductsPerRequest = 1000;
+// Страница GET /products по умолчанию и наибольшая
+constexpr int kDefaultProductPageSize = 50;
+constexpr int kMaxProductPageSize = 200;
+// Категорий в одном запросе /products/filter
+constexpr int kMaxFilterCategories = 32;
+// Поиск: размер страницы и длина запроса
+constexpr int kDefaultSearchPageSize = 20;
+constexpr int kMaxSearchPageSize = 100;
+constexpr int kMaxSearchQueryLength = 200;
+// Подсказки при наборе
+constexpr int kDefaultSuggestCount = 10;
+constexpr int kMaxSuggestCount = 50;
+// Выгрузка каталога: блоки по kExportChunkBytes, в буфере между потоками не больше kExportPipeBytes
+constexpr int kMaxConcurrentExports = 2;
+constexpr int kExportChunkBytes = 64 * 1024;
+constexpr qint64 kExportPipeBytes = 1024 * 1024;
+constexpr qint64 kExportStallTimeoutMs = 60 * 1000;
+// Сколько байт выгрузки может ждать отправки в сокете; остальное держит ExportPipe
+constexpr qint64 kExportSocketBacklogBytes = 256 * 1024;
+// Сколько входов может ждать в очереди на одну одновременную проверку пароля
+constexpr int kLoginQueuePerCall = 16;
+
+struct ByteRange
+{
+    qint64 start = 0;
+    qint64 length = 0;
+};
+
+enum class RangeResult { Full, Partial, Unsatisfiable };
+
+// Разбирает единственный диапазон "bytes=a-b", "bytes=a-" или "bytes=-n" (RFC 9110, 14.2).
+// Несколько диапазонов и нераспознанные единицы игнорируются: отдается весь файл.
+RangeResult parseRange(const QHttpHeaders &headers, const QByteArray &etag, qint64 size, ByteRange *range)
+{
+    const QByteArray value = headers.value(QHttpHeaders::WellKnownHeader::Range).toByteArray().trimmed();
+    if (!value.startsWith("bytes=") || value.contains(',')) {
+        return RangeResult::Full;
+    }
+
+    // If-Range с другим ETag означает, что у клиента старая копия: нужен весь файл
+    const QByteArray ifRange = headers.value(QHttpHeaders::WellKnownHeader::IfRange).toByteArray().trimmed();
+    if (!ifRange.isEmpty() && ifRange != etag) {
+        return RangeResult::Full;
+    }
+
+    const QByteArray spec = value.mid(6).trimmed();
+    const qsizetype dash = spec.indexOf('-');
+    if (dash < 0) {
+        return RangeResult::Full;
+    }
+    const QByteArray first = spec.left(dash).trimmed();
+    const QByteArray last = spec.mid(dash + 1).trimmed();
+
+    bool ok = false;
+    if (first.isEmpty()) {
+        // Суффикс: последние n байт
+        const qint64 suffix = last.toLongLong(&ok);
+        if (!ok || suffix < 0) {
+            return RangeResult::Full;
+        }
+        if (suffix == 0 || size == 0) {
+            return RangeResult::Unsatisfiable;
+        }
+        range->length = qMin(suffix, size);
+        range->start = size - range->length;
+        return RangeResult::Partial;
+    }
+
+    const qint64 start = first.toLongLong(&ok);
+    if (!ok || start < 0) {
+        return RangeResult::Full;
+    }
+    qint64 end = size - 1;
+    if (!last.isEmpty()) {
+        end = last.toLongLong(&ok);
+        if (!ok || end < start) {
+            return RangeResult::Full;
+        }
+        end = qMin(end, size - 1);
+    }
+    if (start >= size) {
+        return RangeResult::Unsatisfiable;
+    }
+    range->start = start;
+    range->length = end - start + 1;
+    return RangeResult::Partial;
+}
+
+// Формат изображения по первым байтам файла; пустая строка - не изображение
+QString detectImageExtension(const QByteArray &header)
+{
+    if (header.startsWith("\xFF\xD8\xFF")) {
+        return "jpg";
+    }
+    if (header.startsWith("\x89PNG\r\n\x1A\n")) {
+        return "png";
+    }
+    if (header.startsWith("GIF87a") || header.startsWith("GIF89a")) {
+        return "gif";
+    }
+    if (header.size() >= 12 && header.startsWith("RIFF") && header.mid(8, 4) == "WEBP") {
+        return "webp";
+    }
+    return QString();
+}
+
+QByteArray contentRange(const ByteRange &range, qint64 size)
+{
+    return "bytes " + QByteArray::number(range.start) + '-'
+           + QByteArray::number(range.start + range.length - 1) + '/' + QByteArray::number(size);
+}
+
+// Поле CSV в кавычках, если в нем есть разделитель, кавычка или перевод строки (RFC 4180)
+QByteArray csvField(const QString &value)
+{
+    QByteArray field = value.toUtf8();
+    if (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r')) {
+        field.replace("\"", "\"\"");
+        field = '"' + field + '"';
+    }
+    return field;
+}
+
+// Формат выгрузки совпадает с форматом импорта: выгруженный файл можно загрузить обратно
+QByteArray exportRow(const CatalogProduct &product, const QList<int> &categoryIds, ProductImportReader::Format format)
+{
+    if (format == ProductImportReader::Format::Ndjson) {
+        QJsonArray categories;
+        for (int categoryId : categoryIds) {
+            categories.append(categoryId);
+        }
+        QJsonObject object;
+        object["product_id"] = product.id;
+        object["product_name"] = product.name;
+        object["product_price"] = product.price;
+        object["product_description"] = product.description;
+        object["product_image_path"] = product.imagePath;
+        object["product_stock"] = product.stock;
+        object["category_ids"] = categories;
+        return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+    }
+
+    QStringList categories;
+    for (int categoryId : categoryIds) {
+        categories.append(QString::number(categoryId));
+    }
+    QByteArray row = QByteArray::number(product.id);
+    row += ',' + csvField(product.name);
+    row += ',' + QByteArray::number(product.price, 'f', 2);
+    row += ',' + csvField(product.description);
+    row += ',' + csvField(product.imagePath);
+    row += ',' + QByteArray::number(product.stock);
+    row += ',' + categories.join(';').toUtf8();
+    return row + "\r\n";
+}
+
+// Поля статуса задачи импорта для GET /jobs/<id>
+QJsonObject importDetails(const ImportProgress &progress, qint64 fileBytes)
+{
+    QJsonObject details;
+    details["phase"] = progress.phase;
+    details["rows_read"] = progress.rowsRead;
+    details["rows_rejected"] = progress.rowsRejected;
+    details["rows_copied"] = progress.rowsCopied;
+    details["bytes_read"] = progress.bytesRead;
+    details["file_bytes"] = fileBytes;
+    details["rows_per_second"] = qRound64(progress.rowsPerSecond);
+    return details;
+}
+
+} // namespace
 
 HttpServer::HttpServer(DatabaseHandler* dbHandler, QObject *parent)
     : QObject(parent),
-    m_httpServer(this),
-    m_tcpServer(this),
     m_dbHandler(dbHandler)
 {
     if (!m_dbHandler) {
         qFatal("HttpServer: DatabaseHandler instance is required!");
     }
-    setupRoutes();
+    // Обработчики в основном ждут PostgreSQL, поэтому потоков больше, чем ядер.
+    // Потоки не завершаются по таймауту, чтобы сохранять свои соединения с БД.
+    m_workerPool.setMaxThreadCount(QThread::idealThreadCount() * 2);
+    m_workerPool.setExpiryTimeout(-1);
+
+    // bcrypt при входе считается в процессе сервера и занимает ядро целиком, поэтому пул входов
+    // по числу ядер. Соединение БД нужно только на чтение хеша, и каталог с корзиной его не ждут.
+    m_loginPool.setMaxThreadCount(QThread::idealThreadCount());
+    m_jobPool.setMaxThreadCount(2);
+    m_exportPool.setMaxThreadCount(kMaxConcurrentExports);
+
+    // Брошенные незавершенные загрузки и истекшие сессии удаляются раз в минуту
+    m_housekeepingTimer.setInterval(60 * 1000);
+    connect(&m_housekeepingTimer, &QTimer::timeout, this, [this]() {
+        const int removed = m_uploadStore.removeExpired() + m_importUploads.removeExpired();
+        if (removed > 0) {
+            qInfo() << "HttpServer: Removed" << removed << "expired upload(s)";
+        }
+        m_sessions.removeExpired();
+        m_dbHandler->expireReservations();
+        m_jobs.removeFinished(kFinishedJobRetentionMs);
+    });
+    m_housekeepingTimer.start();
+
+    // Остатки после заказов попадают в снимок каталога пачкой раз в секунду,
+    // а не новой копией каталога на каждого покупателя
+    m_stockPublishTimer.setInterval(1000);
+    connect(&m_stockPublishTimer, &QTimer::timeout, this, &HttpServer::publishStock);
+    m_stockPublishTimer.start();
+
+    m_productPurgeTimer.setInterval(10 * 1000);
+    connect(&m_productPurgeTimer, &QTimer::timeout, this, &HttpServer::purgeInactiveProducts);
+    m_productPurgeTimer.start();
+
+    // Изображения без ссылок удаляются небольшими пачками, чтобы не нагружать диск
+    m_imageSweepTimer.setInterval(60 * 1000);
+    connect(&m_imageSweepTimer, &QTimer::timeout, this, &HttpServer::sweepOrphanImages);
+    m_imageSweepTimer.start();
 }
 
 HttpServer::~HttpServer()
 {
-    if (m_tcpServer.isListening()) {
-        m_tcpServer.close();
+    stopReactors();
+    m_stopping = true;
+    m_workerPool.waitForDone();
+    m_loginPool.waitForDone();
+    m_jobPool.waitForDone();
+    m_exportPool.waitForDone();
+    m_imageSweep.waitForFinished();
+    m_stockPublish.waitForFinished();
+    m_productPurge.waitForFinished();
+}
+
+void HttpServer::publishStock()
+{
+    if (m_stockPublish.isRunning()) {
+        return;
     }
+    m_stockPublish = QtConcurrent::run(QThreadPool::globalInstance(), [this]() {
+        m_dbHandler->publishStock();
+    });
 }
 
-bool HttpServer::startServer(quint16 port)
+void HttpServer::sweepOrphanImages()
 {
-    if (!m_tcpServer.listen(QHostAddress::Any, port)) { // Сначала запуск tcpServer, после bind
-        qWarning() << "HttpServer: QTcpServer failed to listen on port" << port
-                   << ". Error:" << m_tcpServer.errorString();
-        return false;
+    // Обход директории идет в отдельном потоке, чтобы не задерживать цикл событий
+    if (m_imageSweep.isRunning()) {
+        return;
     }
-    qDebug() << "HttpServer: QTcpServer is now listening on port" << m_tcpServer.serverPort();
-    if (!m_httpServer.bind(&m_tcpServer)) {
-        qWarning() << "HttpServer: Failed to bind QHttpServer to QTcpServer instance (even though QTcpServer was listening).";
-        m_tcpServer.close();
-        return false;
+    m_imageSweep = QtConcurrent::run(QThreadPool::globalInstance(), [this]() {
+        const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+        // Пока каталог не загружен, неизвестно, какие файлы нужны: ничего не удаляем
+        if (catalog->loaded) {
+            const QStringList deleted = m_imageStore.sweep(catalog->imageReferences, kImageSweepBatchSize);
+            for (const QString &fileName : deleted) {
+                m_imageVariants.remove(fileName);
+            }
+            if (!deleted.isEmpty()) {
+                qInfo() << "HttpServer: Removed" << deleted.size() << "unreferenced image(s)";
+            }
+        }
+    });
+}
+
+void HttpServer::purgeInactiveProducts()
+{
+    if (m_productPurge.isRunning()) {
+        return;
+    }
+    // Под нагрузкой очистка откладывается: запросы покупателей важнее освобождения места
+    if (m_workerPool.activeThreadCount() > m_workerPool.maxThreadCount() / 4) {
+        ++m_productPurgeDeferred;
+        return;
+    }
+    m_productPurge = QtConcurrent::run(QThreadPool::globalInstance(), [this]() {
+        m_dbHandler->purgeInactiveProducts(kProductPurgeBatchSize);
+    });
+}
+
+void HttpServer::setWorkerThreadCount(int count)
+{
+    if (count > 0) {
+        m_workerPool.setMaxThreadCount(count);
+    }
+}
+
+void HttpServer::setImageCacheBytes(qint64 bytes)
+{
+    m_imageCache.setMaxBytes(bytes);
+}
+
+void HttpServer::setMaxUploadBytes(qint64 bytes)
+{
+    m_uploadStore.setMaxBytes(bytes);
+}
+
+void HttpServer::setMaxImportBytes(qint64 bytes)
+{
+    m_importUploads.setMaxBytes(bytes);
+}
+
+void HttpServer::setLoginConcurrency(int count)
+{
+    m_loginPool.setMaxThreadCount(qMax(1, count));
+}
+
+void HttpServer::setSessionIdleTimeoutMs(qint64 timeoutMs)
+{
+    m_sessions.setIdleTimeoutMs(timeoutMs);
+}
+
+void HttpServer::setAccessTokenTtlSeconds(qint64 ttlSeconds)
+{
+    m_tokens.setTtlSeconds(ttlSeconds);
+}
+
+QFuture<QHttpServerResponse> HttpServer::submitLogin(const QHttpServerRequest &request)
+{
+    HttpReactor::countRequestInCurrent();
+    // Ожидающих входов не больше, чем проверок * kLoginQueuePerCall: лишние сразу получают 503,
+    // а не копятся в очереди, пока клиент уже не ждет ответа
+    const int maxQueue = m_loginPool.maxThreadCount() * kLoginQueuePerCall;
+    if (m_loginQueueDepth.fetch_add(1) >= maxQueue) {
+        --m_loginQueueDepth;
+        ++m_loginRejected;
+        QHttpServerResponse response("Service Unavailable: Too many login attempts, retry later.",
+                                     QHttpServerResponse::StatusCode::ServiceUnavailable);
+        QHttpHeaders headers = response.headers();
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::RetryAfter, "1");
+        response.setHeaders(std::move(headers));
+        return QtFuture::makeReadyValueFuture(std::move(response));
+    }
+    return QtConcurrent::run(&m_loginPool, [this, data = RequestData(request)] {
+        --m_loginQueueDepth;
+        return handleLogin(data);
+    });
+}
+
+bool HttpServer::startServer(quint16 port, int reactorCount)
+{
+    auto routeSetup = [this](QHttpServer &httpServer) { setupRoutes(httpServer); };
+
+    if (reactorCount <= 1) {
+        // Один реактор в потоке приложения, обычный listen()
+        HttpReactor *reactor = new HttpReactor(0, this);
+        m_reactors.append(reactor);
+        return reactor->start(port, false, routeSetup);
     }
 
-    qDebug() << "HttpServer: Successfully bound QHttpServer to QTcpServer. Server is running on port" << m_tcpServer.serverPort();
+    for (int i = 0; i < reactorCount; ++i) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("HttpReactor-%1").arg(i));
+        HttpReactor *reactor = new HttpReactor(i);
+        reactor->moveToThread(thread);
+        connect(thread, &QThread::finished, reactor, &QObject::deleteLater);
+        m_reactorThreads.append(thread);
+        m_reactors.append(reactor);
+        thread->start();
+
+        // QTcpServer и QHttpServer должны создаваться в потоке, который будет их обслуживать
+        bool started = false;
+        QMetaObject::invokeMethod(reactor, [&]() {
+            started = reactor->start(port, true, routeSetup);
+        }, Qt::BlockingQueuedConnection);
+
+        if (!started) {
+            qWarning() << "HttpServer: Failed to start reactor" << i << "on port" << port;
+            stopReactors();
+            return false;
+        }
+    }
+
+    qDebug() << "HttpServer: Started" << reactorCount << "reactors on port" << port;
     return true;
 }
 
-void HttpServer::setupRoutes()
+void HttpServer::stopReactors()
+{
+    for (QThread *thread : std::as_const(m_reactorThreads)) {
+        thread->quit();
+        thread->wait();
+    }
+    qDeleteAll(m_reactorThreads);
+    m_reactorThreads.clear();
+    // Реакторы в своих потоках удаляются по QThread::finished, реактор основного потока - вместе с HttpServer
+    m_reactors.clear();
+}
+
+void HttpServer::setupRoutes(QHttpServer &httpServer)
 {
+    // Каждый маршрут копирует данные запроса и отдает работу пулу, возвращая QFuture:
+    // медленный запрос к БД не блокирует цикл событий и остальные соединения.
+
     // === Общие маршруты ===
-    m_httpServer.route("/login", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handleLogin(req); });
-    m_httpServer.route("/categories", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req){ return handleGetCategories(req); });
-    m_httpServer.route("/products", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req){ return handleGetProducts(req); });
-    m_httpServer.route("/images/<arg>", QHttpServerRequest::Method::Get, [this](const QString &fileName) {
-        return handleServeStaticFile(fileName);
+    httpServer.route("/login", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return submitLogin(req);
+    });
+    httpServer.route("/logout", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleLogout(data); });
+    });
+    httpServer.route("/token/refresh", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleRefreshToken(data); });
+    });
+    httpServer.route("/categories", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleGetCategories(data); });
+    });
+    httpServer.route("/products", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleGetProducts(data); });
+    });
+    httpServer.route("/products/filter", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleFilterProducts(data); });
+    });
+    httpServer.route("/search", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleSearch(data); });
+    });
+    httpServer.route("/suggest", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleSuggest(data); });
+    });
+    httpServer.route("/images/<arg>", QHttpServerRequest::Method::Get, [this](const QString &fileName, const QHttpServerRequest &req, QHttpServerResponder &responder) {
+        handleServeStaticFile(fileName, req, responder);
+    });
+    httpServer.route("/export/products", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req, QHttpServerResponder &responder) {
+        handleExportProducts(req, responder);
     });
-
     // === Маршруты для корзины ===
-    m_httpServer.route("/cart", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req){ return handleGetCart(req); });
-    m_httpServer.route("/cart", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handlePostCart(req); });
-    m_httpServer.route("/cart", QHttpServerRequest::Method::Delete, [this](const QHttpServerRequest &req){ return handleRemoveFromCart(req); });
-    m_httpServer.route("/order", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handlePostOrder(req); });
+    httpServer.route("/cart", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleGetCart(data); });
+    });
+    httpServer.route("/cart", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handlePostCart(data); });
+    });
+    httpServer.route("/cart", QHttpServerRequest::Method::Delete, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handleRemoveFromCart(data); });
+    });
+    httpServer.route("/order", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runInPool([this, data = RequestData(req)] { return handlePostOrder(data); });
+    });
 
     // === Маршруты для администратора ===
-    m_httpServer.route("/categories", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handlePostCategory(req); });
-    m_httpServer.route("/categories/<arg>", QHttpServerRequest::Method::Delete, [this](int categoryId, const QHttpServerRequest &req){
-        Q_UNUSED(req);
-        return handleDeleteCategory(categoryId);
+    // Метрики раскрывают нагрузку и внутреннее устройство сервера, поэтому только для администратора
+    httpServer.route("/metrics", QHttpServerRequest::Method::Get, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this] { return handleGetMetrics(); });
+    });
+    httpServer.route("/categories", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handlePostCategory(data); });
+    });
+    httpServer.route("/categories/<arg>", QHttpServerRequest::Method::Delete, [this](int categoryId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, categoryId] { return handleDeleteCategory(categoryId); });
+    });
+    httpServer.route("/products", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handlePostProducts(data); });
+    });
+    httpServer.route("/products/<arg>", QHttpServerRequest::Method::Delete, [this](int productId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, productId] { return handleDeleteProduct(productId); });
+    });
+    httpServer.route("/products/<arg>", QHttpServerRequest::Method::Patch, [this](int productId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, productId, data = RequestData(req)] { return handleUpdateProduct(productId, data); });
+    });
+    httpServer.route("/upload/image", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handleImageUpload(data); });
+    });
+    httpServer.route("/uploads", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handleCreateUpload(m_uploadStore, data); });
+    });
+    httpServer.route("/uploads/<arg>", QHttpServerRequest::Method::Get, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId] { return handleGetUpload(m_uploadStore, uploadId); });
+    });
+    httpServer.route("/uploads/<arg>", QHttpServerRequest::Method::Patch, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId, data = RequestData(req)] { return handleUploadChunk(m_uploadStore, uploadId, data); });
     });
-    m_httpServer.route("/products", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handlePostProducts(req); });
-    m_httpServer.route("/products/<arg>", QHttpServerRequest::Method::Delete, [this](int productId, const QHttpServerRequest &req){
-        Q_UNUSED(req);
-        return handleDeleteProduct(productId);
+    httpServer.route("/uploads/<arg>", QHttpServerRequest::Method::Delete, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId] { return handleCancelUpload(m_uploadStore, uploadId); });
     });
-    m_httpServer.route("/products/<arg>", QHttpServerRequest::Method::Patch, [this](int productId, const QHttpServerRequest &req){
-        return handleUpdateProduct(productId, req);
+    httpServer.route("/uploads/<arg>/finalize", QHttpServerRequest::Method::Post, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId] { return handleFinalizeImageUpload(uploadId); });
     });
-    m_httpServer.route("/upload/image", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req){ return handleImageUpload(req); });
-    m_httpServer.route("/products/<arg>/category_link", QHttpServerRequest::Method::Patch, [this](int productId, const QHttpServerRequest &req){
-        return handleChangeProductCategory(productId, req);
+    httpServer.route("/products/<arg>/category_link", QHttpServerRequest::Method::Patch, [this](int productId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, productId, data = RequestData(req)] { return handleChangeProductCategory(productId, data); });
+    });
+    httpServer.route("/admin/keys/rotate", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this] { return handleRotateSigningKey(); });
+    });
+    httpServer.route("/jobs/<arg>", QHttpServerRequest::Method::Get, [this](const QString &jobId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, jobId] { return handleGetJob(jobId); });
+    });
+    // Импорт каталога: файл загружается частями в /imports/uploads, затем POST /imports ставит задачу
+    httpServer.route("/imports/uploads", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handleCreateUpload(m_importUploads, data); });
+    });
+    httpServer.route("/imports/uploads/<arg>", QHttpServerRequest::Method::Get, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId] { return handleGetUpload(m_importUploads, uploadId); });
+    });
+    httpServer.route("/imports/uploads/<arg>", QHttpServerRequest::Method::Patch, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId, data = RequestData(req)] { return handleUploadChunk(m_importUploads, uploadId, data); });
+    });
+    httpServer.route("/imports/uploads/<arg>", QHttpServerRequest::Method::Delete, [this](const QString &uploadId, const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, uploadId] { return handleCancelUpload(m_importUploads, uploadId); });
+    });
+    httpServer.route("/imports", QHttpServerRequest::Method::Post, [this](const QHttpServerRequest &req) {
+        return runAsAdmin(req, [this, data = RequestData(req)] { return handlePostImport(data); });
     });
 }
 
 // --- Реализации обработчиков маршрутов ---
 
-QHttpServerResponse HttpServer::handleLogin(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleLogin(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Post) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
@@ -105,6 +551,13 @@ QHttpServerResponse HttpServer::handleLogin(const QHttpServerRequest &request)
 
     QJsonObject authResult = m_dbHandler->authenticateUser(login, password);
     if (!authResult.isEmpty()) {
+        // Короткоживущий подписанный токен доступа проверяется в каждом запросе без БД,
+        // а токен сессии нужен только для его обновления
+        const int userId = authResult["user_id"].toInt();
+        const QString role = authResult["user_role"].toString();
+        authResult["access_token"] = QString::fromLatin1(m_tokens.issue(userId, role));
+        authResult["expires_in"] = m_tokens.ttlSeconds();
+        authResult["refresh_token"] = QString::fromLatin1(m_sessions.create(userId, role));
         return QHttpServerResponse(authResult, QHttpServerResponse::StatusCode::Ok);
     } else {
         return QHttpServerResponse("Unauthorized: Invalid credentials",
@@ -112,38 +565,331 @@ QHttpServerResponse HttpServer::handleLogin(const QHttpServerRequest &request)
     }
 }
 
-QHttpServerResponse HttpServer::handleGetCategories(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleLogout(const RequestData &request)
+{
+    const QByteArrayView authorization = request.headers().value(QHttpHeaders::WellKnownHeader::Authorization);
+    m_sessions.revoke(bearerToken(authorization).toByteArray());
+    return QHttpServerResponse(QHttpServerResponse::StatusCode::NoContent);
+}
+
+QHttpServerResponse HttpServer::handleRefreshToken(const RequestData &request)
+{
+    const QByteArrayView authorization = request.headers().value(QHttpHeaders::WellKnownHeader::Authorization);
+    const std::optional<Session> session = m_sessions.validate(bearerToken(authorization).toByteArray());
+    if (!session) {
+        return QHttpServerResponse("Unauthorized: Missing or expired session token.",
+                                   QHttpServerResponse::StatusCode::Unauthorized);
+    }
+    QJsonObject response;
+    response["access_token"] = QString::fromLatin1(m_tokens.issue(session->userId, session->role));
+    response["expires_in"] = m_tokens.ttlSeconds();
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Ok);
+}
+
+QByteArrayView HttpServer::bearerToken(QByteArrayView authorization)
+{
+    if (!authorization.startsWith("Bearer ")) {
+        return QByteArrayView();
+    }
+    return authorization.sliced(7).trimmed();
+}
+
+std::optional<QHttpServerResponse> HttpServer::checkUserAccess(const RequestData &request, int userId)
+{
+    const QByteArrayView authorization = request.headers().value(QHttpHeaders::WellKnownHeader::Authorization);
+    const std::optional<AccessClaims> claims = m_tokens.verify(bearerToken(authorization));
+    if (!claims) {
+        return QHttpServerResponse("Unauthorized: Missing, invalid or expired access token.",
+                                   QHttpServerResponse::StatusCode::Unauthorized);
+    }
+    // Пользователь работает только со своей корзиной и заказами
+    if (claims->userId != userId) {
+        return QHttpServerResponse("Forbidden", QHttpServerResponse::StatusCode::Forbidden);
+    }
+    return std::nullopt;
+}
+
+std::optional<QHttpServerResponse> HttpServer::checkAdminAccess(QByteArrayView authorization)
+{
+    const std::optional<AccessClaims> claims = m_tokens.verify(bearerToken(authorization));
+    if (!claims) {
+        return QHttpServerResponse("Unauthorized: Missing, invalid or expired access token.",
+                                   QHttpServerResponse::StatusCode::Unauthorized);
+    }
+    if (!claims->isAdmin) {
+        return QHttpServerResponse("Forbidden: Admin role required.", QHttpServerResponse::StatusCode::Forbidden);
+    }
+    return std::nullopt;
+}
+
+QHttpServerResponse HttpServer::handleGetCategories(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Get) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
     }
-    QJsonArray categories = m_dbHandler->getCategories();
-    return QHttpServerResponse(categories, QHttpServerResponse::StatusCode::Ok);
+    const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+    // Список категорий не зависит от остатков: продажи не сбрасывают его из кэша
+    const CachedResponse cached = m_responseCache.get("categories", catalog->structureVersion, [&catalog]() {
+        return QJsonDocument(catalog->categoriesJson()).toJson(QJsonDocument::Compact);
+    });
+    return cachedJsonResponse(request, cached);
 }
 
-QHttpServerResponse HttpServer::handleGetProducts(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleGetProducts(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Get) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
     }
     const QUrlQuery queryParams = request.query();
-    if (queryParams.hasQueryItem("category_id")) {
-        bool ok;
-        int categoryId = queryParams.queryItemValue("category_id").toInt(&ok);
-        if (ok) {
-            QJsonArray products = m_dbHandler->getProductsByCategory(categoryId);
-            return QHttpServerResponse(products, QHttpServerResponse::StatusCode::Ok);
-        } else {
-            return QHttpServerResponse("Bad Request: Invalid category_id",
+    if (!queryParams.hasQueryItem("category_id")) {
+        return QHttpServerResponse("Bad Request: category_id is required",
+                                   QHttpServerResponse::StatusCode::BadRequest);
+    }
+    bool ok;
+    const int categoryId = queryParams.queryItemValue("category_id").toInt(&ok);
+    if (!ok) {
+        return QHttpServerResponse("Bad Request: Invalid category_id",
+                                   QHttpServerResponse::StatusCode::BadRequest);
+    }
+    if (queryParams.hasQueryItem("limit") || queryParams.hasQueryItem("cursor") || queryParams.hasQueryItem("sort")
+        || queryParams.hasQueryItem("min_price") || queryParams.hasQueryItem("max_price")
+        || queryParams.hasQueryItem("in_stock")) {
+        return handleGetProductsPage(request, categoryId);
+    }
+
+    // Без параметров страницы - вся категория одним массивом, как раньше
+    const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+    if (!catalog->categories.contains(categoryId)) {
+        // Несуществующие категории не кэшируем, чтобы произвольные id не раздували кэш
+        return QHttpServerResponse(QJsonArray(), QHttpServerResponse::StatusCode::Ok);
+    }
+    const CachedResponse cached = m_responseCache.get("products:" + QByteArray::number(categoryId), catalog->version,
+                                                      [&catalog, categoryId]() {
+        return QJsonDocument(catalog->productsJson(categoryId)).toJson(QJsonDocument::Compact);
+    });
+    return cachedJsonResponse(request, cached);
+}
+
+QHttpServerResponse HttpServer::handleGetProductsPage(const RequestData &request, int categoryId)
+{
+    const QUrlQuery queryParams = request.query();
+    int limit = kDefaultProductPageSize;
+    if (queryParams.hasQueryItem("limit")) {
+        bool ok = false;
+        limit = queryParams.queryItemValue("limit").toInt(&ok);
+        if (!ok || limit <= 0) {
+            return QHttpServerResponse("Bad Request: Invalid limit", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        limit = qMin(limit, kMaxProductPageSize);
+    }
+
+    std::optional<ProductPageCursor> after;
+    if (queryParams.hasQueryItem("cursor")) {
+        after = ProductPageCursor::decode(queryParams.queryItemValue("cursor").toLatin1());
+        if (!after) {
+            return QHttpServerResponse("Bad Request: Invalid cursor", QHttpServerResponse::StatusCode::BadRequest);
+        }
+    }
+    // Фильтры по цене и наличию отвечаются срезом индекса по цене, поэтому только для sort=price
+    PriceFilter filter;
+    auto parsePrice = [&queryParams](const QString &name, std::optional<double> *price) {
+        if (!queryParams.hasQueryItem(name)) {
+            return true;
+        }
+        bool ok = false;
+        const double value = queryParams.queryItemValue(name).toDouble(&ok);
+        if (!ok || value < 0) {
+            return false;
+        }
+        *price = value;
+        return true;
+    };
+    if (!parsePrice("min_price", &filter.minPrice) || !parsePrice("max_price", &filter.maxPrice)) {
+        return QHttpServerResponse("Bad Request: Invalid min_price or max_price", QHttpServerResponse::StatusCode::BadRequest);
+    }
+    if (queryParams.hasQueryItem("in_stock")) {
+        const QString inStock = queryParams.queryItemValue("in_stock");
+        if (inStock != "0" && inStock != "1") {
+            return QHttpServerResponse("Bad Request: in_stock must be 0 or 1", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        filter.inStockOnly = (inStock == "1");
+    }
+    const bool filtered = filter.minPrice || filter.maxPrice || filter.inStockOnly;
+
+    ProductSort sort = after ? after->sort : filtered ? ProductSort::Price : ProductSort::Id;
+    if (queryParams.hasQueryItem("sort")) {
+        const std::optional<ProductSort> requested = ProductPageCursor::sortFromString(queryParams.queryItemValue("sort"));
+        if (!requested || (after && after->sort != *requested)) {
+            return QHttpServerResponse("Bad Request: sort must be id, price or name and match the cursor",
                                        QHttpServerResponse::StatusCode::BadRequest);
         }
-    } else {
-        return QHttpServerResponse("Bad Request: category_id is required",
+        sort = *requested;
+    }
+    if (filtered && sort != ProductSort::Price) {
+        return QHttpServerResponse("Bad Request: min_price, max_price and in_stock require sort=price",
                                    QHttpServerResponse::StatusCode::BadRequest);
     }
+
+    const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+    auto buildPage = [&]() {
+        std::optional<ProductPageCursor> next;
+        QJsonObject page;
+        page["items"] = filtered ? catalog->productsByPrice(categoryId, filter, after, limit, &next)
+                                 : catalog->productsPage(categoryId, sort, after, limit, &next);
+        page["next_cursor"] = next ? QJsonValue(QString::fromLatin1(next->encode())) : QJsonValue(QJsonValue::Null);
+        return QJsonDocument(page).toJson(QJsonDocument::Compact);
+    };
+    // Первая страница открывается при каждом выборе категории, поэтому кэшируется;
+    // следующие страницы и выборки с фильтром ищутся двоичным поиском и в кэш не попадают.
+    // В товарах есть product_stock, поэтому ключ - полная версия: пока идут продажи, страница
+    // пересобирается не чаще публикации остатков (раз в секунду).
+    if (after || filtered || !catalog->categories.contains(categoryId)) {
+        const QByteArray body = buildPage();
+        return QHttpServerResponse("application/json", body, QHttpServerResponse::StatusCode::Ok);
+    }
+    const QByteArray key = "products:" + QByteArray::number(categoryId) + ':'
+                           + queryParams.queryItemValue("sort").toLatin1() + ':' + QByteArray::number(limit);
+    return cachedJsonResponse(request, m_responseCache.get(key, catalog->version, buildPage));
+}
+
+QHttpServerResponse HttpServer::handleFilterProducts(const RequestData &request)
+{
+    const QUrlQuery queryParams = request.query();
+    QList<int> categoryIds;
+    const QStringList items = queryParams.queryItemValue("category_ids").split(',', Qt::SkipEmptyParts);
+    for (const QString &item : items) {
+        bool ok = false;
+        const int categoryId = item.trimmed().toInt(&ok);
+        if (!ok || categoryId <= 0) {
+            return QHttpServerResponse("Bad Request: Invalid category_ids", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        categoryIds.append(categoryId);
+    }
+    if (categoryIds.isEmpty() || categoryIds.size() > kMaxFilterCategories) {
+        return QHttpServerResponse("Bad Request: category_ids must list 1 to " + QString::number(kMaxFilterCategories)
+                                   + " categories", QHttpServerResponse::StatusCode::BadRequest);
+    }
+    const QString match = queryParams.hasQueryItem("match") ? queryParams.queryItemValue("match") : QString("all");
+    if (match != "all" && match != "any") {
+        return QHttpServerResponse("Bad Request: match must be all or any", QHttpServerResponse::StatusCode::BadRequest);
+    }
+
+    int limit = kDefaultProductPageSize;
+    if (queryParams.hasQueryItem("limit")) {
+        bool ok = false;
+        limit = queryParams.queryItemValue("limit").toInt(&ok);
+        if (!ok || limit <= 0) {
+            return QHttpServerResponse("Bad Request: Invalid limit", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        limit = qMin(limit, kMaxProductPageSize);
+    }
+    // Выборка идет по возрастанию product_id, поэтому курсор - тот же, что у sort=id
+    int afterId = 0;
+    if (queryParams.hasQueryItem("cursor")) {
+        const std::optional<ProductPageCursor> after = ProductPageCursor::decode(queryParams.queryItemValue("cursor").toLatin1());
+        if (!after || after->sort != ProductSort::Id) {
+            return QHttpServerResponse("Bad Request: Invalid cursor", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        afterId = after->id;
+    }
+
+    const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+    const RoaringBitmap selection = catalog->selectProducts(categoryIds, match == "all");
+    bool more = false;
+    const QJsonArray products = catalog->productsJson(selection, afterId, limit, &more);
+
+    QJsonObject page;
+    page["total"] = selection.cardinality();
+    page["items"] = products;
+    if (more && !products.isEmpty()) {
+        ProductPageCursor next;
+        next.sort = ProductSort::Id;
+        next.id = products.last().toObject().value("product_id").toInt();
+        page["next_cursor"] = QString::fromLatin1(next.encode());
+    } else {
+        page["next_cursor"] = QJsonValue(QJsonValue::Null);
+    }
+    // Фасеты нужны для построения фильтров, поэтому считаются только для первой страницы
+    if (afterId == 0) {
+        page["facets"] = catalog->facetCounts(selection);
+    }
+    return QHttpServerResponse(page, QHttpServerResponse::StatusCode::Ok);
 }
 
-QHttpServerResponse HttpServer::handlePostProducts(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleSearch(const RequestData &request)
+{
+    const QUrlQuery queryParams = request.query();
+    const QString text = queryParams.queryItemValue("q", QUrl::FullyDecoded).simplified();
+    if (text.isEmpty()) {
+        return QHttpServerResponse("Bad Request: q is required", QHttpServerResponse::StatusCode::BadRequest);
+    }
+    if (text.size() > kMaxSearchQueryLength) {
+        return QHttpServerResponse("Bad Request: q is too long", QHttpServerResponse::StatusCode::BadRequest);
+    }
+
+    int limit = kDefaultSearchPageSize;
+    if (queryParams.hasQueryItem("limit")) {
+        bool ok = false;
+        limit = queryParams.queryItemValue("limit").toInt(&ok);
+        if (!ok || limit <= 0) {
+            return QHttpServerResponse("Bad Request: Invalid limit", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        limit = qMin(limit, kMaxSearchPageSize);
+    }
+
+    std::optional<SearchCursor> after;
+    if (queryParams.hasQueryItem("cursor")) {
+        after = SearchCursor::decode(queryParams.queryItemValue("cursor").toLatin1());
+        if (!after) {
+            return QHttpServerResponse("Bad Request: Invalid cursor", QHttpServerResponse::StatusCode::BadRequest);
+        }
+    }
+
+    const SearchResult result = m_dbHandler->searchProducts(text, after, limit);
+    if (result.timedOut) {
+        return QHttpServerResponse("Unprocessable Entity: Search query matches too many products, refine it.",
+                                   QHttpServerResponse::StatusCode::UnprocessableEntity);
+    }
+    if (!result.ok) {
+        return QHttpServerResponse("Internal Server Error: Search failed",
+                                   QHttpServerResponse::StatusCode::InternalServerError);
+    }
+    QJsonObject page;
+    page["items"] = result.items;
+    page["next_cursor"] = result.next ? QJsonValue(QString::fromLatin1(result.next->encode())) : QJsonValue(QJsonValue::Null);
+    return QHttpServerResponse(page, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse HttpServer::handleSuggest(const RequestData &request)
+{
+    const QUrlQuery queryParams = request.query();
+    const QString text = queryParams.queryItemValue("q", QUrl::FullyDecoded);
+    if (text.size() > kMaxSearchQueryLength) {
+        return QHttpServerResponse("Bad Request: q is too long", QHttpServerResponse::StatusCode::BadRequest);
+    }
+    int limit = kDefaultSuggestCount;
+    if (queryParams.hasQueryItem("limit")) {
+        bool ok = false;
+        limit = queryParams.queryItemValue("limit").toInt(&ok);
+        if (!ok || limit <= 0) {
+            return QHttpServerResponse("Bad Request: Invalid limit", QHttpServerResponse::StatusCode::BadRequest);
+        }
+        limit = qMin(limit, kMaxSuggestCount);
+    }
+
+    // Пустой запрос - пустой список: клиент шлет запрос на каждое нажатие, в том числе после стирания
+    QJsonArray items;
+    const QList<Suggestion> suggestions = m_dbHandler->suggestProducts(text, limit);
+    for (const Suggestion &suggestion : suggestions) {
+        QJsonObject item;
+        item["product_id"] = suggestion.productId;
+        item["product_name"] = suggestion.name;
+        items.append(item);
+    }
+    return QHttpServerResponse(items, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse HttpServer::handlePostProducts(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Post) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
@@ -151,20 +897,60 @@ QHttpServerResponse HttpServer::handlePostProducts(const QHttpServerRequest &req
     QJsonParseError parseError;
     QJsonDocument jsonDoc = QJsonDocument::fromJson(request.body(), &parseError);
 
-    if (parseError.error != QJsonParseError::NoError || !jsonDoc.isObject()) {
+    if (parseError.error != QJsonParseError::NoError || (!jsonDoc.isObject() && !jsonDoc.isArray())) {
         return QHttpServerResponse("Bad Request: Invalid JSON body. " + parseError.errorString(),
                                    QHttpServerResponse::StatusCode::BadRequest);
     }
 
-    if (m_dbHandler->addProduct(jsonDoc.object())) {
-        return QHttpServerResponse("Product Created", QHttpServerResponse::StatusCode::Created);
-    } else {
-        return QHttpServerResponse("Internal Server Error: Could not add product",
-                                   QHttpServerResponse::StatusCode::InternalServerError);
+    // Один товар - объект, как раньше; пакет - массив объектов
+    if (jsonDoc.isObject()) {
+        const ProductInsertResult result = m_dbHandler->addProducts(QJsonArray{jsonDoc.object()}).constFirst();
+        switch (result.status) {
+        case DbStatus::Ok:
+            return QHttpServerResponse("Product Created", QHttpServerResponse::StatusCode::Created);
+        case DbStatus::Invalid:
+            return QHttpServerResponse("Bad Request: " + result.error, QHttpServerResponse::StatusCode::BadRequest);
+        case DbStatus::Conflict:
+            return QHttpServerResponse("Conflict: " + result.error, QHttpServerResponse::StatusCode::Conflict);
+        default:
+            return QHttpServerResponse("Internal Server Error: Could not add product",
+                                       QHttpServerResponse::StatusCode::InternalServerError);
+        }
+    }
+
+    const QJsonArray productsArray = jsonDoc.array();
+    if (productsArray.isEmpty()) {
+        return QHttpServerResponse("Bad Request: Empty product list.", QHttpServerResponse::StatusCode::BadRequest);
     }
+    if (productsArray.size() > kMaxProductsPerRequest) {
+        return QHttpServerResponse(QString("Payload Too Large: At most %1 products per request.").arg(kMaxProductsPerRequest),
+                                   QHttpServerResponse::StatusCode::PayloadTooLarge);
+    }
+
+    // Результат по каждому элементу: при частичной ошибке клиент повторяет только отклоненные
+    const QList<ProductInsertResult> results = m_dbHandler->addProducts(productsArray);
+    QJsonArray resultsArray;
+    int created = 0;
+    for (qsizetype i = 0; i < results.size(); ++i) {
+        QJsonObject item;
+        item["index"] = int(i);
+        if (results[i].status == DbStatus::Ok) {
+            item["product_id"] = results[i].productId;
+            ++created;
+        } else {
+            item["error"] = results[i].error;
+        }
+        resultsArray.append(item);
+    }
+    QJsonObject response;
+    response["created"] = created;
+    response["failed"] = int(results.size()) - created;
+    response["results"] = resultsArray;
+    return QHttpServerResponse(response, created == results.size() ? QHttpServerResponse::StatusCode::Created
+                                                                    : QHttpServerResponse::StatusCode::MultiStatus);
 }
 
-QHttpServerResponse HttpServer::handlePostCart(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handlePostCart(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Post) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
@@ -189,15 +975,26 @@ QHttpServerResponse HttpServer::handlePostCart(const QHttpServerRequest &request
                                    QHttpServerResponse::StatusCode::BadRequest);
     }
 
-    if (m_dbHandler->addToCart(userId, productId)) {
+    if (std::optional<QHttpServerResponse> denied = checkUserAccess(request, userId)) {
+        return std::move(*denied);
+    }
+
+    switch (m_dbHandler->addToCart(userId, productId)) {
+    case DbStatus::Ok:
         return QHttpServerResponse("Product added to cart", QHttpServerResponse::StatusCode::Ok);
-    } else {
+    case DbStatus::NotFound:
+        return QHttpServerResponse("Not Found: User or product does not exist.",
+                                   QHttpServerResponse::StatusCode::NotFound);
+    case DbStatus::SoldOut:
+        return QHttpServerResponse("Conflict: Product is sold out.",
+                                   QHttpServerResponse::StatusCode::Conflict);
+    default:
         return QHttpServerResponse("Internal Server Error: Could not add to cart",
                                    QHttpServerResponse::StatusCode::InternalServerError);
     }
 }
 
-QHttpServerResponse HttpServer::handlePostOrder(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handlePostOrder(const RequestData &request)
 {
     if (request.method() != QHttpServerRequest::Method::Post) {
         return QHttpServerResponse(QHttpServerResponse::StatusCode::MethodNotAllowed);
@@ -220,14 +1017,31 @@ QHttpServerResponse HttpServer::handlePostOrder(const QHttpServerRequest &reques
                                    QHttpServerResponse::StatusCode::BadRequest);
     }
 
-    if (m_dbHandler->placeOrder(userId)) {
+    if (std::optional<QHttpServerResponse> denied = checkUserAccess(request, userId)) {
+        return std::move(*denied);
+    }
+
+    switch (m_dbHandler->placeOrder(userId)) {
+    case DbStatus::Ok:
         return QHttpServerResponse("Order placed", QHttpServerResponse::StatusCode::Ok);
-    } else {
-        return QHttpServerResponse("Internal Server Error or Order cannot be placed (e.g. empty cart)",
+    case DbStatus::SoldOut:
+        return QHttpServerResponse("Conflict: Some products in the cart are sold out.",
+                                   QHttpServerResponse::StatusCode::Conflict);
+    case DbStatus::Conflict: {
+        // Заказ не дождался блокировки строк после повторов: товар не распродан, а перегружен
+        QHttpServerResponse response("Service Unavailable: Products in the cart are in high demand, please retry.",
+                                     QHttpServerResponse::StatusCode::ServiceUnavailable);
+        QHttpHeaders headers = response.headers();
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::RetryAfter, "1");
+        response.setHeaders(std::move(headers));
+        return response;
+    }
+    default:
+        return QHttpServerResponse("Internal Server Error: Order cannot be placed",
                                    QHttpServerResponse::StatusCode::InternalServerError);
     }
 }
-QHttpServerResponse HttpServer::handleGetCart(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleGetCart(const RequestData &request)
 {
     if (!request.query().hasQueryItem("user_id")) {
         return QHttpServerResponse("Bad Request: Missing user_id", QHttpServerResponse::StatusCode::BadRequest);
@@ -238,6 +1052,10 @@ QHttpServerResponse HttpServer::handleGetCart(const QHttpServerRequest &request)
         return QHttpServerResponse("Bad Request: Invalid user_id", QHttpServerResponse::StatusCode::BadRequest);
     }
 
+    if (std::optional<QHttpServerResponse> denied = checkUserAccess(request, userId)) {
+        return std::move(*denied);
+    }
+
     QJsonObject cartData = m_dbHandler->getCartContents(userId);
     if (cartData.contains("error")) {
         return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
@@ -245,7 +1063,7 @@ QHttpServerResponse HttpServer::handleGetCart(const QHttpServerRequest &request)
     return QHttpServerResponse(cartData, QHttpServerResponse::StatusCode::Ok);
 }
 
-QHttpServerResponse HttpServer::handleRemoveFromCart(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleRemoveFromCart(const RequestData &request)
 {
     const QUrlQuery params = request.query();
     if (!params.hasQueryItem("user_id") || !params.hasQueryItem("product_id")) {
@@ -259,6 +1077,10 @@ QHttpServerResponse HttpServer::handleRemoveFromCart(const QHttpServerRequest &r
         return QHttpServerResponse("Bad Request: Invalid user_id or product_id", QHttpServerResponse::StatusCode::BadRequest);
     }
 
+    if (std::optional<QHttpServerResponse> denied = checkUserAccess(request, userId)) {
+        return std::move(*denied);
+    }
+
     if (m_dbHandler->removeFromCart(userId, productId)) {
         return QHttpServerResponse("Product removed from cart", QHttpServerResponse::StatusCode::Ok);
     } else {
@@ -266,7 +1088,7 @@ QHttpServerResponse HttpServer::handleRemoveFromCart(const QHttpServerRequest &r
     }
 }
 
-QHttpServerResponse HttpServer::handlePostCategory(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handlePostCategory(const RequestData &request)
 {
     QJsonParseError error;
     const auto json = QJsonDocument::fromJson(request.body(), &error);
@@ -285,21 +1107,154 @@ QHttpServerResponse HttpServer::handlePostCategory(const QHttpServerRequest &req
 
 QHttpServerResponse HttpServer::handleDeleteCategory(int categoryId)
 {
-    if (m_dbHandler->deleteCategory(categoryId))
-        return QHttpServerResponse(QHttpServerResponse::StatusCode::NoContent);
-    else
-        return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
+    if (!m_dbHandler->catalogSnapshot()->categories.contains(categoryId)) {
+        return QHttpServerResponse("Not Found: Category does not exist.", QHttpServerResponse::StatusCode::NotFound);
+    }
+
+    // Большая категория удаляется долго, поэтому запрос только ставит задачу и сразу отвечает 202
+    bool created = false;
+    const QString jobId = m_jobs.create("delete_category", "category:" + QString::number(categoryId), &created);
+    if (created) {
+        m_jobPool.start([this, jobId, categoryId]() { runDeleteCategoryJob(jobId, categoryId); });
+    }
+
+    QJsonObject response;
+    response["job_id"] = jobId;
+    response["status_url"] = "/jobs/" + jobId;
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Accepted);
+}
+
+void HttpServer::runDeleteCategoryJob(const QString &jobId, int categoryId)
+{
+    m_jobs.setRunning(jobId);
+    qint64 processed = 0;
+    for (;;) {
+        if (m_stopping) {
+            // Уже удаленные пачки остаются удаленными; повторный DELETE доделает остальное
+            m_jobs.finish(jobId, "Server is shutting down");
+            return;
+        }
+        const int count = m_dbHandler->deleteCategoryBatch(categoryId, kCategoryDeleteBatchSize);
+        if (count < 0) {
+            m_jobs.finish(jobId, "Database error while deleting category products");
+            return;
+        }
+        if (count == 0) {
+            break;
+        }
+        processed += count;
+        m_jobs.setProgress(jobId, processed);
+        QThread::msleep(kCategoryDeleteBatchPauseMs);
+    }
+
+    if (!m_dbHandler->deleteCategoryRow(categoryId)) {
+        m_jobs.finish(jobId, "Database error while deleting category");
+        return;
+    }
+    qInfo() << "HttpServer: Category" << categoryId << "deleted," << processed << "product link(s) processed";
+    m_jobs.finish(jobId);
+}
+
+QHttpServerResponse HttpServer::handleGetJob(const QString &jobId)
+{
+    const std::optional<QJsonObject> status = m_jobs.statusJson(jobId);
+    if (!status) {
+        return QHttpServerResponse("Not Found: Unknown or expired job.", QHttpServerResponse::StatusCode::NotFound);
+    }
+    return QHttpServerResponse(*status, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse HttpServer::handlePostImport(const RequestData &request)
+{
+    QJsonParseError error;
+    const QJsonDocument json = QJsonDocument::fromJson(request.body(), &error);
+    if (error.error != QJsonParseError::NoError || !json.isObject()) {
+        return QHttpServerResponse("Bad Request: Expected {\"upload_id\": ..., \"format\": \"ndjson\" | \"csv\"}.",
+                                   QHttpServerResponse::StatusCode::BadRequest);
+    }
+    const QString uploadId = json.object().value("upload_id").toString();
+    const std::optional<ProductImportReader::Format> format =
+        ProductImportReader::formatFromString(json.object().value("format").toString("ndjson"));
+    if (uploadId.isEmpty() || !format) {
+        return QHttpServerResponse("Bad Request: upload_id is required, format must be ndjson or csv.",
+                                   QHttpServerResponse::StatusCode::BadRequest);
+    }
+
+    QString filePath;
+    switch (m_importUploads.take(uploadId, &filePath)) {
+    case UploadStore::Status::Ok:
+        break;
+    case UploadStore::Status::NotFound:
+        return QHttpServerResponse("Upload not found", QHttpServerResponse::StatusCode::NotFound);
+    default:
+        return QHttpServerResponse("Conflict: Upload is not complete.", QHttpServerResponse::StatusCode::Conflict);
+    }
+
+    // Файл уже на диске; разбор и COPY идут в пуле задач, клиент следит за ходом по status_url
+    bool created = false;
+    const QString jobId = m_jobs.create("import_products", "import:" + uploadId, &created);
+    if (created) {
+        ++m_importsStarted;
+        m_jobPool.start([this, jobId, filePath, format = *format]() { runImportJob(jobId, filePath, format); });
+    }
+
+    QJsonObject response;
+    response["job_id"] = jobId;
+    response["status_url"] = "/jobs/" + jobId;
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Accepted);
+}
+
+void HttpServer::runImportJob(const QString &jobId, const QString &filePath, ProductImportReader::Format format)
+{
+    m_jobs.setRunning(jobId);
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QFile::remove(filePath);
+        m_jobs.finish(jobId, "Failed to open import file");
+        return;
+    }
+    const qint64 fileBytes = file.size();
+
+    ProductImportReader reader(&file, format);
+    // При остановке сервера импорт отменяется целиком: транзакция откатывается
+    const ImportResult result = m_dbHandler->importProducts(reader, [&](const ImportProgress &progress) {
+        m_jobs.setProgress(jobId, progress.rowsRead);
+        m_jobs.setDetails(jobId, importDetails(progress, fileBytes));
+        return !m_stopping;
+    });
+    file.close();
+    QFile::remove(filePath);
+
+    QJsonObject details = importDetails(result.progress, fileBytes);
+    details["inserted"] = result.inserted;
+    details["updated"] = result.updated;
+    details["linked"] = result.linked;
+    QJsonArray rejects;
+    for (const ImportReject &reject : result.rejects) {
+        QJsonObject item;
+        item["record"] = reject.record;
+        item["reason"] = reject.reason;
+        rejects.append(item);
+    }
+    details["rejects"] = rejects;
+    m_jobs.setProgress(jobId, result.progress.rowsRead);
+    m_jobs.setDetails(jobId, details);
+    m_jobs.finish(jobId, result.ok ? QString() : result.error);
 }
 
 QHttpServerResponse HttpServer::handleDeleteProduct(int productId)
 {
-    if (m_dbHandler->deleteProduct(productId))
+    switch (m_dbHandler->deleteProduct(productId)) {
+    case DbStatus::Ok:
         return QHttpServerResponse(QHttpServerResponse::StatusCode::NoContent);
-    else
+    case DbStatus::NotFound:
+        return QHttpServerResponse("Not Found: Product does not exist.", QHttpServerResponse::StatusCode::NotFound);
+    default:
         return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
+    }
 }
 
-QHttpServerResponse HttpServer::handleUpdateProduct(int productId, const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleUpdateProduct(int productId, const RequestData &request)
 {
     QJsonParseError error;
     const auto json = QJsonDocument::fromJson(request.body(), &error);
@@ -313,41 +1268,170 @@ QHttpServerResponse HttpServer::handleUpdateProduct(int productId, const QHttpSe
     QString fieldName = jsonObj.keys().first();
     QVariant value = jsonObj.value(fieldName).toVariant();
 
-    if (m_dbHandler->updateProductField(productId, fieldName, value))
+    switch (m_dbHandler->updateProductField(productId, fieldName, value)) {
+    case DbStatus::Ok:
         return QHttpServerResponse("Product updated", QHttpServerResponse::StatusCode::Ok);
-    else
-        return QHttpServerResponse("Internal Server Error or Invalid Field", QHttpServerResponse::StatusCode::InternalServerError);
+    case DbStatus::NotFound:
+        return QHttpServerResponse("Not Found: Product does not exist.", QHttpServerResponse::StatusCode::NotFound);
+    case DbStatus::Invalid:
+        return QHttpServerResponse("Bad Request: Invalid field or value.", QHttpServerResponse::StatusCode::BadRequest);
+    case DbStatus::Conflict:
+        return QHttpServerResponse("Conflict: Product with this name already exists.", QHttpServerResponse::StatusCode::Conflict);
+    default:
+        return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
+    }
 }
 
-QHttpServerResponse HttpServer::handleImageUpload(const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleImageUpload(const RequestData &request)
 {
-    // Создаем директорию, если ее нет. Директория будет создана там, где запущен сервер.
-    QDir dir("images");
-    if (!dir.exists()) {
-        dir.mkpath(".");
+    // Загрузка одним запросом: тело уже целиком в памяти, поэтому подходит только для небольших файлов
+    if (request.body().isEmpty()) {
+        return QHttpServerResponse("Bad Request: Empty body.", QHttpServerResponse::StatusCode::BadRequest);
+    }
+    if (request.body().size() > m_uploadStore.maxBytes()) {
+        return QHttpServerResponse("Payload Too Large", QHttpServerResponse::StatusCode::PayloadTooLarge);
     }
 
-    // Генерируем уникальное имя файла на основе UUID, чтобы избежать коллизий.
-    // Расширение можно определять по Content-Type, но для простоты предположим, что это .jpg
-    QString fileName = QUuid::createUuid().toString(QUuid::WithoutBraces) + ".jpg";
-    QString filePath = dir.filePath(fileName);
+    QString tempFilePath;
+    if (m_uploadStore.store(request.body(), &tempFilePath) != UploadStore::Status::Ok) {
+        return QHttpServerResponse("Failed to save image", QHttpServerResponse::StatusCode::InternalServerError);
+    }
+    return storeUploadedImage(tempFilePath);
+}
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(request.body()); // Пишем сырые байты из тела запроса в файл
-        file.close();
+QHttpServerResponse HttpServer::handleCreateUpload(UploadStore &store, const RequestData &request)
+{
+    QJsonParseError error;
+    const QJsonDocument json = QJsonDocument::fromJson(request.body(), &error);
+    if (error.error != QJsonParseError::NoError || !json.isObject() || !json.object().contains("size")) {
+        return QHttpServerResponse("Bad Request: Expected {\"size\": <bytes>}.", QHttpServerResponse::StatusCode::BadRequest);
+    }
 
-        QJsonObject response;
-        response["status"] = "success";
-        // Возвращаем клиенту относительный путь, который он будет использовать для сохранения в БД
-        response["image_path"] = "/images/" + fileName;
-        return QHttpServerResponse(response);
+    const qint64 size = json.object().value("size").toInteger();
+    UploadInfo info;
+    switch (store.create(size, &info)) {
+    case UploadStore::Status::Ok:
+        break;
+    case UploadStore::Status::TooLarge:
+        return QHttpServerResponse("Payload Too Large: Max " + QString::number(store.maxBytes()) + " bytes.",
+                                   QHttpServerResponse::StatusCode::PayloadTooLarge);
+    default:
+        return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
     }
 
-    return QHttpServerResponse("Failed to save image", QHttpServerResponse::StatusCode::InternalServerError);
+    QJsonObject response;
+    response["upload_id"] = info.id;
+    response["size"] = info.size;
+    response["offset"] = info.offset;
+    response["max_chunk_bytes"] = store.maxChunkBytes();
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Created);
 }
 
-QHttpServerResponse HttpServer::handleChangeProductCategory(int productId, const QHttpServerRequest &request)
+QHttpServerResponse HttpServer::handleGetUpload(UploadStore &store, const QString &uploadId)
+{
+    UploadInfo info;
+    if (store.info(uploadId, &info) != UploadStore::Status::Ok) {
+        return QHttpServerResponse("Upload not found", QHttpServerResponse::StatusCode::NotFound);
+    }
+    QJsonObject response;
+    response["upload_id"] = info.id;
+    response["size"] = info.size;
+    response["offset"] = info.offset;
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse HttpServer::handleUploadChunk(UploadStore &store, const QString &uploadId, const RequestData &request)
+{
+    // Смещение фрагмента передается в заголовке Upload-Offset
+    bool ok = false;
+    const qint64 offset = request.headers().value("Upload-Offset").toByteArray().toLongLong(&ok);
+    if (!ok || offset < 0) {
+        return QHttpServerResponse("Bad Request: Missing or invalid Upload-Offset header.",
+                                   QHttpServerResponse::StatusCode::BadRequest);
+    }
+    if (request.body().isEmpty()) {
+        return QHttpServerResponse("Bad Request: Empty chunk.", QHttpServerResponse::StatusCode::BadRequest);
+    }
+
+    UploadInfo info;
+    const UploadStore::Status status = store.append(uploadId, offset, request.body(), &info);
+
+    QHttpServerResponse response(QHttpServerResponse::StatusCode::NoContent);
+    switch (status) {
+    case UploadStore::Status::Ok:
+        break;
+    case UploadStore::Status::NotFound:
+        return QHttpServerResponse("Upload not found", QHttpServerResponse::StatusCode::NotFound);
+    case UploadStore::Status::OffsetMismatch:
+    case UploadStore::Status::Busy:
+        // Клиент узнает из Upload-Offset, с какого места продолжать
+        response = QHttpServerResponse("Conflict: Unexpected offset.", QHttpServerResponse::StatusCode::Conflict);
+        break;
+    case UploadStore::Status::TooLarge:
+        return QHttpServerResponse("Payload Too Large", QHttpServerResponse::StatusCode::PayloadTooLarge);
+    default:
+        return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
+    }
+
+    QHttpHeaders headers = response.headers();
+    headers.replaceOrAppend("Upload-Offset", QByteArray::number(info.offset));
+    response.setHeaders(std::move(headers));
+    return response;
+}
+
+QHttpServerResponse HttpServer::handleFinalizeImageUpload(const QString &uploadId)
+{
+    QString tempFilePath;
+    switch (m_uploadStore.take(uploadId, &tempFilePath)) {
+    case UploadStore::Status::Ok:
+        return storeUploadedImage(tempFilePath);
+    case UploadStore::Status::NotFound:
+        return QHttpServerResponse("Upload not found", QHttpServerResponse::StatusCode::NotFound);
+    default:
+        return QHttpServerResponse("Conflict: Upload is not complete.", QHttpServerResponse::StatusCode::Conflict);
+    }
+}
+
+QHttpServerResponse HttpServer::handleCancelUpload(UploadStore &store, const QString &uploadId)
+{
+    store.remove(uploadId);
+    return QHttpServerResponse(QHttpServerResponse::StatusCode::NoContent);
+}
+
+QHttpServerResponse HttpServer::storeUploadedImage(const QString &tempFilePath)
+{
+    QFile tempFile(tempFilePath);
+    QByteArray header;
+    if (tempFile.open(QIODevice::ReadOnly)) {
+        header = tempFile.read(16);
+        tempFile.close();
+    }
+
+    // Расширение определяется по сигнатуре содержимого, а не по тому, что заявил клиент
+    const QString extension = detectImageExtension(header);
+    if (extension.isEmpty()) {
+        QFile::remove(tempFilePath);
+        return QHttpServerResponse("Unsupported Media Type: Expected JPEG, PNG, GIF or WebP.",
+                                   QHttpServerResponse::StatusCode::UnsupportedMediaType);
+    }
+
+    // Имя файла - хэш содержимого: повторная загрузка той же картинки не создает копию
+    const QString fileName = m_imageStore.store(tempFilePath, extension);
+    if (fileName.isEmpty()) {
+        return QHttpServerResponse("Failed to save image", QHttpServerResponse::StatusCode::InternalServerError);
+    }
+
+    // Уменьшенные варианты строятся в фоне, ответ их не ждет
+    m_imageVariants.schedule(fileName);
+
+    QJsonObject response;
+    response["status"] = "success";
+    // Возвращаем клиенту относительный путь, который он будет использовать для сохранения в БД
+    response["image_path"] = "/images/" + fileName;
+    return QHttpServerResponse(response);
+}
+
+QHttpServerResponse HttpServer::handleChangeProductCategory(int productId, const RequestData &request)
 {
     QJsonParseError error;
     const auto json = QJsonDocument::fromJson(request.body(), &error);
@@ -367,34 +1451,320 @@ QHttpServerResponse HttpServer::handleChangeProductCategory(int productId, const
         return QHttpServerResponse("Internal Server Error", QHttpServerResponse::StatusCode::InternalServerError);
 }
 
-QHttpServerResponse HttpServer::handleServeStaticFile(const QString &fileName)
+void HttpServer::handleExportProducts(const QHttpServerRequest &request, QHttpServerResponder &responder)
+{
+    HttpReactor::countRequestInCurrent();
+
+    // Проверка токена - только подпись, без БД, поэтому выполняется прямо в потоке реактора
+    const QByteArrayView authorization = request.headers().value(QHttpHeaders::WellKnownHeader::Authorization);
+    if (std::optional<QHttpServerResponse> denied = checkAdminAccess(authorization)) {
+        responder.sendResponse(std::move(*denied));
+        return;
+    }
+    const std::optional<ProductImportReader::Format> format =
+        ProductImportReader::formatFromString(request.query().queryItemValue("format").isEmpty()
+                                                  ? QStringLiteral("ndjson")
+                                                  : request.query().queryItemValue("format"));
+    if (!format) {
+        responder.sendResponse(QHttpServerResponse("Bad Request: format must be ndjson or csv.",
+                                                   QHttpServerResponse::StatusCode::BadRequest));
+        return;
+    }
+
+    // Сокет нужен, чтобы не отдавать данные быстрее, чем их забирает клиент, и заметить разрыв
+    QTcpSocket *socket = HttpReactor::connectionInCurrent(request.remoteAddress(), request.remotePort());
+    if (!socket) {
+        qWarning() << "HttpServer: Export connection not found for" << request.remoteAddress() << request.remotePort();
+        responder.sendResponse(QHttpServerResponse("Internal Server Error: Connection not found.",
+                                                   QHttpServerResponse::StatusCode::InternalServerError));
+        return;
+    }
+
+    auto pipe = std::make_shared<ExportPipe>(kExportPipeBytes, kExportStallTimeoutMs);
+    // Очереди нет: ожидающая выгрузка держала бы соединение клиента без ответа
+    if (!m_exportPool.tryStart([this, pipe, format = *format]() { runExport(pipe, format); })) {
+        ++m_exportsRejected;
+        QHttpServerResponse busy("Service Unavailable: Too many exports in progress.",
+                                 QHttpServerResponse::StatusCode::ServiceUnavailable);
+        QHttpHeaders headers = busy.headers();
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::RetryAfter, "10");
+        busy.setHeaders(std::move(headers));
+        responder.sendResponse(std::move(busy));
+        return;
+    }
+    ++m_exportsStarted;
+
+    QHttpHeaders headers;
+    if (*format == ProductImportReader::Format::Ndjson) {
+        headers.append(QHttpHeaders::WellKnownHeader::ContentType, "application/x-ndjson; charset=utf-8");
+        headers.append(QHttpHeaders::WellKnownHeader::ContentDisposition, "attachment; filename=\"products.ndjson\"");
+    } else {
+        headers.append(QHttpHeaders::WellKnownHeader::ContentType, "text/csv; charset=utf-8");
+        headers.append(QHttpHeaders::WellKnownHeader::ContentDisposition, "attachment; filename=\"products.csv\"");
+    }
+    headers.append(QHttpHeaders::WellKnownHeader::CacheControl, "no-store");
+    // ExportStreamer живет в потоке реактора вместе с соединением и удаляет себя сам
+    auto *streamer = new ExportStreamer(std::move(responder), pipe, socket, kExportSocketBacklogBytes);
+    streamer->start(std::move(headers));
+}
+
+void HttpServer::runExport(const std::shared_ptr<ExportPipe> &pipe, ProductImportReader::Format format)
 {
+    auto cancelled = [this]() { return m_stopping.load(); };
+    QByteArray chunk;
+    chunk.reserve(kExportChunkBytes * 2);
+    if (format == ProductImportReader::Format::Csv) {
+        chunk = "product_id,product_name,product_price,product_description,product_image_path,product_stock,category_ids\r\n";
+    }
+    qint64 rows = 0;
+    bool ok = m_dbHandler->exportProducts([&](const CatalogProduct &product, const QList<int> &categoryIds) {
+        chunk += exportRow(product, categoryIds, format);
+        ++rows;
+        if (chunk.size() < kExportChunkBytes) {
+            return true;
+        }
+        // Пока клиент не забрал предыдущие блоки, чтение курсора стоит
+        const bool sent = pipe->write(chunk, cancelled);
+        chunk.resize(0);
+        return sent;
+    });
+    if (ok && !chunk.isEmpty()) {
+        ok = pipe->write(chunk, cancelled);
+    }
+    pipe->finish(ok);
+
+    m_exportedRows += rows;
+    if (!ok) {
+        ++m_exportsFailed;
+        qWarning() << "HttpServer: Catalog export aborted after" << rows << "row(s)";
+    }
+}
+
+void HttpServer::handleServeStaticFile(const QString &fileName, const QHttpServerRequest &request, QHttpServerResponder &responder)
+{
+    HttpReactor::countRequestInCurrent();
+
     if (fileName.contains("..")) {
-        return QHttpServerResponse(QHttpServerResponse::StatusCode::Forbidden);
+        responder.sendResponse(QHttpServerResponse(QHttpServerResponse::StatusCode::Forbidden));
+        return;
     }
 
-    QString filePath = "images/" + fileName;
+    const QHttpHeaders requestHeaders = request.headers();
 
-    QFile file(filePath);
-    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+    // ?w=<ширина> выбирает уменьшенный вариант. Пока он строится, отдается оригинал,
+    // но без immutable, чтобы клиент не закэшировал его навсегда под адресом варианта.
+    QString relativePath = fileName;
+    bool immutable = true;
+    const int requestedWidth = request.query().queryItemValue("w").toInt();
+    if (requestedWidth > 0) {
+        const QString variant = m_imageVariants.variantFor(fileName, requestedWidth);
+        if (variant.isEmpty()) {
+            immutable = false;
+        } else {
+            relativePath = variant;
+        }
+    }
+
+    std::optional<CachedImage> image = m_imageCache.find(relativePath);
+    if (image) {
+        sendImageFromMemory(*image, requestHeaders, immutable, responder);
+        return;
+    }
+
+    QString filePath = "images/" + relativePath;
+    const QFileInfo fileInfo(filePath);
+    if (!fileInfo.isFile()) {
         qWarning() << "HttpServer: Static file not found at" << QDir::current().absoluteFilePath(filePath);
-        return QHttpServerResponse(QHttpServerResponse::StatusCode::NotFound);
+        responder.sendResponse(QHttpServerResponse(QHttpServerResponse::StatusCode::NotFound));
+        return;
     }
 
-    QByteArray fileData = file.readAll();
-    file.close();
+    const qint64 fileSize = fileInfo.size();
+    const QByteArray mimeType = ImageCache::mimeTypeFor(relativePath);
+    const QByteArray etag = ImageCache::makeEtag(relativePath, fileSize, fileInfo.lastModified().toMSecsSinceEpoch());
+
+    // Небольшие файлы читаются целиком и попадают в кэш
+    if (fileSize <= qMin(kStreamingThresholdBytes, m_imageCache.maxEntryBytes())) {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "HttpServer: Could not open static file" << filePath << file.errorString();
+            responder.sendResponse(QHttpServerResponse(QHttpServerResponse::StatusCode::NotFound));
+            return;
+        }
+        const CachedImage loaded{file.readAll(), mimeType, etag};
+        m_imageCache.insert(relativePath, loaded);
+        sendImageFromMemory(loaded, requestHeaders, immutable, responder);
+        return;
+    }
+
+    // Большие файлы отдаются частями из отображения файла в память, без копии в куче
+    QHttpHeaders headers = imageHeaders(mimeType, etag, immutable);
+    if (etagMatches(requestHeaders, etag)) {
+        responder.write(headers, QHttpServerResponder::StatusCode::NotModified);
+        return;
+    }
+
+    ByteRange range;
+    const RangeResult rangeResult = parseRange(requestHeaders, etag, fileSize, &range);
+    if (rangeResult == RangeResult::Unsatisfiable) {
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentRange, "bytes */" + QByteArray::number(fileSize));
+        responder.write(headers, QHttpServerResponder::StatusCode::RequestRangeNotSatisfiable);
+        return;
+    }
+
+    const bool partial = rangeResult == RangeResult::Partial;
+    if (!partial) {
+        range = ByteRange{0, fileSize};
+    }
+
+    auto *device = new MappedFileDevice(filePath, range.start, range.length);
+    if (!device->open(QIODevice::ReadOnly)) {
+        qWarning() << "HttpServer: Could not map static file" << filePath << device->errorString();
+        delete device;
+        responder.sendResponse(QHttpServerResponse(QHttpServerResponse::StatusCode::InternalServerError));
+        return;
+    }
+
+    if (partial) {
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentRange, contentRange(range, fileSize));
+    }
+    // responder забирает устройство и удаляет его после отправки; Content-Length выставляется по size()
+    responder.write(device, headers, partial ? QHttpServerResponder::StatusCode::PartialContent
+                                             : QHttpServerResponder::StatusCode::Ok);
+}
 
-    QMimeDatabase mimeDb;
-    QMimeType mimeType = mimeDb.mimeTypeForFile(filePath);
-    qDebug() << "HttpServer: Serving file" << filePath << "with MIME type" << mimeType.name();
+void HttpServer::sendImageFromMemory(const CachedImage &image, const QHttpHeaders &requestHeaders,
+                                     bool immutable, QHttpServerResponder &responder)
+{
+    QHttpHeaders headers = imageHeaders(image.mimeType, image.etag, immutable);
+    if (etagMatches(requestHeaders, image.etag)) {
+        responder.write(headers, QHttpServerResponder::StatusCode::NotModified);
+        return;
+    }
+
+    const qint64 size = image.data.size();
+    ByteRange range;
+    switch (parseRange(requestHeaders, image.etag, size, &range)) {
+    case RangeResult::Full:
+        responder.write(image.data, headers, QHttpServerResponder::StatusCode::Ok);
+        break;
+    case RangeResult::Partial:
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentRange, contentRange(range, size));
+        responder.write(image.data.sliced(range.start, range.length), headers,
+                        QHttpServerResponder::StatusCode::PartialContent);
+        break;
+    case RangeResult::Unsatisfiable:
+        headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ContentRange, "bytes */" + QByteArray::number(size));
+        responder.write(headers, QHttpServerResponder::StatusCode::RequestRangeNotSatisfiable);
+        break;
+    }
+}
+
+QHttpHeaders HttpServer::imageHeaders(const QByteArray &mimeType, const QByteArray &etag, bool immutable)
+{
+    QHttpHeaders headers;
+    headers.append(QHttpHeaders::WellKnownHeader::ContentType, mimeType);
+    headers.append(QHttpHeaders::WellKnownHeader::ETag, etag);
+    // Имена загруженных файлов уникальны и не переиспользуются, поэтому ответ можно кэшировать навсегда
+    headers.append(QHttpHeaders::WellKnownHeader::CacheControl,
+                   immutable ? "public, max-age=31536000, immutable" : "public, max-age=60");
+    headers.append(QHttpHeaders::WellKnownHeader::AcceptRanges, "bytes");
+    return headers;
+}
+
+QHttpServerResponse HttpServer::handleRotateSigningKey()
+{
+    // Уже выданные токены остаются действительными: предыдущие ключи еще проверяют подписи
+    QJsonObject response;
+    response["kid"] = QString::fromLatin1(m_tokens.rotate());
+    qInfo() << "HttpServer: Signing key rotated, new kid" << response["kid"].toString();
+    return QHttpServerResponse(response, QHttpServerResponse::StatusCode::Ok);
+}
+
+QHttpServerResponse HttpServer::handleGetMetrics()
+{
+    QJsonArray reactors;
+    for (const HttpReactor *reactor : std::as_const(m_reactors)) {
+        reactors.append(reactor->stats());
+    }
+
+    QJsonObject workers;
+    workers["max_threads"] = m_workerPool.maxThreadCount();
+    workers["active_threads"] = m_workerPool.activeThreadCount();
 
-    // ============ КОРРЕКТНЫЙ КОД ============
-    // 1. Создаем ответ, используя конструктор с телом и статус-кодом.
-    QHttpServerResponse response(fileData, QHttpServerResponse::StatusCode::Ok);
+    QJsonObject metrics;
+    metrics["reactors"] = reactors;
+    metrics["workers"] = workers;
+    metrics["db_pool"] = m_dbHandler->poolStats();
+    metrics["id_index"] = m_dbHandler->idIndexStats();
+    metrics["stock"] = m_dbHandler->stockStats();
+    QJsonObject productPurge = m_dbHandler->purgeStats();
+    productPurge["deferred_busy"] = qint64(m_productPurgeDeferred.load());
+    metrics["product_purge"] = productPurge;
+    QJsonObject jobs = m_jobs.stats();
+    jobs["active_threads"] = m_jobPool.activeThreadCount();
+    metrics["jobs"] = jobs;
+    metrics["search"] = m_dbHandler->searchStats();
+    metrics["suggest"] = m_dbHandler->suggestStats();
+    const CatalogCache::SnapshotPtr catalog = m_dbHandler->catalogSnapshot();
+    metrics["category_bitmaps"] = catalog->bitmapStats();
+    metrics["catalog_version"] = qint64(catalog->version);
+    metrics["catalog_structure_version"] = qint64(catalog->structureVersion);
+    metrics["image_cache"] = m_imageCache.stats();
+    metrics["uploads"] = m_uploadStore.stats();
+    QJsonObject imports = m_importUploads.stats();
+    imports["started"] = qint64(m_importsStarted.load());
+    metrics["imports"] = imports;
+    QJsonObject exports;
+    exports["active"] = m_exportPool.activeThreadCount();
+    exports["started"] = qint64(m_exportsStarted.load());
+    exports["failed"] = qint64(m_exportsFailed.load());
+    exports["rejected_busy"] = qint64(m_exportsRejected.load());
+    exports["rows"] = qint64(m_exportedRows.load());
+    metrics["exports"] = exports;
+    metrics["image_variants"] = m_imageVariants.stats();
+    metrics["image_store"] = m_imageStore.stats();
+
+    QJsonObject login;
+    login["max_concurrent_checks"] = m_loginPool.maxThreadCount();
+    login["active_checks"] = m_loginPool.activeThreadCount();
+    login["queue_depth"] = m_loginQueueDepth.load();
+    login["rejected"] = qint64(m_loginRejected.load());
+    metrics["login"] = login;
+    metrics["sessions"] = m_sessions.stats();
+    metrics["access_tokens"] = m_tokens.stats();
+    return QHttpServerResponse(metrics, QHttpServerResponse::StatusCode::Ok);
+}
 
-    // 2. Получаем объект QHttpHeaders и используем метод setValue() для установки заголовка.
-    response.headers().append(QHttpHeaders::WellKnownHeader::ContentType, mimeType.name().toUtf8());
-    // ==========================================
+bool HttpServer::etagMatches(const QHttpHeaders &requestHeaders, const QByteArray &etag)
+{
+    // If-None-Match может содержать список ETag или "*"; сравнение слабое (RFC 9110)
+    const QByteArrayView ifNoneMatch = requestHeaders.value(QHttpHeaders::WellKnownHeader::IfNoneMatch);
+    if (ifNoneMatch.isEmpty()) {
+        return false;
+    }
+    const QList<QByteArray> candidates = ifNoneMatch.toByteArray().split(',');
+    for (QByteArray candidate : candidates) {
+        candidate = candidate.trimmed();
+        if (candidate.startsWith("W/")) {
+            candidate = candidate.mid(2);
+        }
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QHttpServerResponse HttpServer::cachedJsonResponse(const RequestData &request, const CachedResponse &cached)
+{
+    QHttpServerResponse response = etagMatches(request.headers(), cached.etag)
+        ? QHttpServerResponse(QHttpServerResponse::StatusCode::NotModified)
+        : QHttpServerResponse("application/json", cached.body, QHttpServerResponse::StatusCode::Ok);
 
+    QHttpHeaders headers = response.headers();
+    headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::ETag, cached.etag);
+    headers.replaceOrAppend(QHttpHeaders::WellKnownHeader::CacheControl, "no-cache");
+    response.setHeaders(std::move(headers));
     return response;
 }
@@ -9,8 +9,52 @@
 #include <QUuid>
 #include <QMimeDatabase>
 #include <QMap>
+#include <QUrlQuery>
+#include <QHttpHeaders>
+#include <QThreadPool>
+#include <QTimer>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
+#include <atomic>
+#include <optional>
 
 #include "databasehandler.h"
+#include "httpreactor.h"
+#include "responsecache.h"
+#include "imagecache.h"
+#include "mappedfiledevice.h"
+#include "uploadstore.h"
+#include "imagevariants.h"
+#include "imagestore.h"
+#include "sessionstore.h"
+#include "tokensigner.h"
+#include "jobregistry.h"
+#include "exportpipe.h"
+#include "exportstreamer.h"
+
+// Копия нужных обработчику частей запроса. QHttpServerRequest принадлежит потоку сервера,
+// а обработчики выполняются в пуле рабочих потоков, поэтому туда передается копия.
+class RequestData
+{
+public:
+    explicit RequestData(const QHttpServerRequest &request)
+        : m_method(request.method()),
+        m_body(request.body()),
+        m_query(request.query()),
+        m_headers(request.headers())
+    {}
+
+    QHttpServerRequest::Method method() const { return m_method; }
+    const QByteArray &body() const { return m_body; }
+    const QUrlQuery &query() const { return m_query; }
+    const QHttpHeaders &headers() const { return m_headers; }
+
+private:
+    QHttpServerRequest::Method m_method;
+    QByteArray m_body;
+    QUrlQuery m_query;
+    QHttpHeaders m_headers;
+};
 
 class HttpServer : public QObject
 {
@@ -18,35 +62,166 @@ class HttpServer : public QObject
 public:
     explicit HttpServer(DatabaseHandler* dbHandler, QObject *parent = nullptr);
     ~HttpServer() override;
-    bool startServer(quint16 port);
+    // reactorCount > 1 запускает несколько потоков-реакторов на одном порту (SO_REUSEPORT)
+    bool startServer(quint16 port, int reactorCount = 1);
+
+    // Максимальное число одновременно выполняемых обработчиков (и соединений с БД)
+    void setWorkerThreadCount(int count);
+    // Объем кэша изображений в памяти
+    void setImageCacheBytes(qint64 bytes);
+    // Максимальный размер загружаемого изображения
+    void setMaxUploadBytes(qint64 bytes);
+    // Максимальный размер файла импорта каталога
+    void setMaxImportBytes(qint64 bytes);
+    // Сколько проверок пароля (bcrypt в процессе сервера) выполняется одновременно;
+    // отдельно от основного пула
+    void setLoginConcurrency(int count);
+    void setSessionIdleTimeoutMs(qint64 timeoutMs);
+    void setAccessTokenTtlSeconds(qint64 ttlSeconds);
 
 private:
-    void setupRoutes();
+    void setupRoutes(QHttpServer &httpServer);
+    void stopReactors();
+    // Одна пачка сборки мусора в images/: удаляет файлы, на которые не ссылается каталог
+    void sweepOrphanImages();
+    // Публикация остатков после заказов в снимок каталога в фоновом потоке
+    void publishStock();
+    // Пачка физического удаления помеченных товаров, только пока сервер не загружен
+    void purgeInactiveProducts();
+    // Тело фоновой задачи DELETE /categories/<id>
+    void runDeleteCategoryJob(const QString &jobId, int categoryId);
+    // Тело фоновой задачи POST /imports; файл удаляется по завершении
+    void runImportJob(const QString &jobId, const QString &filePath, ProductImportReader::Format format);
+    // Читает каталог из курсора БД и передает его в pipe, пока его отправляет ExportStreamer
+    void runExport(const std::shared_ptr<ExportPipe> &pipe, ProductImportReader::Format format);
+
+    // Запускает обработчик в пуле рабочих потоков, не блокируя цикл событий сервера
+    template <typename Functor>
+    QFuture<QHttpServerResponse> runInPool(Functor &&functor)
+    {
+        HttpReactor::countRequestInCurrent();
+        return QtConcurrent::run(&m_workerPool, std::forward<Functor>(functor));
+    }
+
+    // То же, что runInPool, но обработчик выполняется только для токена доступа администратора
+    template <typename Functor>
+    QFuture<QHttpServerResponse> runAsAdmin(const QHttpServerRequest &request, Functor &&functor)
+    {
+        QByteArray authorization = request.headers().value(QHttpHeaders::WellKnownHeader::Authorization).toByteArray();
+        return runInPool([this, authorization = std::move(authorization),
+                          functor = std::forward<Functor>(functor)]() -> QHttpServerResponse {
+            if (std::optional<QHttpServerResponse> denied = checkAdminAccess(authorization)) {
+                return std::move(*denied);
+            }
+            return functor();
+        });
+    }
+
+    // Вход выполняется в отдельном ограниченном пуле; при переполнении очереди сразу 503
+    QFuture<QHttpServerResponse> submitLogin(const QHttpServerRequest &request);
 
     // === Общие обработчики ===
-    QHttpServerResponse handleLogin(const QHttpServerRequest &request);
-    QHttpServerResponse handleGetCategories(const QHttpServerRequest &request);
-    QHttpServerResponse handleGetProducts(const QHttpServerRequest &request);
-    QHttpServerResponse handleServeStaticFile(const QString &fileName);
+    QHttpServerResponse handleLogin(const RequestData &request);
+    QHttpServerResponse handleLogout(const RequestData &request);
+    // Новый токен доступа по токену сессии, без пароля и без БД
+    QHttpServerResponse handleRefreshToken(const RequestData &request);
+    QHttpServerResponse handleGetCategories(const RequestData &request);
+    QHttpServerResponse handleGetProducts(const RequestData &request);
+    // Страница товаров категории: limit, непрозрачный cursor, sort=id|price|name;
+    // при sort=price еще min_price, max_price и in_stock
+    QHttpServerResponse handleGetProductsPage(const RequestData &request, int categoryId);
+    // Товары, входящие во все (match=all) или в любую (match=any) из category_ids, с числом
+    // товаров выборки по категориям (facets); страницы по product_id
+    QHttpServerResponse handleFilterProducts(const RequestData &request);
+    // Полнотекстовый поиск: q, limit и непрозрачный cursor; ответ {items, next_cursor}
+    QHttpServerResponse handleSearch(const RequestData &request);
+    // Подсказки названий при наборе: q и limit; ответ - массив {product_id, product_name}
+    QHttpServerResponse handleSuggest(const RequestData &request);
+    // Отвечает сам через responder в потоке реактора: большие файлы отдаются потоком из mmap
+    void handleServeStaticFile(const QString &fileName, const QHttpServerRequest &request, QHttpServerResponder &responder);
+    QHttpServerResponse handleGetMetrics();
+    // Выгрузка каталога отвечает сама: тело передается частями по мере чтения курсора
+    void handleExportProducts(const QHttpServerRequest &request, QHttpServerResponder &responder);
+
+    // Изображение из кэша отдается из памяти целиком или запрошенным диапазоном
+    static void sendImageFromMemory(const CachedImage &image, const QHttpHeaders &requestHeaders,
+                                    bool immutable, QHttpServerResponder &responder);
+    // immutable = false для временной подмены еще не готового варианта оригиналом
+    static QHttpHeaders imageHeaders(const QByteArray &mimeType, const QByteArray &etag, bool immutable);
+
+    // Токен из значения заголовка "Authorization: Bearer <token>"
+    static QByteArrayView bearerToken(QByteArrayView authorization);
+    // Пустой результат - доступ разрешен; иначе готовый ответ 401/403.
+    // Проверяется подпись токена доступа, к БД и таблице сессий обращения нет.
+    std::optional<QHttpServerResponse> checkUserAccess(const RequestData &request, int userId);
+    std::optional<QHttpServerResponse> checkAdminAccess(QByteArrayView authorization);
+
+    static bool etagMatches(const QHttpHeaders &requestHeaders, const QByteArray &etag);
+    // Отдает закэшированное тело или 304, если клиент прислал совпадающий If-None-Match
+    static QHttpServerResponse cachedJsonResponse(const RequestData &request, const CachedResponse &cached);
 
     // === Обработчики корзины ===
-    QHttpServerResponse handlePostCart(const QHttpServerRequest &request);
-    QHttpServerResponse handlePostOrder(const QHttpServerRequest &request);
-    QHttpServerResponse handleGetCart(const QHttpServerRequest &request);
-    QHttpServerResponse handleRemoveFromCart(const QHttpServerRequest &request);
+    QHttpServerResponse handlePostCart(const RequestData &request);
+    QHttpServerResponse handlePostOrder(const RequestData &request);
+    QHttpServerResponse handleGetCart(const RequestData &request);
+    QHttpServerResponse handleRemoveFromCart(const RequestData &request);
 
     // === Обработчики админ панели ===
-    QHttpServerResponse handlePostCategory(const QHttpServerRequest &request);
+    QHttpServerResponse handlePostCategory(const RequestData &request);
     QHttpServerResponse handleDeleteCategory(int categoryId);
-    QHttpServerResponse handlePostProducts(const QHttpServerRequest &request);
+    QHttpServerResponse handlePostProducts(const RequestData &request);
     QHttpServerResponse handleDeleteProduct(int productId);
-    QHttpServerResponse handleUpdateProduct(int productId, const QHttpServerRequest &request);;
-    QHttpServerResponse handleImageUpload(const QHttpServerRequest &request);
-    QHttpServerResponse handleChangeProductCategory(int productId, const QHttpServerRequest &request);
+    QHttpServerResponse handleUpdateProduct(int productId, const RequestData &request);
+    QHttpServerResponse handleImageUpload(const RequestData &request);
+    QHttpServerResponse handleChangeProductCategory(int productId, const RequestData &request);
+    QHttpServerResponse handleRotateSigningKey();
+    QHttpServerResponse handleGetJob(const QString &jobId);
+    QHttpServerResponse handlePostImport(const RequestData &request);
+
+    // === Возобновляемая загрузка частями (изображения и файлы импорта) ===
+    QHttpServerResponse handleCreateUpload(UploadStore &store, const RequestData &request);
+    QHttpServerResponse handleGetUpload(UploadStore &store, const QString &uploadId);
+    QHttpServerResponse handleUploadChunk(UploadStore &store, const QString &uploadId, const RequestData &request);
+    QHttpServerResponse handleFinalizeImageUpload(const QString &uploadId);
+    QHttpServerResponse handleCancelUpload(UploadStore &store, const QString &uploadId);
+    // Проверяет формат по сигнатуре и переносит файл в images/ под новым именем
+    QHttpServerResponse storeUploadedImage(const QString &tempFilePath);
 
-    QHttpServer m_httpServer;
-    QTcpServer  m_tcpServer;
+    QList<HttpReactor*> m_reactors;
+    QList<QThread*> m_reactorThreads;
     DatabaseHandler* m_dbHandler;
+    QThreadPool m_workerPool;
+    ResponseCache m_responseCache;
+    ImageCache m_imageCache;
+    UploadStore m_uploadStore;
+    // Файлы импорта каталога загружаются так же частями, но с отдельным лимитом размера
+    UploadStore m_importUploads{"uploads/imports"};
+    std::atomic<quint64> m_importsStarted{0};
+    // Каждая выгрузка держит соединение с БД до конца, поэтому их число ограничено потоками пула
+    QThreadPool m_exportPool;
+    std::atomic<quint64> m_exportsStarted{0};
+    std::atomic<quint64> m_exportsFailed{0};
+    std::atomic<quint64> m_exportsRejected{0};
+    std::atomic<quint64> m_exportedRows{0};
+    ImageVariants m_imageVariants;
+    ImageStore m_imageStore;
+    QTimer m_imageSweepTimer;
+    QFuture<void> m_imageSweep;
+    QTimer m_stockPublishTimer;
+    QFuture<void> m_stockPublish;
+    QTimer m_productPurgeTimer;
+    QFuture<void> m_productPurge;
+    std::atomic<quint64> m_productPurgeDeferred{0};
+    // Длительные задачи администратора идут в своем пуле и не занимают потоки запросов
+    QThreadPool m_jobPool;
+    JobRegistry m_jobs;
+    std::atomic<bool> m_stopping{false};
+    QTimer m_housekeepingTimer;
+    QThreadPool m_loginPool; // потоки проверки паролей, по числу ядер
+    std::atomic<int> m_loginQueueDepth{0};
+    std::atomic<quint64> m_loginRejected{0};
+    SessionStore m_sessions;
+    TokenSigner m_tokens;
 };
 
 #endif // HTTPSERVER_H
@@ -0,0 +1,78 @@
+#include "idbitmap.h"
+
+IdBitmap::~IdBitmap()
+{
+    for (std::atomic<Page *> &page : m_pages) {
+        delete page.load(std::memory_order_relaxed);
+    }
+}
+
+bool IdBitmap::contains(qint64 id) const
+{
+    if (id < 0 || id >= kBitsPerPage * kMaxPages) {
+        return false;
+    }
+    const Page *page = m_pages[id / kBitsPerPage].load(std::memory_order_acquire);
+    if (!page) {
+        return false;
+    }
+    const qint64 bit = id % kBitsPerPage;
+    const quint64 word = page->words[bit / kBitsPerWord].load(std::memory_order_acquire);
+    return word & (quint64(1) << (bit % kBitsPerWord));
+}
+
+void IdBitmap::insert(qint64 id)
+{
+    Page *page = pageFor(id, true);
+    if (!page) {
+        return;
+    }
+    const qint64 bit = id % kBitsPerPage;
+    const quint64 mask = quint64(1) << (bit % kBitsPerWord);
+    const quint64 previous = page->words[bit / kBitsPerWord].fetch_or(mask, std::memory_order_acq_rel);
+    if (!(previous & mask)) {
+        ++m_count;
+    }
+}
+
+void IdBitmap::remove(qint64 id)
+{
+    Page *page = pageFor(id, false);
+    if (!page) {
+        return;
+    }
+    const qint64 bit = id % kBitsPerPage;
+    const quint64 mask = quint64(1) << (bit % kBitsPerWord);
+    const quint64 previous = page->words[bit / kBitsPerWord].fetch_and(~mask, std::memory_order_acq_rel);
+    if (previous & mask) {
+        --m_count;
+    }
+}
+
+IdBitmap::Page *IdBitmap::pageFor(qint64 id, bool create)
+{
+    if (id < 0 || id >= kBitsPerPage * kMaxPages) {
+        return nullptr;
+    }
+    std::atomic<Page *> &slot = m_pages[id / kBitsPerPage];
+    Page *page = slot.load(std::memory_order_acquire);
+    if (page || !create) {
+        return page;
+    }
+    // Два писателя могут выделить страницу одновременно: побеждает первый, второй удаляет свою
+    auto fresh = std::make_unique<Page>();
+    if (slot.compare_exchange_strong(page, fresh.get(), std::memory_order_acq_rel)) {
+        ++m_pageCount;
+        return fresh.release();
+    }
+    return page;
+}
+
+QJsonObject IdBitmap::stats() const
+{
+    QJsonObject result;
+    result["count"] = m_count.load();
+    result["pages"] = m_pageCount.load();
+    result["bytes"] = qint64(m_pageCount.load()) * qint64(sizeof(Page));
+    return result;
+}
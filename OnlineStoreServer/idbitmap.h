@@ -0,0 +1,44 @@
+#ifndef IDBITMAP_H
+#define IDBITMAP_H
+
+#include <QtGlobal>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+#include <memory>
+
+// Множество целых id (SERIAL) в виде плотной битовой карты.
+// Страницы по 64K бит выделяются по мере надобности и не освобождаются, поэтому
+// проверка принадлежности - два атомарных чтения без блокировок, а запись - атомарный OR/AND.
+class IdBitmap
+{
+public:
+    IdBitmap() = default;
+    ~IdBitmap();
+    Q_DISABLE_COPY_MOVE(IdBitmap)
+
+    bool contains(qint64 id) const;
+    void insert(qint64 id);
+    void remove(qint64 id);
+
+    QJsonObject stats() const;
+
+private:
+    static constexpr int kBitsPerWord = 64;
+    static constexpr int kWordsPerPage = 1024;                       // 8 КиБ на страницу
+    static constexpr qint64 kBitsPerPage = qint64(kBitsPerWord) * kWordsPerPage;
+    static constexpr int kMaxPages = 32768;                          // покрывает весь диапазон SERIAL
+
+    struct Page
+    {
+        std::array<std::atomic<quint64>, kWordsPerPage> words{};
+    };
+
+    Page *pageFor(qint64 id, bool create);
+
+    std::array<std::atomic<Page *>, kMaxPages> m_pages{};
+    std::atomic<qint64> m_count{0};
+    std::atomic<int> m_pageCount{0};
+};
+
+#endif // IDBITMAP_H
@@ -0,0 +1,70 @@
+#include "imagecache.h"
+#include <QMimeDatabase>
+#include <QCryptographicHash>
+
+ImageCache::ImageCache(qint64 maxBytes)
+    : m_cache(maxBytes)
+{
+}
+
+void ImageCache::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(maxBytes);
+}
+
+qint64 ImageCache::maxEntryBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost() / 8;
+}
+
+std::optional<CachedImage> ImageCache::find(const QString &fileName)
+{
+    QMutexLocker locker(&m_mutex);
+    // QCache::object() переносит запись в начало списка LRU
+    if (const CachedImage *image = m_cache.object(fileName)) {
+        ++m_hits;
+        return *image; // Копия разделяет буфер с записью кэша
+    }
+    ++m_misses;
+    return std::nullopt;
+}
+
+void ImageCache::insert(const QString &fileName, const CachedImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    const qsizetype countBefore = m_cache.count() + (m_cache.contains(fileName) ? 0 : 1);
+    if (m_cache.insert(fileName, new CachedImage(image), image.data.size())) {
+        m_evictions += countBefore - m_cache.count();
+    }
+}
+
+QByteArray ImageCache::mimeTypeFor(const QString &fileName)
+{
+    // Только по расширению: содержимое читать не нужно, а QMimeDatabase потокобезопасен
+    static const QMimeDatabase mimeDb;
+    return mimeDb.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name().toUtf8();
+}
+
+QByteArray ImageCache::makeEtag(const QString &fileName, qint64 size, qint64 modifiedMs)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(fileName.toUtf8());
+    hash.addData(QByteArray::number(size));
+    hash.addData(QByteArray::number(modifiedMs));
+    return '"' + hash.result().toHex().left(24) + '"';
+}
+
+QJsonObject ImageCache::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject result;
+    result["hits"] = qint64(m_hits);
+    result["misses"] = qint64(m_misses);
+    result["evictions"] = qint64(m_evictions);
+    result["entries"] = qint64(m_cache.count());
+    result["bytes"] = qint64(m_cache.totalCost());
+    result["max_bytes"] = qint64(m_cache.maxCost());
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QCache>
+#include <QMutex>
+#include <QJsonObject>
+#include <optional>
+
+// Файл изображения, подготовленный к отдаче: содержимое, MIME-тип и ETag считаются один раз
+struct CachedImage
+{
+    QByteArray data;
+    QByteArray mimeType;
+    QByteArray etag;
+};
+
+// LRU-кэш содержимого изображений с ограничением по суммарному объему в байтах.
+// Имена загруженных файлов (UUID) не переиспользуются, поэтому записи не устаревают.
+class ImageCache
+{
+public:
+    explicit ImageCache(qint64 maxBytes = 64 * 1024 * 1024);
+
+    void setMaxBytes(qint64 maxBytes);
+    // Файлы больше этого размера не кэшируются, чтобы не вытеснять весь кэш одной картинкой
+    qint64 maxEntryBytes() const;
+
+    std::optional<CachedImage> find(const QString &fileName);
+    void insert(const QString &fileName, const CachedImage &image);
+
+    static QByteArray mimeTypeFor(const QString &fileName);
+    static QByteArray makeEtag(const QString &fileName, qint64 size, qint64 modifiedMs);
+
+    QJsonObject stats() const;
+
+private:
+    mutable QMutex m_mutex;
+    QCache<QString, CachedImage> m_cache; // стоимость записи - размер в байтах
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+    quint64 m_evictions = 0;
+};
+
+#endif // IMAGECACHE_H
@@ -0,0 +1,117 @@
+#include "imagestore.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QDebug>
+
+ImageStore::ImageStore(const QString &directory)
+    : m_directory(directory)
+{
+    // Создаем директорию, если ее нет. Директория будет создана там, где запущен сервер.
+    QDir dir(m_directory);
+    if (!dir.exists()) {
+        dir.mkpath(".");
+    }
+}
+
+QString ImageStore::store(const QString &tempFilePath, const QString &extension)
+{
+    QFile tempFile(tempFilePath);
+    if (!tempFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "ImageStore: Could not open" << tempFilePath << tempFile.errorString();
+        QFile::remove(tempFilePath);
+        return QString();
+    }
+    // Хэш считается потоково, файл целиком в память не читается
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&tempFile);
+    tempFile.close();
+
+    const QString fileName = QString::fromLatin1(hash.result().toHex()) + "." + extension;
+    const QString targetPath = m_directory + "/" + fileName;
+
+    bool duplicate = QFileInfo::exists(targetPath);
+    if (!duplicate && !QFile::rename(tempFilePath, targetPath)) {
+        // Ту же картинку могли параллельно сохранить из другого запроса
+        duplicate = QFileInfo::exists(targetPath);
+        if (!duplicate) {
+            qWarning() << "ImageStore: Could not move" << tempFilePath << "to" << targetPath;
+            QFile::remove(tempFilePath);
+            return QString();
+        }
+    }
+    if (duplicate) {
+        QFile::remove(tempFilePath);
+    }
+
+    QMutexLocker locker(&m_mutex);
+    QElapsedTimer timer;
+    timer.start();
+    m_recentlyStored.insert(fileName, timer);
+    if (duplicate) {
+        ++m_deduplicated;
+    } else {
+        ++m_stored;
+    }
+    return fileName;
+}
+
+QStringList ImageStore::sweep(const QHash<QString, int> &references, int maxDeletes)
+{
+    QHash<QString, QElapsedTimer> recentlyStored;
+    qint64 gracePeriodMs;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_recentlyStored.begin(); it != m_recentlyStored.end();) {
+            if (it->hasExpired(m_gracePeriodMs)) {
+                it = m_recentlyStored.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        recentlyStored = m_recentlyStored;
+        gracePeriodMs = m_gracePeriodMs;
+    }
+
+    const QDateTime cutoff = QDateTime::currentDateTimeUtc().addMSecs(-gracePeriodMs);
+    const QFileInfoList files = QDir(m_directory).entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+
+    QStringList deleted;
+    qint64 orphans = 0;
+    qint64 bytesReclaimed = 0;
+    for (const QFileInfo &file : files) {
+        const QString fileName = file.fileName();
+        if (references.value(fileName) > 0 || recentlyStored.contains(fileName)
+            || file.lastModified().toUTC() > cutoff) {
+            continue;
+        }
+        ++orphans;
+        if (deleted.size() >= maxDeletes) {
+            continue; // Остальное удалим в следующих пачках
+        }
+        if (QFile::remove(file.filePath())) {
+            deleted.append(fileName);
+            bytesReclaimed += file.size();
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_deleted += deleted.size();
+    m_bytesReclaimed += bytesReclaimed;
+    m_lastSweepOrphans = orphans;
+    return deleted;
+}
+
+QJsonObject ImageStore::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject result;
+    result["stored"] = qint64(m_stored);
+    result["deduplicated"] = qint64(m_deduplicated);
+    result["deleted"] = qint64(m_deleted);
+    result["bytes_reclaimed"] = qint64(m_bytesReclaimed);
+    result["orphans_at_last_sweep"] = m_lastSweepOrphans;
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef IMAGESTORE_H
+#define IMAGESTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// Хранилище оригиналов изображений, адресуемое содержимым: файл называется
+// <sha256>.<расширение>, поэтому повторная загрузка той же картинки дает тот же файл.
+// Файлы, на которые не ссылается ни один товар, удаляются сборщиком мусора.
+class ImageStore
+{
+public:
+    explicit ImageStore(const QString &directory = "images");
+
+    // Переносит временный файл в хранилище; возвращает имя файла или пустую строку при ошибке
+    QString store(const QString &tempFilePath, const QString &extension);
+
+    // Удаляет не более maxDeletes файлов без ссылок, старше периода ожидания.
+    // Возвращает имена удаленных файлов.
+    QStringList sweep(const QHash<QString, int> &references, int maxDeletes);
+
+    QJsonObject stats() const;
+
+private:
+    QString m_directory;
+    // Свежая загрузка еще не привязана к товару: до истечения этого срока она не удаляется
+    qint64 m_gracePeriodMs = 60 * 60 * 1000;
+    mutable QMutex m_mutex;
+    QHash<QString, QElapsedTimer> m_recentlyStored;
+    quint64 m_stored = 0;
+    quint64 m_deduplicated = 0;
+    quint64 m_deleted = 0;
+    quint64 m_bytesReclaimed = 0;
+    qint64 m_lastSweepOrphans = 0;
+};
+
+#endif // IMAGESTORE_H
@@ -0,0 +1,173 @@
+#include "imagevariants.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QThread>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QImage>
+#include <QPainter>
+#include <QSaveFile>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+ImageVariants::ImageVariants(const QString &imagesDirectory)
+    : m_imagesDirectory(imagesDirectory),
+    m_format(QImageWriter::supportedImageFormats().contains("webp") ? "webp" : "jpg")
+{
+    // Масштабирование нагружает процессор, поэтому ему отдана небольшая часть ядер
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 4));
+    QDir(m_imagesDirectory).mkpath("variants");
+    qInfo() << "ImageVariants: Variants are encoded as" << m_format;
+}
+
+ImageVariants::~ImageVariants()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+const QList<int> &ImageVariants::widths()
+{
+    static const QList<int> variantWidths = {96, 256, 1024};
+    return variantWidths;
+}
+
+void ImageVariants::schedule(const QString &fileName)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_ready.contains(fileName) || m_pending.contains(fileName) || m_failed.contains(fileName)) {
+            return;
+        }
+        m_pending.insert(fileName);
+    }
+    QtConcurrent::run(&m_pool, [this, fileName]() { generate(fileName); });
+}
+
+QString ImageVariants::variantFor(const QString &fileName, int requestedWidth)
+{
+    const int width = variantWidthFor(requestedWidth);
+    const QString relativePath = variantPath(fileName, width);
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_ready.contains(fileName)) {
+            return relativePath;
+        }
+        if (m_pending.contains(fileName) || m_failed.contains(fileName)) {
+            return QString();
+        }
+    }
+
+    // Варианты, построенные до перезапуска сервера, уже лежат на диске
+    if (QFileInfo::exists(m_imagesDirectory + "/" + relativePath)) {
+        QMutexLocker locker(&m_mutex);
+        m_ready.insert(fileName);
+        return relativePath;
+    }
+    if (QFileInfo::exists(m_imagesDirectory + "/" + fileName)) {
+        schedule(fileName);
+    }
+    return QString();
+}
+
+void ImageVariants::generate(const QString &fileName)
+{
+    const QString sourcePath = m_imagesDirectory + "/" + fileName;
+    QImageReader reader(sourcePath);
+    reader.setAutoTransform(true); // учитываем ориентацию из EXIF
+    QImage original = reader.read();
+
+    if (original.isNull()) {
+        qWarning() << "ImageVariants: Could not decode" << sourcePath << reader.errorString();
+        QMutexLocker locker(&m_mutex);
+        m_pending.remove(fileName);
+        m_failed.insert(fileName);
+        return;
+    }
+
+    // JPEG не хранит прозрачность: подкладываем белый фон, иначе прозрачные области станут черными
+    if (m_format == "jpg" && original.hasAlphaChannel()) {
+        QImage flattened(original.size(), QImage::Format_RGB32);
+        flattened.fill(Qt::white);
+        QPainter painter(&flattened);
+        painter.drawImage(0, 0, original);
+        painter.end();
+        original = flattened;
+    }
+
+    qint64 writtenBytes = 0;
+    bool ok = true;
+    // От большего к меньшему: каждый следующий вариант масштабируется из предыдущего, а не из оригинала
+    QImage source = original;
+    for (auto it = widths().crbegin(); it != widths().crend() && ok; ++it) {
+        const int width = *it;
+        if (source.width() > width || source.height() > width) {
+            source = source.scaled(width, width, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+
+        QSaveFile file(m_imagesDirectory + "/" + variantPath(fileName, width));
+        QImageWriter writer(&file, m_format == "jpg" ? QByteArray("jpeg") : m_format);
+        writer.setQuality(80);
+        writer.setOptimizedWrite(true);
+        writer.setProgressiveScanWrite(true);
+        ok = file.open(QIODevice::WriteOnly) && writer.write(source) && file.commit();
+        if (ok) {
+            writtenBytes += QFileInfo(file.fileName()).size();
+        } else {
+            qWarning() << "ImageVariants: Could not write variant" << width << "of" << fileName << writer.errorString();
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pending.remove(fileName);
+    if (ok) {
+        m_ready.insert(fileName);
+        ++m_generated;
+        m_originalBytes += QFileInfo(sourcePath).size();
+        m_variantBytes += writtenBytes;
+    } else {
+        m_failed.insert(fileName);
+    }
+}
+
+void ImageVariants::remove(const QString &fileName)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_ready.remove(fileName);
+        m_failed.remove(fileName);
+    }
+    for (int width : widths()) {
+        QFile::remove(m_imagesDirectory + "/" + variantPath(fileName, width));
+    }
+}
+
+QString ImageVariants::variantPath(const QString &fileName, int width) const
+{
+    return "variants/" + QFileInfo(fileName).completeBaseName() + "_" + QString::number(width) + "." + m_format;
+}
+
+int ImageVariants::variantWidthFor(int requestedWidth)
+{
+    // Наименьший вариант, не уступающий запрошенной ширине
+    for (int width : widths()) {
+        if (width >= requestedWidth) {
+            return width;
+        }
+    }
+    return widths().constLast();
+}
+
+QJsonObject ImageVariants::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject result;
+    result["format"] = QString::fromLatin1(m_format);
+    result["generated"] = qint64(m_generated);
+    result["pending"] = qint64(m_pending.size());
+    result["failed"] = qint64(m_failed.size());
+    result["original_bytes"] = qint64(m_originalBytes);
+    result["variant_bytes"] = qint64(m_variantBytes);
+    return result;
+}
@@ -0,0 +1,50 @@
+#ifndef IMAGEVARIANTS_H
+#define IMAGEVARIANTS_H
+
+#include <QString>
+#include <QList>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+#include <QJsonObject>
+
+// Уменьшенные копии загруженных изображений фиксированных ширин.
+// Варианты строятся в фоновом пуле и лежат в images/variants/<имя>_<ширина>.<формат>,
+// поэтому клиент скачивает и декодирует картинку размером с карточку, а не оригинал.
+class ImageVariants
+{
+public:
+    explicit ImageVariants(const QString &imagesDirectory = "images");
+    ~ImageVariants();
+
+    static const QList<int> &widths();
+
+    // Ставит в очередь построение всех вариантов; повторные вызовы для того же файла игнорируются
+    void schedule(const QString &fileName);
+    // Путь варианта относительно images/ для запрошенной ширины.
+    // Пустая строка, если вариант еще не готов: тогда его построение ставится в очередь.
+    QString variantFor(const QString &fileName, int requestedWidth);
+
+    // Удаляет варианты оригинала, который убрал сборщик мусора
+    void remove(const QString &fileName);
+
+    QJsonObject stats() const;
+
+private:
+    void generate(const QString &fileName);
+    QString variantPath(const QString &fileName, int width) const;
+    static int variantWidthFor(int requestedWidth);
+
+    QString m_imagesDirectory;
+    QByteArray m_format; // webp, если есть плагин, иначе jpg
+    QThreadPool m_pool;
+    mutable QMutex m_mutex;
+    QSet<QString> m_ready;   // имена оригиналов, для которых все варианты построены
+    QSet<QString> m_pending;
+    QSet<QString> m_failed;  // не декодируются, повторно не пробуем
+    quint64 m_generated = 0;
+    quint64 m_originalBytes = 0;
+    quint64 m_variantBytes = 0;
+};
+
+#endif // IMAGEVARIANTS_H
@@ -0,0 +1,132 @@
+#include "jobregistry.h"
+#include <QUuid>
+
+JobRegistry::JobRegistry()
+{
+}
+
+QString JobRegistry::create(const QString &type, const QString &key, bool *created)
+{
+    QMutexLocker locker(&m_mutex);
+    const QString active = m_activeByKey.value(key);
+    if (!active.isEmpty()) {
+        *created = false;
+        return active;
+    }
+
+    const QString id = QUuid::createUuid().toString(QUuid::Id128);
+    Job job;
+    job.type = type;
+    job.key = key;
+    job.created.start();
+    m_jobs.insert(id, job);
+    m_activeByKey.insert(key, id);
+    *created = true;
+    return id;
+}
+
+void JobRegistry::setRunning(const QString &id)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_jobs.find(id);
+    if (it != m_jobs.end()) {
+        it->state = State::Running;
+    }
+}
+
+void JobRegistry::setProgress(const QString &id, qint64 processed)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_jobs.find(id);
+    if (it != m_jobs.end()) {
+        it->processed = processed;
+    }
+}
+
+void JobRegistry::setDetails(const QString &id, const QJsonObject &details)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_jobs.find(id);
+    if (it != m_jobs.end()) {
+        it->details = details;
+    }
+}
+
+void JobRegistry::finish(const QString &id, const QString &error)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_jobs.find(id);
+    if (it == m_jobs.end()) {
+        return;
+    }
+    it->state = error.isEmpty() ? State::Succeeded : State::Failed;
+    it->error = error;
+    it->finished.start();
+    m_activeByKey.remove(it->key);
+    if (error.isEmpty()) {
+        ++m_succeeded;
+    } else {
+        ++m_failed;
+    }
+}
+
+std::optional<QJsonObject> JobRegistry::statusJson(const QString &id) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_jobs.constFind(id);
+    if (it == m_jobs.constEnd()) {
+        return std::nullopt;
+    }
+    QJsonObject result = it->details;
+    result["job_id"] = id;
+    result["type"] = it->type;
+    result["state"] = stateName(it->state);
+    result["processed"] = it->processed;
+    result["elapsed_ms"] = it->finished.isValid() ? it->created.elapsed() - it->finished.elapsed()
+                                                  : it->created.elapsed();
+    if (!it->error.isEmpty()) {
+        result["error"] = it->error;
+    }
+    return result;
+}
+
+int JobRegistry::removeFinished(qint64 maxAgeMs)
+{
+    QMutexLocker locker(&m_mutex);
+    int removed = 0;
+    for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+        if (it->finished.isValid() && it->finished.hasExpired(maxAgeMs)) {
+            it = m_jobs.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+QJsonObject JobRegistry::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QJsonObject result;
+    result["tracked"] = int(m_jobs.size());
+    result["active"] = int(m_activeByKey.size());
+    result["succeeded"] = qint64(m_succeeded.load());
+    result["failed"] = qint64(m_failed.load());
+    return result;
+}
+
+QString JobRegistry::stateName(State state)
+{
+    switch (state) {
+    case State::Queued:
+        return "queued";
+    case State::Running:
+        return "running";
+    case State::Succeeded:
+        return "succeeded";
+    case State::Failed:
+        return "failed";
+    }
+    return QString();
+}
@@ -0,0 +1,63 @@
+#ifndef JOBREGISTRY_H
+#define JOBREGISTRY_H
+
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <atomic>
+#include <optional>
+
+// Состояние длительных фоновых задач администратора (например, удаления большой категории).
+// Клиент получает id задачи в ответе 202 и опрашивает GET /jobs/<id>.
+class JobRegistry
+{
+public:
+    enum class State {
+        Queued,
+        Running,
+        Succeeded,
+        Failed
+    };
+
+    JobRegistry();
+
+    // Новая задача; если задача с тем же key еще не завершена, возвращается ее id
+    // и *created = false (повторный DELETE не запускает второе удаление)
+    QString create(const QString &type, const QString &key, bool *created);
+    void setRunning(const QString &id);
+    void setProgress(const QString &id, qint64 processed);
+    // Дополнительные поля статуса, специфичные для типа задачи (добавляются в ответ GET /jobs/<id>)
+    void setDetails(const QString &id, const QJsonObject &details);
+    void finish(const QString &id, const QString &error = QString());
+
+    std::optional<QJsonObject> statusJson(const QString &id) const;
+    // Завершенные задачи хранятся, пока клиент может за ними прийти
+    int removeFinished(qint64 maxAgeMs);
+
+    QJsonObject stats() const;
+
+private:
+    struct Job
+    {
+        QString type;
+        QString key;
+        State state = State::Queued;
+        qint64 processed = 0;
+        QJsonObject details;
+        QString error;
+        QElapsedTimer created;
+        QElapsedTimer finished;
+    };
+
+    static QString stateName(State state);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Job> m_jobs;
+    QHash<QString, QString> m_activeByKey; // key -> id незавершенной задачи
+    std::atomic<quint64> m_succeeded{0};
+    std::atomic<quint64> m_failed{0};
+};
+
+#endif // JOBREGISTRY_H
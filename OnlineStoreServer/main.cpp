@@ -1,4 +1,6 @@
 #include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThread>
 #include "databasehandler.h"
 #include "httpserver.h"
 
@@ -6,13 +8,57 @@ int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Online Store HTTP server");
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "HTTP port.", "port", "8080");
+    QCommandLineOption reactorsOption("reactors",
+                                      "Number of listener threads sharing the port via SO_REUSEPORT (1 = single listener).",
+                                      "count", "1");
+    QCommandLineOption workersOption("workers", "Number of request worker threads (each owns a DB connection).",
+                                     "count", QString::number(QThread::idealThreadCount() * 2));
+    QCommandLineOption poolMinOption("db-pool-min", "Connections opened at startup and kept open.", "count", "2");
+    QCommandLineOption poolMaxOption("db-pool-max", "Maximum number of database connections.", "count", "16");
+    QCommandLineOption acquireTimeoutOption("db-acquire-timeout", "How long a request waits for a free connection.", "ms", "5000");
+    QCommandLineOption statementTimeoutOption("db-statement-timeout", "PostgreSQL statement_timeout for request queries.", "ms", "15000");
+    QCommandLineOption imageCacheOption("image-cache-mb", "Memory budget for the image cache.", "MiB", "64");
+    QCommandLineOption loginConcurrencyOption("login-concurrency", "Concurrent bcrypt password checks on login.", "count", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption sessionIdleOption("session-idle-min", "Session expires after this much inactivity.", "minutes", "30");
+    QCommandLineOption accessTtlOption("access-token-ttl-min", "Lifetime of signed access tokens.", "minutes", "15");
+    QCommandLineOption reservationTtlOption("reservation-ttl-min", "How long an item in a cart stays reserved.", "minutes", "15");
+    QCommandLineOption maxUploadOption("max-upload-mb", "Maximum size of an uploaded image.", "MiB", "20");
+    QCommandLineOption maxImportOption("max-import-mb", "Maximum size of a catalog import file.", "MiB", "1024");
+    parser.addOption(portOption);
+    parser.addOption(reactorsOption);
+    parser.addOption(workersOption);
+    parser.addOption(poolMinOption);
+    parser.addOption(poolMaxOption);
+    parser.addOption(acquireTimeoutOption);
+    parser.addOption(statementTimeoutOption);
+    parser.addOption(imageCacheOption);
+    parser.addOption(maxUploadOption);
+    parser.addOption(maxImportOption);
+    parser.addOption(loginConcurrencyOption);
+    parser.addOption(sessionIdleOption);
+    parser.addOption(accessTtlOption);
+    parser.addOption(reservationTtlOption);
+    parser.process(a);
+
     QString dbHost = "localhost";
     int dbPort = 5432;
     QString dbName = "OnlineStore";
     QString dbUser = "postgres";
     QString dbPassword = "demmarc";
 
+    DatabasePool::Settings poolSettings;
+    poolSettings.minSize = parser.value(poolMinOption).toInt();
+    poolSettings.maxSize = qMax(1, parser.value(poolMaxOption).toInt());
+    poolSettings.acquireTimeoutMs = parser.value(acquireTimeoutOption).toInt();
+    poolSettings.statementTimeoutMs = parser.value(statementTimeoutOption).toInt();
+
     DatabaseHandler dbHandler;
+    dbHandler.setPoolSettings(poolSettings);
+    dbHandler.setReservationTtlMs(parser.value(reservationTtlOption).toLongLong() * 60 * 1000);
     if (!dbHandler.connectToDatabase(dbHost, dbPort, dbName, dbUser, dbPassword)) {
         qCritical() << "Failed to connect to the database. Exiting.";
         return -1;
@@ -20,14 +66,23 @@ int main(int argc, char *argv[])
 
     // Создаем и запускаем HTTP сервер
     HttpServer server(&dbHandler);
-    quint16 serverPort = 8080; // Порт для сервера
+    server.setWorkerThreadCount(parser.value(workersOption).toInt());
+    server.setImageCacheBytes(parser.value(imageCacheOption).toLongLong() * 1024 * 1024);
+    server.setLoginConcurrency(parser.value(loginConcurrencyOption).toInt());
+    server.setSessionIdleTimeoutMs(parser.value(sessionIdleOption).toLongLong() * 60 * 1000);
+    server.setAccessTokenTtlSeconds(parser.value(accessTtlOption).toLongLong() * 60);
+    server.setMaxUploadBytes(parser.value(maxUploadOption).toLongLong() * 1024 * 1024);
+    server.setMaxImportBytes(parser.value(maxImportOption).toLongLong() * 1024 * 1024);
+    quint16 serverPort = parser.value(portOption).toUShort(); // Порт для сервера
+    int reactorCount = qMax(1, parser.value(reactorsOption).toInt());
 
-    if (!server.startServer(serverPort)) {
+    if (!server.startServer(serverPort, reactorCount)) {
         qCritical() << "Failed to start the HTTP server. Exiting.";
         return -1;
     }
 
-    qInfo() << QString("Online Store Server is running on http://localhost:%1").arg(serverPort);
+    qInfo() << QString("Online Store Server is running on http://localhost:%1 (%2 listener thread(s))")
+                   .arg(serverPort).arg(reactorCount);
 
     return a.exec();
 }
@@ -0,0 +1,64 @@
+#include "mappedfiledevice.h"
+#include <cstring>
+
+MappedFileDevice::MappedFileDevice(const QString &filePath, qint64 offset, qint64 length, QObject *parent)
+    : QIODevice(parent),
+    m_file(filePath),
+    m_offset(offset),
+    m_length(length)
+{
+}
+
+MappedFileDevice::~MappedFileDevice()
+{
+    close();
+}
+
+bool MappedFileDevice::open(OpenMode mode)
+{
+    if ((mode & QIODevice::WriteOnly) || m_length <= 0) {
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+    m_map = m_file.map(m_offset, m_length);
+    if (!m_map) {
+        setErrorString(m_file.errorString());
+        m_file.close();
+        return false;
+    }
+    // Без внутреннего буфера QIODevice: данные копируются из отображения сразу в буфер получателя
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void MappedFileDevice::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+    if (isOpen()) {
+        QIODevice::close();
+    }
+}
+
+qint64 MappedFileDevice::readData(char *data, qint64 maxSize)
+{
+    const qint64 available = m_length - pos();
+    if (available <= 0) {
+        return -1;
+    }
+    const qint64 count = qMin(maxSize, available);
+    std::memcpy(data, m_map + pos(), size_t(count));
+    return count;
+}
+
+qint64 MappedFileDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPEDFILEDEVICE_H
+#define MAPPEDFILEDEVICE_H
+
+#include <QIODevice>
+#include <QFile>
+
+// Устройство только для чтения поверх отображенного в память участка файла.
+// Данные читаются прямо из страниц файла, поэтому отдача большого файла
+// не требует буфера в куче размером с файл.
+class MappedFileDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    MappedFileDevice(const QString &filePath, qint64 offset, qint64 length, QObject *parent = nullptr);
+    ~MappedFileDevice() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_length; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    QFile m_file;
+    qint64 m_offset;
+    qint64 m_length;
+    uchar *m_map = nullptr;
+};
+
+#endif // MAPPEDFILEDEVICE_H
@@ -0,0 +1,49 @@
+#include "passwordverifier.h"
+#include <crypt.h>
+#include <memory>
+
+namespace {
+
+// Хеш той же стоимости, что и пароли в Users (gen_salt('bf', 8))
+constexpr char kDummyHash[] = "$2a$08$G/APHv8LFVs6gNDIHrsdGOD3XdKbdV4J2Y4efqsmBUM6Vn3NGsihO";
+
+// Сравнение за постоянное время: время не зависит от позиции первого несовпадения
+bool constantTimeEquals(const char *a, const char *b, qsizetype size)
+{
+    unsigned char diff = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+// crypt_data занимает десятки КиБ: по одной на поток, а не на стеке при каждом входе
+crypt_data &threadCryptData()
+{
+    thread_local std::unique_ptr<crypt_data> data = std::make_unique<crypt_data>();
+    return *data;
+}
+
+}
+
+bool PasswordVerifier::verify(const QByteArray &password, const QByteArray &hash)
+{
+    // Только bcrypt: другой префикс означает чужой или поврежденный хеш, а не слабый алгоритм
+    if (!hash.startsWith("$2") || password.contains('\0')) {
+        return false;
+    }
+    crypt_data &data = threadCryptData();
+    data.initialized = 0;
+    const char *computed = crypt_r(password.constData(), hash.constData(), &data);
+    // При ошибке libcrypt возвращает NULL или строку, начинающуюся с '*'
+    if (!computed || computed[0] == '*') {
+        return false;
+    }
+    const qsizetype size = qsizetype(qstrlen(computed));
+    return size == hash.size() && constantTimeEquals(computed, hash.constData(), size);
+}
+
+void PasswordVerifier::verifyDummy(const QByteArray &password)
+{
+    verify(password, QByteArray::fromRawData(kDummyHash, sizeof(kDummyHash) - 1));
+}
@@ -0,0 +1,19 @@
+#ifndef PASSWORDVERIFIER_H
+#define PASSWORDVERIFIER_H
+
+#include <QByteArray>
+
+// Проверка пароля по хешу bcrypt из Users.user_password (crypt() и gen_salt('bf') pgcrypto).
+// Хеш считается в процессе сервера (crypt_r из libcrypt), а не в PostgreSQL: дорогая
+// часть входа занимает ядро сервера, а не соединение пула и процесс БД.
+class PasswordVerifier
+{
+public:
+    // false и для пароля не по хешу, и для хеша не bcrypt ($2a$, $2b$, $2y$)
+    static bool verify(const QByteArray &password, const QByteArray &hash);
+    // Та же работа, что и verify(), для входа с неизвестным логином: время ответа
+    // не выдает, существует ли пользователь
+    static void verifyDummy(const QByteArray &password);
+};
+
+#endif // PASSWORDVERIFIER_H
@@ -0,0 +1,294 @@
+#include "productimportreader.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+namespace {
+// Одна запись больше этого размера отклоняется, а не читается в память целиком
+constexpr qint64 kMaxRecordBytes = 1024 * 1024;
+constexpr double kMaxPrice = 99999999.99; // DECIMAL(10, 2)
+}
+
+std::optional<ProductImportReader::Format> ProductImportReader::formatFromString(const QString &name)
+{
+    if (name.compare("ndjson", Qt::CaseInsensitive) == 0) {
+        return Format::Ndjson;
+    }
+    if (name.compare("csv", Qt::CaseInsensitive) == 0) {
+        return Format::Csv;
+    }
+    return std::nullopt;
+}
+
+ProductImportReader::ProductImportReader(QIODevice *device, Format format)
+    : m_device(device),
+    m_format(format)
+{
+}
+
+bool ProductImportReader::next(QByteArray *copyRow, QString *rejectReason)
+{
+    copyRow->clear();
+    rejectReason->clear();
+    if (m_format == Format::Csv && !m_headerRead && !readCsvHeader()) {
+        return false;
+    }
+
+    Record record;
+    if (m_format == Format::Ndjson) {
+        QByteArray line;
+        do {
+            if (!readLine(&line)) {
+                return false;
+            }
+        } while (line.trimmed().isEmpty());
+        ++m_recordNumber;
+        if (line.size() > kMaxRecordBytes) {
+            *rejectReason = "Record is too long.";
+            return true;
+        }
+        if (!parseNdjson(line, &record, rejectReason)) {
+            return true;
+        }
+    } else {
+        QStringList fields;
+        do {
+            if (!readCsvFields(&fields)) {
+                return false;
+            }
+        } while (fields.size() == 1 && fields.constFirst().trimmed().isEmpty());
+        ++m_recordNumber;
+        if (fields.isEmpty()) {
+            *rejectReason = "Record is too long.";
+            return true;
+        }
+        if (!parseCsv(fields, &record, rejectReason)) {
+            return true;
+        }
+    }
+
+    *copyRow = toCopyRow(record, rejectReason);
+    return true;
+}
+
+bool ProductImportReader::readLine(QByteArray *line)
+{
+    // Строка читается не больше чем на kMaxRecordBytes; остаток слишком длинной строки пропускается
+    *line = m_device->readLine(kMaxRecordBytes + 1);
+    if (line->isEmpty()) {
+        return false;
+    }
+    m_bytesRead += line->size();
+    if (line->size() > kMaxRecordBytes && !line->endsWith('\n')) {
+        char c;
+        while (m_device->getChar(&c)) {
+            ++m_bytesRead;
+            if (c == '\n') {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool ProductImportReader::readCsvHeader()
+{
+    m_headerRead = true;
+    QStringList columns;
+    if (!readCsvFields(&columns)) {
+        m_error = "CSV file is empty.";
+        return false;
+    }
+    for (int i = 0; i < columns.size(); ++i) {
+        m_csvColumns.insert(columns.at(i).trimmed().toLower(), i);
+    }
+    if (!m_csvColumns.contains("product_name") || !m_csvColumns.contains("product_price")) {
+        m_error = "CSV header must contain product_name and product_price.";
+        return false;
+    }
+    return true;
+}
+
+bool ProductImportReader::readCsvFields(QStringList *fields)
+{
+    fields->clear();
+    QString field;
+    qint64 recordBytes = 0;
+    bool inQuotes = false;
+    QByteArray raw;
+    while (readLine(&raw)) {
+        recordBytes += raw.size();
+        if (recordBytes > kMaxRecordBytes) {
+            // Дочитываем запись до конца, но не храним ее; пустой список означает отказ
+            if (!inQuotes) {
+                fields->clear();
+                return true;
+            }
+            inQuotes = raw.count('"') % 2 == 0;
+            continue;
+        }
+
+        QString line = QString::fromUtf8(raw);
+        if (line.endsWith('\n')) {
+            line.chop(1);
+        }
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        for (qsizetype i = 0; i < line.size(); ++i) {
+            const QChar c = line.at(i);
+            if (inQuotes) {
+                if (c != '"') {
+                    field += c;
+                } else if (i + 1 < line.size() && line.at(i + 1) == '"') {
+                    field += '"';
+                    ++i;
+                } else {
+                    inQuotes = false;
+                }
+            } else if (c == '"') {
+                inQuotes = true;
+            } else if (c == ',') {
+                fields->append(field);
+                field.clear();
+            } else {
+                field += c;
+            }
+        }
+        if (!inQuotes) {
+            fields->append(field);
+            return true;
+        }
+        field += '\n';
+    }
+    if (recordBytes > kMaxRecordBytes) {
+        fields->clear();
+        return true;
+    }
+    if (recordBytes > 0) {
+        fields->append(field); // незакрытая кавычка в конце файла
+        return true;
+    }
+    return false;
+}
+
+bool ProductImportReader::parseNdjson(const QByteArray &line, Record *record, QString *rejectReason) const
+{
+    QJsonParseError parseError;
+    const QJsonDocument json = QJsonDocument::fromJson(line, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !json.isObject()) {
+        *rejectReason = "Invalid JSON object: " + parseError.errorString();
+        return false;
+    }
+    const QJsonObject object = json.object();
+    record->name = object.value("product_name").toString();
+    const QJsonValue price = object.value("product_price");
+    record->price = price.isDouble() ? QString::number(price.toDouble(), 'f', 2) : price.toString();
+    record->description = object.value("product_description").toString();
+    record->imagePath = object.value("product_image_path").toString();
+    const QJsonValue stock = object.value("product_stock");
+    record->stock = stock.isDouble() ? QString::number(stock.toInteger()) : stock.toString();
+    for (const QJsonValue &categoryId : object.value("category_ids").toArray()) {
+        if (!categoryId.isDouble() || categoryId.toInt() <= 0) {
+            *rejectReason = "category_ids must contain positive integers.";
+            return false;
+        }
+        record->categoryIds.append(categoryId.toInt());
+    }
+    return true;
+}
+
+bool ProductImportReader::parseCsv(const QStringList &fields, Record *record, QString *rejectReason) const
+{
+    auto field = [&](const QString &name) {
+        const int column = m_csvColumns.value(name, -1);
+        return column >= 0 && column < fields.size() ? fields.at(column) : QString();
+    };
+    record->name = field("product_name");
+    record->price = field("product_price").trimmed();
+    record->description = field("product_description");
+    record->imagePath = field("product_image_path").trimmed();
+    record->stock = field("product_stock").trimmed();
+    const QStringList categoryIds = field("category_ids").split(';', Qt::SkipEmptyParts);
+    for (const QString &value : categoryIds) {
+        bool ok = false;
+        const int categoryId = value.trimmed().toInt(&ok);
+        if (!ok || categoryId <= 0) {
+            *rejectReason = "category_ids must contain positive integers separated by ';'.";
+            return false;
+        }
+        record->categoryIds.append(categoryId);
+    }
+    return true;
+}
+
+QByteArray ProductImportReader::toCopyRow(const Record &record, QString *rejectReason) const
+{
+    if (record.name.trimmed().isEmpty() || record.name.size() > 255) {
+        *rejectReason = "product_name is empty or longer than 255 characters.";
+        return QByteArray();
+    }
+    bool ok = false;
+    const double price = record.price.toDouble(&ok);
+    if (!ok || price <= 0 || price > kMaxPrice) {
+        *rejectReason = "product_price must be a positive number.";
+        return QByteArray();
+    }
+    // Без product_stock остаток не задан (\N): при слиянии существующий товар сохраняет свой остаток
+    QByteArray stock = "\\N";
+    if (!record.stock.isEmpty()) {
+        const int value = record.stock.toInt(&ok);
+        if (!ok || value < 0) {
+            *rejectReason = "product_stock must be a non-negative integer.";
+            return QByteArray();
+        }
+        stock = QByteArray::number(value);
+    }
+
+    QByteArray categoryIds = "{";
+    for (int i = 0; i < record.categoryIds.size(); ++i) {
+        if (i > 0) {
+            categoryIds += ',';
+        }
+        categoryIds += QByteArray::number(record.categoryIds.at(i));
+    }
+    categoryIds += '}';
+
+    // Колонки import_staging: line_no, name, price, description, image_path, stock, category_ids
+    QByteArray row;
+    row += QByteArray::number(m_recordNumber) + '\t';
+    row += copyEscape(record.name) + '\t';
+    row += QByteArray::number(price, 'f', 2) + '\t';
+    row += copyEscape(record.description) + '\t';
+    row += copyEscape(record.imagePath) + '\t';
+    row += stock + '\t';
+    row += categoryIds + '\n';
+    return row;
+}
+
+QByteArray ProductImportReader::copyEscape(const QString &value)
+{
+    // Текстовый формат COPY: обратная косая черта, табуляция и переводы строк экранируются
+    const QByteArray utf8 = value.toUtf8();
+    QByteArray escaped;
+    escaped.reserve(utf8.size());
+    for (char c : utf8) {
+        switch (c) {
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\r':
+            escaped += "\\r";
+            break;
+        default:
+            escaped += c;
+        }
+    }
+    return escaped;
+}
@@ -0,0 +1,70 @@
+#ifndef PRODUCTIMPORTREADER_H
+#define PRODUCTIMPORTREADER_H
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QList>
+#include <optional>
+
+// Построчное чтение файла импорта товаров. Каждая запись файла превращается в строку
+// формата COPY text для промежуточной таблицы или отклоняется с причиной.
+// В памяти находится только текущая запись, поэтому размер файла не ограничен памятью.
+//
+// Поля записи: product_name, product_price, product_description, product_image_path,
+// product_stock, category_ids.
+// NDJSON: один JSON-объект на строку, category_ids - массив чисел.
+// CSV: первая строка - заголовок с именами полей, category_ids - числа через ';'.
+class ProductImportReader
+{
+public:
+    enum class Format {
+        Ndjson,
+        Csv
+    };
+
+    static std::optional<Format> formatFromString(const QString &name);
+
+    ProductImportReader(QIODevice *device, Format format);
+
+    // false - файл закончился (или в CSV нет заголовка, см. error()).
+    // Иначе заполнен либо *copyRow (с завершающим '\n'), либо *rejectReason.
+    bool next(QByteArray *copyRow, QString *rejectReason);
+
+    qint64 recordNumber() const { return m_recordNumber; }
+    qint64 bytesRead() const { return m_bytesRead; }
+    QString error() const { return m_error; }
+
+private:
+    struct Record
+    {
+        QString name;
+        QString price;
+        QString description;
+        QString imagePath;
+        QString stock;
+        QList<int> categoryIds;
+    };
+
+    bool readLine(QByteArray *line);
+    bool readCsvHeader();
+    // Запись CSV может занимать несколько строк, если в кавычках есть перевод строки
+    bool readCsvFields(QStringList *fields);
+    bool parseNdjson(const QByteArray &line, Record *record, QString *rejectReason) const;
+    bool parseCsv(const QStringList &fields, Record *record, QString *rejectReason) const;
+    QByteArray toCopyRow(const Record &record, QString *rejectReason) const;
+
+    static QByteArray copyEscape(const QString &value);
+
+    QIODevice *m_device;
+    Format m_format;
+    QHash<QString, int> m_csvColumns; // имя поля -> номер колонки
+    bool m_headerRead = false;
+    qint64 m_recordNumber = 0;
+    qint64 m_bytesRead = 0;
+    QString m_error;
+};
+
+#endif // PRODUCTIMPORTREADER_H
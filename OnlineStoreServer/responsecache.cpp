@@ -0,0 +1,31 @@
+#include "responsecache.h"
+#include <QCryptographicHash>
+
+CachedResponse ResponseCache::get(const QByteArray &key, quint64 version, const std::function<QByteArray()> &build)
+{
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.constEnd() && it->version == version) {
+            return *it; // QByteArray разделяется неявно: тело не копируется
+        }
+    }
+
+    CachedResponse entry;
+    entry.version = version;
+    entry.body = build();
+    entry.etag = makeEtag(entry.body);
+
+    QWriteLocker locker(&m_lock);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end() || it->version < version) {
+        m_entries.insert(key, entry);
+    }
+    return entry;
+}
+
+QByteArray ResponseCache::makeEtag(const QByteArray &body)
+{
+    // ETag зависит только от содержимого: неизменившаяся категория сохраняет его между версиями каталога
+    return '"' + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex().left(32) + '"';
+}
@@ -0,0 +1,31 @@
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QReadWriteLock>
+#include <functional>
+
+// Готовое тело ответа (UTF-8 JSON) и его сильный ETag
+struct CachedResponse
+{
+    quint64 version = 0;
+    QByteArray body;
+    QByteArray etag;
+};
+
+// Кэш сериализованных ответов каталога. Запись действительна для одной версии каталога:
+// после публикации новой версии тело пересобирается при первом обращении.
+class ResponseCache
+{
+public:
+    CachedResponse get(const QByteArray &key, quint64 version, const std::function<QByteArray()> &build);
+
+    static QByteArray makeEtag(const QByteArray &body);
+
+private:
+    QReadWriteLock m_lock;
+    QHash<QByteArray, CachedResponse> m_entries;
+};
+
+#endif // RESPONSECACHE_H
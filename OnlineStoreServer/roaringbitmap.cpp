@@ -0,0 +1,362 @@
+#include "roaringbitmap.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+inline quint16 highBits(quint32 value)
+{
+    return quint16(value >> 16);
+}
+
+inline quint16 lowBits(quint32 value)
+{
+    return quint16(value & 0xFFFF);
+}
+
+inline bool testBit(const QList<quint64> &words, quint16 low)
+{
+    return words.at(low / 64) & (quint64(1) << (low % 64));
+}
+}
+
+void RoaringBitmap::add(quint32 value)
+{
+    const quint16 key = highBits(value);
+    const quint16 low = lowBits(value);
+    qsizetype index = lowerBound(key);
+    if (index == m_containers.size() || m_containers.at(index).key != key) {
+        Container container;
+        container.key = key;
+        m_containers.insert(index, container);
+    }
+    Container &container = m_containers[index];
+    if (container.isBitmap()) {
+        quint64 &word = container.words[low / 64];
+        const quint64 mask = quint64(1) << (low % 64);
+        if (!(word & mask)) {
+            word |= mask;
+            ++container.cardinality;
+        }
+        return;
+    }
+    auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+    if (it != container.values.end() && *it == low) {
+        return;
+    }
+    container.values.insert(it, low);
+    ++container.cardinality;
+    if (container.cardinality > kArrayMaxSize) {
+        toBitmap(container);
+    }
+}
+
+void RoaringBitmap::remove(quint32 value)
+{
+    const quint16 key = highBits(value);
+    const quint16 low = lowBits(value);
+    const qsizetype index = lowerBound(key);
+    if (index == m_containers.size() || m_containers.at(index).key != key) {
+        return;
+    }
+    Container &container = m_containers[index];
+    if (container.isBitmap()) {
+        quint64 &word = container.words[low / 64];
+        const quint64 mask = quint64(1) << (low % 64);
+        if (!(word & mask)) {
+            return;
+        }
+        word &= ~mask;
+        --container.cardinality;
+        if (container.cardinality <= kArrayMaxSize) {
+            toArray(container);
+        }
+    } else {
+        auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+        if (it == container.values.end() || *it != low) {
+            return;
+        }
+        container.values.erase(it);
+        --container.cardinality;
+    }
+    if (container.cardinality == 0) {
+        m_containers.remove(index);
+    }
+}
+
+bool RoaringBitmap::contains(quint32 value) const
+{
+    const quint16 key = highBits(value);
+    const quint16 low = lowBits(value);
+    const qsizetype index = lowerBound(key);
+    if (index == m_containers.size() || m_containers.at(index).key != key) {
+        return false;
+    }
+    const Container &container = m_containers.at(index);
+    if (container.isBitmap()) {
+        return testBit(container.words, low);
+    }
+    return std::binary_search(container.values.cbegin(), container.values.cend(), low);
+}
+
+qint64 RoaringBitmap::cardinality() const
+{
+    qint64 result = 0;
+    for (const Container &container : m_containers) {
+        result += container.cardinality;
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::intersected(const RoaringBitmap &a, const RoaringBitmap &b)
+{
+    RoaringBitmap result;
+    qsizetype i = 0;
+    qsizetype j = 0;
+    while (i < a.m_containers.size() && j < b.m_containers.size()) {
+        const Container &left = a.m_containers.at(i);
+        const Container &right = b.m_containers.at(j);
+        if (left.key < right.key) {
+            ++i;
+        } else if (right.key < left.key) {
+            ++j;
+        } else {
+            Container container = intersect(left, right);
+            if (container.cardinality > 0) {
+                result.m_containers.append(std::move(container));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::united(const RoaringBitmap &a, const RoaringBitmap &b)
+{
+    RoaringBitmap result;
+    qsizetype i = 0;
+    qsizetype j = 0;
+    while (i < a.m_containers.size() || j < b.m_containers.size()) {
+        if (j == b.m_containers.size() || (i < a.m_containers.size() && a.m_containers.at(i).key < b.m_containers.at(j).key)) {
+            result.m_containers.append(a.m_containers.at(i++));
+        } else if (i == a.m_containers.size() || b.m_containers.at(j).key < a.m_containers.at(i).key) {
+            result.m_containers.append(b.m_containers.at(j++));
+        } else {
+            result.m_containers.append(unite(a.m_containers.at(i++), b.m_containers.at(j++)));
+        }
+    }
+    return result;
+}
+
+qint64 RoaringBitmap::intersectionCardinality(const RoaringBitmap &other) const
+{
+    qint64 result = 0;
+    qsizetype i = 0;
+    qsizetype j = 0;
+    while (i < m_containers.size() && j < other.m_containers.size()) {
+        const Container &left = m_containers.at(i);
+        const Container &right = other.m_containers.at(j);
+        if (left.key < right.key) {
+            ++i;
+        } else if (right.key < left.key) {
+            ++j;
+        } else {
+            result += intersectCount(left, right);
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+QList<int> RoaringBitmap::values(qint64 after, int limit, bool *more) const
+{
+    *more = false;
+    QList<int> result;
+    if (limit <= 0) {
+        return result;
+    }
+    const qint64 from = qMax<qint64>(after + 1, 0);
+    if (from > 0xFFFFFFFFLL) {
+        return result;
+    }
+    for (qsizetype index = lowerBound(highBits(quint32(from))); index < m_containers.size(); ++index) {
+        const Container &container = m_containers.at(index);
+        const quint32 base = quint32(container.key) << 16;
+        // Внутри первого блока пропускаются значения не больше after
+        const int start = (container.key == highBits(quint32(from))) ? lowBits(quint32(from)) : 0;
+        if (container.isBitmap()) {
+            for (int w = start / 64; w < kBitmapWords; ++w) {
+                quint64 word = container.words.at(w);
+                if (w == start / 64) {
+                    word &= ~quint64(0) << (start % 64);
+                }
+                while (word) {
+                    if (result.size() == limit) {
+                        *more = true;
+                        return result;
+                    }
+                    result.append(int(base + quint32(w * 64 + qCountTrailingZeroBits(word))));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            auto it = std::lower_bound(container.values.cbegin(), container.values.cend(), quint16(start));
+            for (; it != container.values.cend(); ++it) {
+                if (result.size() == limit) {
+                    *more = true;
+                    return result;
+                }
+                result.append(int(base + *it));
+            }
+        }
+    }
+    return result;
+}
+
+qint64 RoaringBitmap::memoryBytes() const
+{
+    qint64 result = m_containers.capacity() * qint64(sizeof(Container));
+    for (const Container &container : m_containers) {
+        result += container.values.capacity() * qint64(sizeof(quint16))
+                  + container.words.capacity() * qint64(sizeof(quint64));
+    }
+    return result;
+}
+
+int RoaringBitmap::bitmapContainerCount() const
+{
+    return int(std::count_if(m_containers.cbegin(), m_containers.cend(),
+                             [](const Container &container) { return container.isBitmap(); }));
+}
+
+qsizetype RoaringBitmap::lowerBound(quint16 key) const
+{
+    auto it = std::lower_bound(m_containers.cbegin(), m_containers.cend(), key,
+                               [](const Container &container, quint16 value) { return container.key < value; });
+    return it - m_containers.cbegin();
+}
+
+void RoaringBitmap::toBitmap(Container &container)
+{
+    container.words.fill(0, kBitmapWords);
+    for (quint16 low : std::as_const(container.values)) {
+        container.words[low / 64] |= quint64(1) << (low % 64);
+    }
+    container.values.clear();
+    container.values.squeeze();
+}
+
+void RoaringBitmap::toArray(Container &container)
+{
+    container.values.clear();
+    container.values.reserve(container.cardinality);
+    for (int w = 0; w < kBitmapWords; ++w) {
+        quint64 word = container.words.at(w);
+        while (word) {
+            container.values.append(quint16(w * 64 + qCountTrailingZeroBits(word)));
+            word &= word - 1;
+        }
+    }
+    container.words.clear();
+    container.words.squeeze();
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container &a, const Container &b)
+{
+    Container result;
+    result.key = a.key;
+    if (a.isBitmap() && b.isBitmap()) {
+        result.words.resize(kBitmapWords);
+        int cardinality = 0;
+        for (int w = 0; w < kBitmapWords; ++w) {
+            const quint64 word = a.words.at(w) & b.words.at(w);
+            result.words[w] = word;
+            cardinality += qPopulationCount(word);
+        }
+        result.cardinality = cardinality;
+        if (cardinality <= kArrayMaxSize) {
+            toArray(result);
+        }
+        return result;
+    }
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container &array = a.isBitmap() ? b : a;
+        const Container &bitmap = a.isBitmap() ? a : b;
+        result.values.reserve(array.cardinality);
+        for (quint16 low : array.values) {
+            if (testBit(bitmap.words, low)) {
+                result.values.append(low);
+            }
+        }
+    } else {
+        result.values.reserve(qMin(a.cardinality, b.cardinality));
+        std::set_intersection(a.values.cbegin(), a.values.cend(), b.values.cbegin(), b.values.cend(),
+                              std::back_inserter(result.values));
+    }
+    result.cardinality = int(result.values.size());
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container &a, const Container &b)
+{
+    Container result;
+    result.key = a.key;
+    if (!a.isBitmap() && !b.isBitmap() && a.cardinality + b.cardinality <= kArrayMaxSize) {
+        result.values.reserve(a.cardinality + b.cardinality);
+        std::set_union(a.values.cbegin(), a.values.cend(), b.values.cbegin(), b.values.cend(),
+                       std::back_inserter(result.values));
+        result.cardinality = int(result.values.size());
+        return result;
+    }
+
+    result.words.fill(0, kBitmapWords);
+    for (const Container *source : {&a, &b}) {
+        if (source->isBitmap()) {
+            for (int w = 0; w < kBitmapWords; ++w) {
+                result.words[w] |= source->words.at(w);
+            }
+        } else {
+            for (quint16 low : source->values) {
+                result.words[low / 64] |= quint64(1) << (low % 64);
+            }
+        }
+    }
+    int cardinality = 0;
+    for (quint64 word : std::as_const(result.words)) {
+        cardinality += qPopulationCount(word);
+    }
+    result.cardinality = cardinality;
+    if (cardinality <= kArrayMaxSize) {
+        toArray(result);
+    }
+    return result;
+}
+
+qint64 RoaringBitmap::intersectCount(const Container &a, const Container &b)
+{
+    qint64 count = 0;
+    if (a.isBitmap() && b.isBitmap()) {
+        for (int w = 0; w < kBitmapWords; ++w) {
+            count += qPopulationCount(a.words.at(w) & b.words.at(w));
+        }
+    } else if (a.isBitmap() || b.isBitmap()) {
+        const Container &array = a.isBitmap() ? b : a;
+        const Container &bitmap = a.isBitmap() ? a : b;
+        for (quint16 low : array.values) {
+            count += testBit(bitmap.words, low);
+        }
+    } else {
+        auto i = a.values.cbegin();
+        auto j = b.values.cbegin();
+        while (i != a.values.cend() && j != b.values.cend()) {
+            const quint16 left = *i;
+            const quint16 right = *j;
+            count += (left == right);
+            i += (left <= right);
+            j += (right <= left);
+        }
+    }
+    return count;
+}
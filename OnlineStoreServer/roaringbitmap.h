@@ -0,0 +1,57 @@
+#ifndef ROARINGBITMAP_H
+#define ROARINGBITMAP_H
+
+#include <QtGlobal>
+#include <QList>
+
+// Сжатое множество product_id в духе Roaring: значения делятся на блоки по старшим 16 битам,
+// блок хранится либо отсортированным массивом младших 16 бит (до kArrayMaxSize значений),
+// либо битовой картой на 65536 бит. Пересечение и объединение идут поблочно, а мощности
+// считаются через popcount по словам битовых карт без построения результата.
+// Обычный копируемый тип значения: копия снимка каталога разделяет данные (implicit sharing QList).
+class RoaringBitmap
+{
+public:
+    void add(quint32 value);
+    void remove(quint32 value);
+    bool contains(quint32 value) const;
+    bool isEmpty() const { return m_containers.isEmpty(); }
+    qint64 cardinality() const;
+
+    static RoaringBitmap intersected(const RoaringBitmap &a, const RoaringBitmap &b);
+    static RoaringBitmap united(const RoaringBitmap &a, const RoaringBitmap &b);
+    // |this ∩ other| без построения пересечения
+    qint64 intersectionCardinality(const RoaringBitmap &other) const;
+
+    // До limit значений строго больше after по возрастанию; *more = true, если есть еще
+    QList<int> values(qint64 after, int limit, bool *more) const;
+
+    qint64 memoryBytes() const;
+    int containerCount() const { return int(m_containers.size()); }
+    int bitmapContainerCount() const;
+
+private:
+    static constexpr int kArrayMaxSize = 4096; // больше - битовая карта (8 КиБ) не длиннее массива
+    static constexpr int kBitmapWords = 65536 / 64;
+
+    struct Container
+    {
+        quint16 key = 0;
+        int cardinality = 0;
+        QList<quint16> values; // блок-массив: отсортированные младшие 16 бит
+        QList<quint64> words;  // блок-битовая карта: kBitmapWords слов; пусто для массива
+
+        bool isBitmap() const { return !words.isEmpty(); }
+    };
+
+    qsizetype lowerBound(quint16 key) const;
+    static void toBitmap(Container &container);
+    static void toArray(Container &container);
+    static Container intersect(const Container &a, const Container &b);
+    static Container unite(const Container &a, const Container &b);
+    static qint64 intersectCount(const Container &a, const Container &b);
+
+    QList<Container> m_containers; // по возрастанию key
+};
+
+#endif // ROARINGBITMAP_H
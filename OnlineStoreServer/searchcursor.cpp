@@ -0,0 +1,36 @@
+#include "searchcursor.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+
+QByteArray SearchCursor::encode() const
+{
+    QJsonObject object;
+    // Ранг в виде строки, чтобы REAL вернулся в запрос без потери точности
+    object["r"] = QString::number(rank, 'g', 9);
+    object["i"] = productId;
+    return QJsonDocument(object).toJson(QJsonDocument::Compact)
+        .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+}
+
+std::optional<SearchCursor> SearchCursor::decode(const QByteArray &encoded)
+{
+    const QByteArray::FromBase64Result decoded = QByteArray::fromBase64Encoding(
+        encoded, QByteArray::Base64UrlEncoding | QByteArray::AbortOnBase64DecodingErrors);
+    if (!decoded) {
+        return std::nullopt;
+    }
+    const QJsonDocument json = QJsonDocument::fromJson(*decoded);
+    if (!json.isObject()) {
+        return std::nullopt;
+    }
+    const QJsonObject object = json.object();
+    bool rankOk = false;
+    const float rank = object.value("r").toString().toFloat(&rankOk);
+    if (!rankOk || !object.value("i").isDouble()) {
+        return std::nullopt;
+    }
+    SearchCursor cursor;
+    cursor.rank = rank;
+    cursor.productId = object.value("i").toInt();
+    return cursor;
+}
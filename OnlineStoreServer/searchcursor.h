@@ -0,0 +1,20 @@
+#ifndef SEARCHCURSOR_H
+#define SEARCHCURSOR_H
+
+#include <QByteArray>
+#include <optional>
+
+// Позиция в выдаче поиска: ранг и id последнего товара предыдущей страницы.
+// Следующая страница - товары с меньшим рангом или с тем же рангом и большим product_id
+// (см. fn_SearchProducts), поэтому ранг должен вернуться в запрос точно, без округления.
+struct SearchCursor
+{
+    float rank = 0;
+    int productId = 0;
+
+    // Непрозрачная строка для клиента (base64url от JSON)
+    QByteArray encode() const;
+    static std::optional<SearchCursor> decode(const QByteArray &encoded);
+};
+
+#endif // SEARCHCURSOR_H
@@ -0,0 +1,111 @@
+#include "sessionstore.h"
+#include <QRandomGenerator>
+
+SessionStore::SessionStore()
+{
+}
+
+void SessionStore::setIdleTimeoutMs(qint64 idleTimeoutMs)
+{
+    m_idleTimeoutMs = idleTimeoutMs;
+}
+
+void SessionStore::setMaxLifetimeMs(qint64 maxLifetimeMs)
+{
+    m_maxLifetimeMs = maxLifetimeMs;
+}
+
+qint64 SessionStore::idleTimeoutMs() const
+{
+    return m_idleTimeoutMs;
+}
+
+QByteArray SessionStore::create(int userId, const QString &role)
+{
+    // 256 бит из криптографического генератора ОС
+    std::array<quint32, 8> random;
+    QRandomGenerator::system()->fillRange(random.data(), random.size());
+    const QByteArray token = QByteArray(reinterpret_cast<const char *>(random.data()), sizeof(random))
+                                 .toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+
+    Entry entry;
+    entry.session = Session{userId, role};
+    entry.created.start();
+    entry.lastSeen.start();
+
+    Shard &shard = shardFor(token);
+    QMutexLocker locker(&shard.mutex);
+    shard.entries.insert(token, entry);
+    ++m_created;
+    return token;
+}
+
+std::optional<Session> SessionStore::validate(const QByteArray &token)
+{
+    if (token.isEmpty()) {
+        return std::nullopt;
+    }
+    Shard &shard = shardFor(token);
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.entries.find(token);
+    if (it == shard.entries.end()) {
+        ++m_rejected;
+        return std::nullopt;
+    }
+    if (isExpired(*it)) {
+        shard.entries.erase(it);
+        ++m_rejected;
+        return std::nullopt;
+    }
+    it->lastSeen.start(); // скользящий срок: активная сессия не истекает
+    return it->session;
+}
+
+void SessionStore::revoke(const QByteArray &token)
+{
+    Shard &shard = shardFor(token);
+    QMutexLocker locker(&shard.mutex);
+    shard.entries.remove(token);
+}
+
+int SessionStore::removeExpired()
+{
+    int removed = 0;
+    for (Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            if (isExpired(*it)) {
+                it = shard.entries.erase(it);
+                ++removed;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
+QJsonObject SessionStore::stats() const
+{
+    qint64 active = 0;
+    for (const Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        active += shard.entries.size();
+    }
+    QJsonObject result;
+    result["active"] = active;
+    result["created"] = qint64(m_created.load());
+    result["rejected"] = qint64(m_rejected.load());
+    result["idle_timeout_ms"] = m_idleTimeoutMs.load();
+    return result;
+}
+
+SessionStore::Shard &SessionStore::shardFor(const QByteArray &token)
+{
+    return m_shards[qHash(token) % kShardCount];
+}
+
+bool SessionStore::isExpired(const Entry &entry) const
+{
+    return entry.lastSeen.hasExpired(m_idleTimeoutMs) || entry.created.hasExpired(m_maxLifetimeMs);
+}
@@ -0,0 +1,66 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+#include <optional>
+
+struct Session
+{
+    int userId = 0;
+    QString role;
+};
+
+// Таблица сессий в памяти. Токен - случайная непрозрачная строка; сессия истекает
+// после простоя (скользящий срок) или по абсолютному сроку жизни.
+// Проверка токена не обращается к БД.
+class SessionStore
+{
+public:
+    SessionStore();
+
+    void setIdleTimeoutMs(qint64 idleTimeoutMs);
+    void setMaxLifetimeMs(qint64 maxLifetimeMs);
+    qint64 idleTimeoutMs() const;
+
+    QByteArray create(int userId, const QString &role);
+    // Возвращает сессию и продлевает ее; пустой результат для неизвестного или истекшего токена
+    std::optional<Session> validate(const QByteArray &token);
+    void revoke(const QByteArray &token);
+    int removeExpired();
+
+    QJsonObject stats() const;
+
+private:
+    struct Entry
+    {
+        Session session;
+        QElapsedTimer created;
+        QElapsedTimer lastSeen;
+    };
+
+    // Сессии разбиты на сегменты по хэшу токена, чтобы запросы разных пользователей не ждали один мьютекс
+    struct Shard
+    {
+        mutable QMutex mutex;
+        QHash<QByteArray, Entry> entries;
+    };
+    static constexpr int kShardCount = 16;
+
+    Shard &shardFor(const QByteArray &token);
+    bool isExpired(const Entry &entry) const;
+
+    std::array<Shard, kShardCount> m_shards;
+    std::atomic<qint64> m_idleTimeoutMs{30 * 60 * 1000};
+    std::atomic<qint64> m_maxLifetimeMs{12 * 60 * 60 * 1000};
+    std::atomic<quint64> m_created{0};
+    std::atomic<quint64> m_rejected{0};
+};
+
+#endif // SESSIONSTORE_H
@@ -0,0 +1,271 @@
+#include "stockledger.h"
+#include <QDebug>
+
+StockLedger::StockLedger()
+    : m_counters(std::make_shared<const CounterMap>())
+{
+    m_clock.start();
+}
+
+void StockLedger::setReservationTtlMs(qint64 ttlMs)
+{
+    m_ttlMs = ttlMs;
+}
+
+void StockLedger::reset(const QHash<int, int> &stock)
+{
+    auto next = std::make_shared<CounterMap>();
+    next->reserve(stock.size());
+    for (auto it = stock.cbegin(); it != stock.cend(); ++it) {
+        auto counter = std::make_shared<Counter>();
+        counter->available = it.value();
+        next->insert(it.key(), std::move(counter));
+    }
+    QMutexLocker locker(&m_writeMutex);
+    std::atomic_store(&m_counters, std::shared_ptr<const CounterMap>(std::move(next)));
+}
+
+void StockLedger::addProducts(const QHash<int, int> &stock)
+{
+    QMutexLocker locker(&m_writeMutex);
+    auto next = std::make_shared<CounterMap>(*std::atomic_load(&m_counters));
+    for (auto it = stock.cbegin(); it != stock.cend(); ++it) {
+        auto counter = std::make_shared<Counter>();
+        counter->available = it.value();
+        next->insert(it.key(), std::move(counter));
+    }
+    std::atomic_store(&m_counters, std::shared_ptr<const CounterMap>(std::move(next)));
+}
+
+void StockLedger::removeProducts(const QList<int> &productIds)
+{
+    // Резервы удаленного товара остаются в сегментах и исчезают при release или по сроку
+    if (productIds.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&m_writeMutex);
+    auto next = std::make_shared<CounterMap>(*std::atomic_load(&m_counters));
+    for (int productId : productIds) {
+        next->remove(productId);
+    }
+    std::atomic_store(&m_counters, std::shared_ptr<const CounterMap>(std::move(next)));
+}
+
+void StockLedger::adjust(int productId, int delta)
+{
+    if (const std::shared_ptr<Counter> c = counter(productId)) {
+        c->available.fetch_add(delta);
+    }
+}
+
+StockLedger::Status StockLedger::reserve(int userId, int productId)
+{
+    const std::shared_ptr<Counter> c = counter(productId);
+    if (!c) {
+        return Status::NotFound;
+    }
+
+    Shard &shard = shardFor(userId);
+    QMutexLocker locker(&shard.mutex);
+    const qint64 deadline = m_clock.elapsed() + m_ttlMs;
+    QHash<int, qint64> &held = shard.reservations[userId];
+    auto it = held.find(productId);
+    if (it != held.end()) {
+        *it = deadline;
+        return Status::Ok;
+    }
+    if (!takeUnit(*c)) {
+        if (held.isEmpty()) {
+            shard.reservations.remove(userId);
+        }
+        ++m_soldOut;
+        return Status::SoldOut;
+    }
+    c->reserved.fetch_add(1);
+    held.insert(productId, deadline);
+    ++m_reservations;
+    return Status::Ok;
+}
+
+void StockLedger::release(int userId, int productId)
+{
+    Shard &shard = shardFor(userId);
+    QMutexLocker locker(&shard.mutex);
+    auto user = shard.reservations.find(userId);
+    if (user == shard.reservations.end() || !user->remove(productId)) {
+        return;
+    }
+    if (user->isEmpty()) {
+        shard.reservations.erase(user);
+    }
+    if (const std::shared_ptr<Counter> c = counter(productId)) {
+        c->reserved.fetch_sub(1);
+        c->available.fetch_add(1);
+    }
+}
+
+StockLedger::Status StockLedger::claim(int userId, const QList<int> &productIds, QList<int> *soldOut)
+{
+    struct Taken
+    {
+        int productId;
+        std::shared_ptr<Counter> counter;
+        bool reserved; // единица взята из резерва покупателя, а не из свободных
+    };
+    QList<Taken> taken;
+    taken.reserve(productIds.size());
+    soldOut->clear();
+
+    Shard &shard = shardFor(userId);
+    QMutexLocker locker(&shard.mutex);
+    QHash<int, qint64> &held = shard.reservations[userId];
+
+    for (int productId : productIds) {
+        std::shared_ptr<Counter> c = counter(productId);
+        if (!c) {
+            soldOut->append(productId);
+        } else if (held.contains(productId)) {
+            // Отрицательный available: администратор уменьшил остаток ниже числа резервов.
+            // Такой резерв не покрыт товаром и снимается, иначе заказ продал бы лишнюю единицу.
+            if (c->available.load() < 0) {
+                held.remove(productId);
+                c->reserved.fetch_sub(1);
+                c->available.fetch_add(1);
+                soldOut->append(productId);
+            } else {
+                taken.append({productId, std::move(c), true});
+            }
+        } else if (takeUnit(*c)) {
+            taken.append({productId, std::move(c), false});
+        } else {
+            soldOut->append(productId);
+        }
+    }
+
+    if (!soldOut->isEmpty()) {
+        // Все или ничего: свободные единицы возвращаются, резервы остаются за покупателем
+        for (const Taken &item : std::as_const(taken)) {
+            if (!item.reserved) {
+                item.counter->available.fetch_add(1);
+            }
+        }
+        if (held.isEmpty()) {
+            shard.reservations.remove(userId);
+        }
+        ++m_soldOut;
+        return Status::SoldOut;
+    }
+
+    for (const Taken &item : std::as_const(taken)) {
+        if (item.reserved) {
+            held.remove(item.productId);
+            item.counter->reserved.fetch_sub(1);
+        }
+    }
+    if (held.isEmpty()) {
+        shard.reservations.remove(userId);
+    }
+    return Status::Ok;
+}
+
+void StockLedger::cancelClaim(int userId, const QList<int> &productIds)
+{
+    Shard &shard = shardFor(userId);
+    QMutexLocker locker(&shard.mutex);
+    const qint64 deadline = m_clock.elapsed() + m_ttlMs;
+    QHash<int, qint64> &held = shard.reservations[userId];
+    for (int productId : productIds) {
+        if (const std::shared_ptr<Counter> c = counter(productId)) {
+            c->reserved.fetch_add(1);
+            held.insert(productId, deadline);
+        }
+    }
+    if (held.isEmpty()) {
+        shard.reservations.remove(userId);
+    }
+}
+
+int StockLedger::onHand(int productId) const
+{
+    const std::shared_ptr<Counter> c = counter(productId);
+    if (!c) {
+        return -1;
+    }
+    return c->available.load() + c->reserved.load();
+}
+
+int StockLedger::removeExpired()
+{
+    const qint64 now = m_clock.elapsed();
+    int removed = 0;
+    for (Shard &shard : m_shards) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto user = shard.reservations.begin(); user != shard.reservations.end();) {
+            for (auto it = user->begin(); it != user->end();) {
+                if (it.value() > now) {
+                    ++it;
+                    continue;
+                }
+                if (const std::shared_ptr<Counter> c = counter(it.key())) {
+                    c->reserved.fetch_sub(1);
+                    c->available.fetch_add(1);
+                }
+                it = user->erase(it);
+                ++removed;
+            }
+            if (user->isEmpty()) {
+                user = shard.reservations.erase(user);
+            } else {
+                ++user;
+            }
+        }
+    }
+    if (removed > 0) {
+        m_expired += removed;
+        qDebug() << "StockLedger: Released" << removed << "expired reservation(s)";
+    }
+    return removed;
+}
+
+QJsonObject StockLedger::stats() const
+{
+    qint64 available = 0;
+    qint64 reserved = 0;
+    const std::shared_ptr<const CounterMap> counters = std::atomic_load(&m_counters);
+    for (const std::shared_ptr<Counter> &c : *counters) {
+        available += qMax(0, c->available.load());
+        reserved += c->reserved.load();
+    }
+
+    QJsonObject result;
+    result["products"] = int(counters->size());
+    result["available"] = available;
+    result["reserved"] = reserved;
+    result["reservation_ttl_ms"] = m_ttlMs.load();
+    result["reservations_total"] = qint64(m_reservations.load());
+    result["sold_out_rejections"] = qint64(m_soldOut.load());
+    result["expired_reservations"] = qint64(m_expired.load());
+    return result;
+}
+
+std::shared_ptr<StockLedger::Counter> StockLedger::counter(int productId) const
+{
+    const std::shared_ptr<const CounterMap> counters = std::atomic_load(&m_counters);
+    return counters->value(productId);
+}
+
+StockLedger::Shard &StockLedger::shardFor(int userId)
+{
+    return m_shards[quint32(userId) % kShardCount];
+}
+
+bool StockLedger::takeUnit(Counter &counter)
+{
+    int available = counter.available.load();
+    while (available > 0) {
+        if (counter.available.compare_exchange_weak(available, available - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
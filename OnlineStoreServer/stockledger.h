@@ -0,0 +1,89 @@
+#ifndef STOCKLEDGER_H
+#define STOCKLEDGER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <array>
+#include <atomic>
+#include <memory>
+
+// Остатки товаров и резервы покупателей в памяти.
+// Резерв берется при добавлении в корзину атомарным уменьшением счетчика товара (CAS),
+// поэтому покупатели одного товара не ждут ни мьютекс, ни блокировку строки в БД,
+// а продать больше, чем есть на складе, нельзя. Неоформленный резерв истекает по TTL.
+// Проданные единицы просто покидают счетчик: остаток в БД списывается в транзакции заказа.
+//
+// Для каждого товара: available + reserved == product_stock в БД.
+class StockLedger
+{
+public:
+    enum class Status {
+        Ok,
+        NotFound, // товар неизвестен
+        SoldOut   // свободных единиц не осталось
+    };
+
+    StockLedger();
+
+    void setReservationTtlMs(qint64 ttlMs);
+
+    // Полная загрузка остатков из БД (при старте), резервов еще нет
+    void reset(const QHash<int, int> &stock);
+    void addProducts(const QHash<int, int> &stock);
+    void removeProducts(const QList<int> &productIds);
+    // Администратор изменил остаток в БД на delta
+    void adjust(int productId, int delta);
+
+    // Повторный резерв того же товара тем же покупателем только продлевает срок
+    Status reserve(int userId, int productId);
+    void release(int userId, int productId);
+
+    // Оформление заказа: резервы покупателя (или свободные единицы, если резерв истек)
+    // забираются под заказ. Все товары или ни одного; в soldOut - товары, которых не хватило.
+    Status claim(int userId, const QList<int> &productIds, QList<int> *soldOut);
+    // Запись заказа в БД не удалась: единицы возвращаются покупателю как резервы
+    void cancelClaim(int userId, const QList<int> &productIds);
+
+    // Остаток на складе (свободные и зарезервированные единицы); -1, если товар неизвестен
+    int onHand(int productId) const;
+
+    int removeExpired();
+    QJsonObject stats() const;
+
+private:
+    struct Counter
+    {
+        std::atomic<int> available{0};
+        std::atomic<int> reserved{0};
+    };
+    // Набор счетчиков меняется только при добавлении и удалении товаров: читатели берут
+    // неизменяемую карту атомарно (как снимок каталога) и работают со счетчиком без блокировок
+    using CounterMap = QHash<int, std::shared_ptr<Counter>>;
+
+    // Резервы разбиты на сегменты по user_id: покупатели разных сегментов не ждут друг друга
+    struct Shard
+    {
+        QMutex mutex;
+        QHash<int, QHash<int, qint64>> reservations; // user_id -> (product_id -> срок в мс m_clock)
+    };
+    static constexpr int kShardCount = 16;
+
+    std::shared_ptr<Counter> counter(int productId) const;
+    Shard &shardFor(int userId);
+    // Забирает одну свободную единицу; false, если их нет
+    static bool takeUnit(Counter &counter);
+
+    std::shared_ptr<const CounterMap> m_counters;
+    QMutex m_writeMutex; // сериализует замену карты счетчиков
+    std::array<Shard, kShardCount> m_shards;
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_ttlMs{15 * 60 * 1000};
+    std::atomic<quint64> m_reservations{0};
+    std::atomic<quint64> m_soldOut{0};
+    std::atomic<quint64> m_expired{0};
+};
+
+#endif // STOCKLEDGER_H
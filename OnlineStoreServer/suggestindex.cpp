@@ -0,0 +1,296 @@
+#include "suggestindex.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+// Если один массив длиннее другого во столько раз, короткий ищется в длинном двоичным поиском
+constexpr size_t kGallopRatio = 32;
+}
+
+void SuggestIndex::build(const QHash<int, CatalogProduct> &products)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Товары обходятся по возрастанию id, поэтому массивы триграмм заполняются уже отсортированными
+    QList<int> ids = products.keys();
+    std::sort(ids.begin(), ids.end());
+
+    QHash<Trigram, Postings> postings;
+    QHash<int, QString> names;
+    QHash<int, QString> normalizedNames;
+    names.reserve(ids.size());
+    normalizedNames.reserve(ids.size());
+    qint64 entries = 0;
+    for (int id : std::as_const(ids)) {
+        const QString &name = products.constFind(id)->name;
+        const QString normalized = normalize(name);
+        names.insert(id, name);
+        normalizedNames.insert(id, normalized);
+        const QList<Trigram> grams = trigrams(normalized, true);
+        for (Trigram gram : grams) {
+            postings[gram].push_back(id);
+        }
+        entries += grams.size();
+    }
+    for (Postings &list : postings) {
+        list.shrink_to_fit();
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        m_postings.swap(postings);
+        m_names.swap(names);
+        m_normalizedNames.swap(normalizedNames);
+        m_postingEntries = entries;
+    }
+    m_buildMs = timer.elapsed();
+    qInfo() << "SuggestIndex: Indexed" << ids.size() << "product name(s) in" << m_buildMs.load() << "ms";
+}
+
+void SuggestIndex::insert(int productId, const QString &name)
+{
+    QWriteLocker locker(&m_lock);
+    removeLocked(productId);
+    insertLocked(productId, name);
+    ++m_updates;
+}
+
+void SuggestIndex::remove(int productId)
+{
+    QWriteLocker locker(&m_lock);
+    removeLocked(productId);
+    ++m_updates;
+}
+
+void SuggestIndex::rename(int productId, const QString &name)
+{
+    QWriteLocker locker(&m_lock);
+    if (!m_names.contains(productId)) {
+        return;
+    }
+    removeLocked(productId);
+    insertLocked(productId, name);
+    ++m_updates;
+}
+
+void SuggestIndex::insertLocked(int productId, const QString &name)
+{
+    const QString normalized = normalize(name);
+    m_names.insert(productId, name);
+    m_normalizedNames.insert(productId, normalized);
+    const QList<Trigram> grams = trigrams(normalized, true);
+    for (Trigram gram : grams) {
+        Postings &list = m_postings[gram];
+        // Новые товары получают наибольший id, поэтому обычно это добавление в конец
+        if (list.empty() || list.back() < productId) {
+            list.push_back(productId);
+        } else {
+            auto it = std::lower_bound(list.begin(), list.end(), productId);
+            if (it == list.end() || *it != productId) {
+                list.insert(it, productId);
+            }
+        }
+    }
+    m_postingEntries += grams.size();
+}
+
+void SuggestIndex::removeLocked(int productId)
+{
+    auto nameIt = m_normalizedNames.find(productId);
+    if (nameIt == m_normalizedNames.end()) {
+        return;
+    }
+    const QList<Trigram> grams = trigrams(*nameIt, true);
+    for (Trigram gram : grams) {
+        auto listIt = m_postings.find(gram);
+        if (listIt == m_postings.end()) {
+            continue;
+        }
+        Postings &list = *listIt;
+        auto it = std::lower_bound(list.begin(), list.end(), productId);
+        if (it != list.end() && *it == productId) {
+            list.erase(it);
+        }
+        if (list.empty()) {
+            m_postings.erase(listIt);
+        }
+    }
+    m_postingEntries -= grams.size();
+    m_normalizedNames.erase(nameIt);
+    m_names.remove(productId);
+}
+
+QList<Suggestion> SuggestIndex::suggest(const QString &query, int limit) const
+{
+    ++m_queries;
+    const QString normalized = normalize(query);
+    if (normalized.isEmpty() || limit <= 0) {
+        return {};
+    }
+    const QList<Trigram> grams = trigrams(normalized, false);
+
+    QReadLocker locker(&m_lock);
+    QList<const Postings *> lists;
+    lists.reserve(grams.size());
+    for (Trigram gram : grams) {
+        auto it = m_postings.constFind(gram);
+        if (it == m_postings.constEnd()) {
+            return {};
+        }
+        lists.append(&*it);
+    }
+    // От самого короткого массива: промежуточный результат не больше него
+    std::sort(lists.begin(), lists.end(), [](const Postings *a, const Postings *b) { return a->size() < b->size(); });
+    Postings candidates = *lists.constFirst();
+    for (qsizetype i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        intersect(*lists.at(i), candidates);
+    }
+
+    // Триграммы могут совпасть в разных словах, поэтому совпадение проверяется по словам:
+    // каждое слово запроса целиком, последнее - как начало слова
+    QStringList words = normalized.split(' ');
+    const QString prefix = ' ' + words.takeLast();
+    struct Scored
+    {
+        bool startsWithQuery;
+        qsizetype length;
+        int productId;
+    };
+    std::vector<Scored> matches;
+    const size_t checked = std::min(candidates.size(), size_t(kMaxCandidates));
+    for (size_t i = 0; i < checked; ++i) {
+        const int productId = candidates[i];
+        const QString padded = ' ' + m_normalizedNames.value(productId) + ' ';
+        if (!padded.contains(prefix)) {
+            continue;
+        }
+        bool allWords = true;
+        for (const QString &word : std::as_const(words)) {
+            if (!padded.contains(' ' + word + ' ')) {
+                allWords = false;
+                break;
+            }
+        }
+        if (allWords) {
+            matches.push_back({padded.startsWith(' ' + normalized), padded.size(), productId});
+        }
+    }
+
+    const size_t count = std::min(matches.size(), size_t(limit));
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const Scored &a, const Scored &b) {
+        if (a.startsWithQuery != b.startsWithQuery) {
+            return a.startsWithQuery;
+        }
+        if (a.length != b.length) {
+            return a.length < b.length;
+        }
+        return a.productId < b.productId;
+    });
+    QList<Suggestion> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.append({matches[i].productId, m_names.value(matches[i].productId)});
+    }
+    return result;
+}
+
+void SuggestIndex::intersect(const Postings &other, Postings &result)
+{
+    size_t k = 0;
+    if (other.size() / kGallopRatio > result.size()) {
+        // Короткий список против очень длинного: двоичный поиск с продвигающейся нижней границей
+        auto from = other.begin();
+        for (int id : result) {
+            from = std::lower_bound(from, other.end(), id);
+            if (from == other.end()) {
+                break;
+            }
+            if (*from == id) {
+                result[k++] = id;
+            }
+        }
+    } else {
+        // Слияние без ветвлений по данным: оба массива читаются последовательно
+        size_t i = 0;
+        size_t j = 0;
+        while (i < result.size() && j < other.size()) {
+            const int a = result[i];
+            const int b = other[j];
+            result[k] = a;
+            k += (a == b);
+            i += (a <= b);
+            j += (b <= a);
+        }
+    }
+    result.resize(k);
+}
+
+QString SuggestIndex::normalize(const QString &text)
+{
+    QString result;
+    result.reserve(text.size());
+    bool pendingSpace = false;
+    for (QChar ch : text) {
+        if (!ch.isLetterOrNumber()) {
+            pendingSpace = !result.isEmpty();
+            continue;
+        }
+        if (pendingSpace) {
+            result.append(' ');
+            pendingSpace = false;
+        }
+        ch = ch.toLower();
+        result.append(ch == QChar(0x0451) ? QChar(0x0435) : ch); // ё -> е
+    }
+    return result;
+}
+
+QList<SuggestIndex::Trigram> SuggestIndex::trigrams(const QString &normalized, bool complete)
+{
+    QList<Trigram> result;
+    const QStringList words = normalized.split(' ', Qt::SkipEmptyParts);
+    for (qsizetype w = 0; w < words.size(); ++w) {
+        const bool last = (w == words.size() - 1);
+        const QString padded = "  " + words.at(w) + ((complete || !last) ? " " : "");
+        for (qsizetype i = 0; i + 2 < padded.size(); ++i) {
+            result.append((Trigram(padded.at(i).unicode()) << 32)
+                          | (Trigram(padded.at(i + 1).unicode()) << 16)
+                          | Trigram(padded.at(i + 2).unicode()));
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+QJsonObject SuggestIndex::stats() const
+{
+    QReadLocker locker(&m_lock);
+    qint64 postingBytes = 0;
+    for (const Postings &list : m_postings) {
+        postingBytes += qint64(list.capacity() * sizeof(int));
+    }
+    qint64 nameBytes = 0;
+    for (const QString &name : m_names) {
+        nameBytes += name.capacity() * qint64(sizeof(QChar));
+    }
+    for (const QString &name : m_normalizedNames) {
+        nameBytes += name.capacity() * qint64(sizeof(QChar));
+    }
+    // Узлы хэш-таблиц оцениваются по размеру ключа и значения
+    const qint64 tableBytes = m_postings.size() * qint64(sizeof(Trigram) + sizeof(Postings))
+                              + (m_names.size() + m_normalizedNames.size()) * qint64(sizeof(int) + sizeof(QString));
+
+    QJsonObject result;
+    result["products"] = int(m_names.size());
+    result["trigrams"] = int(m_postings.size());
+    result["posting_entries"] = m_postingEntries;
+    result["memory_bytes"] = postingBytes + nameBytes + tableBytes;
+    result["build_ms"] = m_buildMs.load();
+    result["queries"] = qint64(m_queries.load());
+    result["updates"] = qint64(m_updates.load());
+    return result;
+}
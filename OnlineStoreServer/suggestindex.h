@@ -0,0 +1,67 @@
+#ifndef SUGGESTINDEX_H
+#define SUGGESTINDEX_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QJsonObject>
+#include <atomic>
+#include <vector>
+
+#include "catalogcache.h"
+
+struct Suggestion
+{
+    int productId = 0;
+    QString name;
+};
+
+// Подсказки при наборе текста (GET /suggest) без обращения к БД: инвертированный индекс
+// триграмм по product_name активных товаров. Для каждой триграммы хранится отсортированный
+// непрерывный массив product_id; запрос пересекает массивы своих триграмм от самого короткого.
+// Слова дополняются пробелами, как в pg_trgm, поэтому недописанное последнее слово запроса
+// находит слова, которые с него начинаются.
+class SuggestIndex
+{
+public:
+    // Полная перестройка по товарам каталога
+    void build(const QHash<int, CatalogProduct> &products);
+    void insert(int productId, const QString &name);
+    void remove(int productId);
+    void rename(int productId, const QString &name);
+
+    // До limit названий, содержащих все слова запроса: сначала те, что начинаются с запроса,
+    // затем более короткие
+    QList<Suggestion> suggest(const QString &query, int limit) const;
+
+    QJsonObject stats() const;
+
+    // Больше стольких совпадений не проверяется и не ранжируется (очень короткие запросы)
+    static constexpr int kMaxCandidates = 20000;
+
+private:
+    using Trigram = quint64;   // три символа UTF-16 по 16 бит
+    using Postings = std::vector<int>;
+
+    // Строчные буквы, ё -> е, все кроме букв и цифр - пробел; слова через один пробел
+    static QString normalize(const QString &text);
+    // complete = false: последнее слово может быть недописано, триграмма с хвостовым пробелом не берется
+    static QList<Trigram> trigrams(const QString &normalized, bool complete);
+    static void intersect(const Postings &other, Postings &result);
+
+    void insertLocked(int productId, const QString &name);
+    void removeLocked(int productId);
+
+    mutable QReadWriteLock m_lock;
+    QHash<Trigram, Postings> m_postings;
+    QHash<int, QString> m_names;           // исходные названия для ответа и удаления
+    QHash<int, QString> m_normalizedNames; // для проверки совпадения и ранжирования
+    qint64 m_postingEntries = 0;
+
+    std::atomic<qint64> m_buildMs{0};
+    mutable std::atomic<quint64> m_queries{0};
+    std::atomic<quint64> m_updates{0};
+};
+
+#endif // SUGGESTINDEX_H
@@ -0,0 +1,39 @@
+#ifndef TESTDATABASE_H
+#define TESTDATABASE_H
+
+#include <QtGlobal>
+#include <QtTest>
+#include <optional>
+
+#include "databasepool.h"
+
+// Тестовая БД PostgreSQL со схемой из Queries/ (CreateTables.sql, CreateView.sql,
+// CreateFunctionsAndProcedures.sql). Задается переменными окружения ONLINESTORE_TEST_DB_NAME
+// (обязательна), ONLINESTORE_TEST_DB_HOST, ONLINESTORE_TEST_DB_PORT, ONLINESTORE_TEST_DB_USER
+// и ONLINESTORE_TEST_DB_PASSWORD.
+inline std::optional<DatabasePool::Settings> testDatabaseSettings()
+{
+    const QString dbName = qEnvironmentVariable("ONLINESTORE_TEST_DB_NAME");
+    if (dbName.isEmpty()) {
+        return std::nullopt;
+    }
+    DatabasePool::Settings settings;
+    settings.host = qEnvironmentVariable("ONLINESTORE_TEST_DB_HOST", "localhost");
+    bool portOk = false;
+    const int port = qEnvironmentVariableIntValue("ONLINESTORE_TEST_DB_PORT", &portOk);
+    settings.port = portOk ? port : 5432;
+    settings.dbName = dbName;
+    settings.userName = qEnvironmentVariable("ONLINESTORE_TEST_DB_USER", "postgres");
+    settings.password = qEnvironmentVariable("ONLINESTORE_TEST_DB_PASSWORD");
+    return settings;
+}
+
+// Тест, которому нужен PostgreSQL, пропускается, если тестовая БД не задана
+#define SKIP_WITHOUT_TEST_DATABASE() \
+    do { \
+        if (!testDatabaseSettings()) { \
+            QSKIP("ONLINESTORE_TEST_DB_NAME is not set, the test needs PostgreSQL"); \
+        } \
+    } while (false)
+
+#endif // TESTDATABASE_H
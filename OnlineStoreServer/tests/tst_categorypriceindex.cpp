@@ -0,0 +1,191 @@
+#include <QtTest>
+#include <limits>
+
+#include "catalogcache.h"
+
+class TestCategoryPriceIndex : public QObject
+{
+    Q_OBJECT
+
+private:
+    static constexpr int kMinId = std::numeric_limits<int>::min();
+    static constexpr int kMaxId = std::numeric_limits<int>::max();
+
+    // Категория 1: цены с повторами, часть товаров без остатка
+    static CatalogSnapshot makeCatalog()
+    {
+        CatalogSnapshot catalog;
+        catalog.addCategory({1, "Чай"});
+        const QList<CatalogProduct> products = {
+            {1, "A", 5.0, {}, {}, 3},
+            {2, "B", 10.0, {}, {}, 0},
+            {3, "C", 10.0, {}, {}, 2},
+            {4, "D", 20.0, {}, {}, 0},
+            {5, "E", 10.0, {}, {}, 1},
+            {6, "F", 2.5, {}, {}, 0},
+        };
+        for (const CatalogProduct &product : products) {
+            catalog.addProduct(product, {1});
+        }
+        return catalog;
+    }
+
+    static QList<int> ids(const QJsonArray &items)
+    {
+        QList<int> result;
+        for (const QJsonValue &item : items) {
+            result.append(item.toObject().value("product_id").toInt());
+        }
+        return result;
+    }
+
+private slots:
+    void emptyIndex()
+    {
+        CategoryPriceIndex index;
+        QCOMPARE(index.upperBound(10.0, 1), 0);
+        QCOMPARE(index.find(10.0, 1), -1);
+        index.remove(10.0, 1);
+        QVERIFY(index.productIds.isEmpty());
+    }
+
+    void insertOrdersByPriceThenId()
+    {
+        CategoryPriceIndex index;
+        index.insert(10.0, 5, 50);
+        index.insert(5.0, 7, 70);
+        index.insert(10.0, 2, 20);
+        index.insert(5.0, 1, 10);
+        // Повторная вставка того же товара ничего не меняет
+        index.insert(10.0, 2, 99);
+        QCOMPARE(index.prices, QList<double>({5.0, 5.0, 10.0, 10.0}));
+        QCOMPARE(index.productIds, QList<int>({1, 7, 2, 5}));
+        QCOMPARE(index.stocks, QList<int>({10, 70, 20, 50}));
+    }
+
+    void upperBoundWithDuplicatePrices()
+    {
+        CategoryPriceIndex index;
+        index.insert(5.0, 1, 0);
+        index.insert(10.0, 2, 0);
+        index.insert(10.0, 5, 0);
+        index.insert(10.0, 9, 0);
+        index.insert(20.0, 3, 0);
+        QCOMPARE(index.upperBound(10.0, kMinId), 1);
+        QCOMPARE(index.upperBound(10.0, 2), 2);
+        QCOMPARE(index.upperBound(10.0, 6), 3);
+        QCOMPARE(index.upperBound(10.0, kMaxId), 4);
+        QCOMPARE(index.upperBound(1.0, kMaxId), 0);
+        QCOMPARE(index.upperBound(20.0, 3), 5);
+        QCOMPARE(index.find(10.0, 5), 2);
+        // Товар ищется по своей текущей цене в индексе
+        QCOMPARE(index.find(5.0, 5), -1);
+    }
+
+    void removeKeepsArraysAligned()
+    {
+        CategoryPriceIndex index;
+        index.insert(10.0, 2, 20);
+        index.insert(10.0, 5, 50);
+        index.insert(5.0, 1, 10);
+        index.remove(10.0, 2);
+        index.remove(10.0, 42); // нет в индексе
+        QCOMPARE(index.prices, QList<double>({5.0, 10.0}));
+        QCOMPARE(index.productIds, QList<int>({1, 5}));
+        QCOMPARE(index.stocks, QList<int>({10, 50}));
+    }
+
+    void priceRangeIsInclusive()
+    {
+        const CatalogSnapshot catalog = makeCatalog();
+        PriceFilter filter;
+        filter.minPrice = 5.0;
+        filter.maxPrice = 10.0;
+        std::optional<ProductPageCursor> next;
+        QCOMPARE(ids(catalog.productsByPrice(1, filter, std::nullopt, 10, &next)), QList<int>({1, 2, 3, 5}));
+        QVERIFY(!next);
+    }
+
+    void emptyRange()
+    {
+        const CatalogSnapshot catalog = makeCatalog();
+        PriceFilter filter;
+        filter.minPrice = 11.0;
+        filter.maxPrice = 19.99;
+        std::optional<ProductPageCursor> next;
+        QVERIFY(catalog.productsByPrice(1, filter, std::nullopt, 10, &next).isEmpty());
+        QVERIFY(!next);
+
+        // Нижняя граница выше верхней
+        filter.minPrice = 20.0;
+        filter.maxPrice = 5.0;
+        QVERIFY(catalog.productsByPrice(1, filter, std::nullopt, 10, &next).isEmpty());
+        QVERIFY(!next);
+
+        // Неизвестная категория
+        QVERIFY(catalog.productsByPrice(2, PriceFilter(), std::nullopt, 10, &next).isEmpty());
+    }
+
+    void inStockOnly()
+    {
+        const CatalogSnapshot catalog = makeCatalog();
+        PriceFilter filter;
+        filter.inStockOnly = true;
+        std::optional<ProductPageCursor> next;
+        QCOMPARE(ids(catalog.productsByPrice(1, filter, std::nullopt, 10, &next)), QList<int>({1, 3, 5}));
+    }
+
+    void inStockPageEndingOnLastInStockHasNoCursor()
+    {
+        const CatalogSnapshot catalog = makeCatalog();
+        PriceFilter filter;
+        filter.inStockOnly = true;
+        std::optional<ProductPageCursor> next;
+        // После товара 5 в срезе остается только товар 4 без остатка
+        QCOMPARE(ids(catalog.productsByPrice(1, filter, std::nullopt, 3, &next)), QList<int>({1, 3, 5}));
+        QVERIFY(!next);
+
+        QCOMPARE(ids(catalog.productsByPrice(1, filter, std::nullopt, 2, &next)), QList<int>({1, 3}));
+        QVERIFY(next);
+        QCOMPARE(next->id, 3);
+        const std::optional<ProductPageCursor> after = next;
+        QCOMPARE(ids(catalog.productsByPrice(1, filter, after, 1, &next)), QList<int>({5}));
+        QVERIFY(!next);
+    }
+
+    void pagesAcrossDuplicatePrices()
+    {
+        const CatalogSnapshot catalog = makeCatalog();
+        std::optional<ProductPageCursor> next;
+        QList<int> all;
+        std::optional<ProductPageCursor> after;
+        int pages = 0;
+        do {
+            const QJsonArray items = catalog.productsByPrice(1, PriceFilter(), after, 2, &next);
+            all += ids(items);
+            after = next;
+            ++pages;
+        } while (next && pages < 10);
+        QCOMPARE(all, QList<int>({6, 1, 2, 3, 5, 4}));
+        // Последняя страница заполнена целиком, но курсора после нее нет
+        QCOMPARE(pages, 3);
+    }
+
+    void stockAndPriceChangesUpdateIndex()
+    {
+        CatalogSnapshot catalog = makeCatalog();
+        catalog.setProductStock(2, 4);
+        catalog.setProductStock(3, 0);
+        catalog.setProductPrice(5, 1.004); // цена округляется до копеек, как в БД
+        const CategoryPriceIndex &index = catalog.productsByCategoryPrice.value(1);
+        QCOMPARE(index.productIds, QList<int>({5, 6, 1, 2, 3, 4}));
+        QCOMPARE(index.prices.constFirst(), 1.0);
+        QCOMPARE(index.stocks, QList<int>({1, 0, 3, 4, 0, 0}));
+
+        catalog.removeProduct(1);
+        QCOMPARE(catalog.productsByCategoryPrice.value(1).productIds, QList<int>({5, 6, 2, 3, 4}));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestCategoryPriceIndex)
+#include "tst_categorypriceindex.moc"
@@ -0,0 +1,302 @@
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QThread>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "databasehandler.h"
+#include "testdatabase.h"
+
+// Строки, которые создает тест, начинаются с этого префикса и удаляются в cleanupTestCase
+static const QString kPrefix = QStringLiteral("tst_databasehandler_");
+static const QString kSetupConnection = QStringLiteral("tst_databasehandler_setup");
+
+class TestDatabaseHandler : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Отдельное соединение теста: данные готовятся и проверяются мимо DatabaseHandler
+    static QSqlDatabase setupDb() { return QSqlDatabase::database(kSetupConnection); }
+
+    static bool connectHandler(DatabaseHandler &handler)
+    {
+        const DatabasePool::Settings settings = *testDatabaseSettings();
+        handler.setPoolSettings(settings);
+        return handler.connectToDatabase(settings.host, settings.port, settings.dbName,
+                                         settings.userName, settings.password);
+    }
+
+    static int insertRow(const QString &sql, const QString &name)
+    {
+        QSqlQuery query(setupDb());
+        query.prepare(sql);
+        query.bindValue(":name", kPrefix + name);
+        if (!query.exec() || !query.next()) {
+            qWarning() << "Failed to insert test row:" << query.lastError().text();
+            return -1;
+        }
+        return query.value(0).toInt();
+    }
+
+    static int insertUser(const QString &name)
+    {
+        return insertRow("INSERT INTO Users (user_name, user_role, user_password) "
+                         "VALUES (:name, 'user', 'x') RETURNING user_id", name);
+    }
+
+    static int insertProduct(const QString &name, int stock = 1)
+    {
+        return insertRow(QString("INSERT INTO Products (product_name, product_price, product_stock) "
+                                 "VALUES (:name, 1, %1) RETURNING product_id").arg(stock), name);
+    }
+
+    static int insertCategory(const QString &name)
+    {
+        return insertRow("INSERT INTO Categories (category_name) VALUES (:name) RETURNING category_id", name);
+    }
+
+    static QJsonObject productJson(const QString &name, double price, const QJsonArray &categoryIds = {})
+    {
+        QJsonObject product;
+        product["product_name"] = kPrefix + name;
+        product["product_price"] = price;
+        product["category_ids"] = categoryIds;
+        return product;
+    }
+
+    static int cartRows(int userId)
+    {
+        QSqlQuery query(setupDb());
+        query.prepare("SELECT count(*) FROM Cart WHERE user_id = :userId");
+        query.bindValue(":userId", userId);
+        return query.exec() && query.next() ? query.value(0).toInt() : -1;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        const std::optional<DatabasePool::Settings> settings = testDatabaseSettings();
+        if (!settings) {
+            return;
+        }
+        QSqlDatabase db = QSqlDatabase::addDatabase("QPSQL", kSetupConnection);
+        db.setHostName(settings->host);
+        db.setPort(settings->port);
+        db.setDatabaseName(settings->dbName);
+        db.setUserName(settings->userName);
+        db.setPassword(settings->password);
+        QVERIFY2(db.open(), qPrintable(db.lastError().text()));
+    }
+
+    void cleanupTestCase()
+    {
+        if (!QSqlDatabase::contains(kSetupConnection)) {
+            return;
+        }
+        {
+            QSqlQuery query(setupDb());
+            query.exec(QString("DELETE FROM Users WHERE user_name LIKE '%1%'").arg(kPrefix));
+            query.exec(QString("DELETE FROM Products WHERE product_name LIKE '%1%'").arg(kPrefix));
+            query.exec(QString("DELETE FROM Categories WHERE category_name LIKE '%1%'").arg(kPrefix));
+        }
+        QSqlDatabase::removeDatabase(kSetupConnection);
+    }
+
+    void loginChecksPgcryptoHash()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        // Хеш создает pgcrypto, как при заполнении Users, а проверяет сервер
+        QSqlQuery query(setupDb());
+        QVERIFY2(query.exec(QString("INSERT INTO Users (user_name, user_role, user_password) "
+                                    "VALUES ('%1login_user', 'admin', crypt('secret', gen_salt('bf', 8))) "
+                                    "RETURNING user_id").arg(kPrefix)),
+                 qPrintable(query.lastError().text()));
+        QVERIFY(query.next());
+        const int userId = query.value(0).toInt();
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        const QJsonObject user = handler.authenticateUser(kPrefix + "login_user", "secret");
+        QCOMPARE(user.value("user_id").toInt(), userId);
+        QCOMPARE(user.value("user_role").toString(), QString("admin"));
+        QVERIFY(handler.authenticateUser(kPrefix + "login_user", "Secret").isEmpty());
+        QVERIFY(handler.authenticateUser(kPrefix + "missing_user", "secret").isEmpty());
+        // Проверка bcrypt идет после возврата соединения в пул
+        QCOMPARE(handler.poolStats().value("in_use").toInt(), 0);
+    }
+
+    void cartRejectsUnknownIdsWithoutDatabase()
+    {
+        // Карты id пусты: отказ приходит из памяти, соединение даже не запрашивается
+        DatabaseHandler handler;
+        QCOMPARE(handler.addToCart(1, 1), DbStatus::NotFound);
+        QCOMPARE(handler.addToCart(-1, 1), DbStatus::NotFound);
+        QCOMPARE(handler.addToCart(1, std::numeric_limits<int>::max()), DbStatus::NotFound);
+        QCOMPARE(handler.poolStats().value("acquisitions").toInt(), 0);
+    }
+
+    void cartRejectsUnknownIds()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        const int userId = insertUser("cart_user");
+        const int productId = insertProduct("cart_product");
+        QVERIFY(userId > 0 && productId > 0);
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        QCOMPARE(handler.addToCart(userId, productId), DbStatus::Ok);
+        // Повторное добавление того же товара не ошибка
+        QCOMPARE(handler.addToCart(userId, productId), DbStatus::Ok);
+        QCOMPARE(handler.addToCart(userId, 0), DbStatus::NotFound);
+        QCOMPARE(handler.addToCart(userId, -productId), DbStatus::NotFound);
+        QCOMPARE(handler.addToCart(0, productId), DbStatus::NotFound);
+        QCOMPARE(cartRows(userId), 1);
+    }
+
+    void cartRejectsRowDeletedAfterLoad()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        const int userId = insertUser("stale_user");
+        const int productId = insertProduct("stale_product");
+        QVERIFY(userId > 0 && productId > 0);
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        const int knownProducts = handler.idIndexStats().value("products").toObject().value("count").toInt();
+
+        // Товар удален в обход сервера: карта id еще считает его существующим
+        QSqlQuery query(setupDb());
+        query.prepare("DELETE FROM Products WHERE product_id = :productId");
+        query.bindValue(":productId", productId);
+        QVERIFY(query.exec());
+
+        // Вставку отклоняет внешний ключ Cart, а устаревший бит снимается
+        QCOMPARE(handler.addToCart(userId, productId), DbStatus::NotFound);
+        QCOMPARE(handler.idIndexStats().value("products").toObject().value("count").toInt(), knownProducts - 1);
+        QCOMPARE(handler.addToCart(userId, productId), DbStatus::NotFound);
+        QCOMPARE(cartRows(userId), 0);
+    }
+
+    void batchReportsConflictsPerItem()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        const int existingId = insertProduct("batch_existing");
+        const int categoryId = insertCategory("batch_category");
+        QVERIFY(existingId > 0 && categoryId > 0);
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        QJsonObject withStock = productJson("batch_c", 7);
+        withStock["product_stock"] = 2;
+        const QJsonArray batch = {
+            productJson("batch_a", 10, {categoryId, std::numeric_limits<int>::max()}),
+            productJson("batch_existing", 5),
+            productJson("batch_b", 0),
+            productJson("batch_a", 3),
+            withStock,
+        };
+        const QList<ProductInsertResult> results = handler.addProducts(batch);
+
+        // Отказы по отдельным элементам не отменяют остальные; результаты в порядке пакета
+        QCOMPARE(results.size(), 5);
+        QCOMPARE(results.at(0).status, DbStatus::Ok);
+        QCOMPARE(results.at(1).status, DbStatus::Conflict);
+        QCOMPARE(results.at(2).status, DbStatus::Invalid);
+        QCOMPARE(results.at(3).status, DbStatus::Conflict);
+        QCOMPARE(results.at(4).status, DbStatus::Ok);
+        QCOMPARE(results.at(1).productId, -1);
+        QVERIFY(!results.at(1).error.isEmpty() && !results.at(3).error.isEmpty());
+
+        const CatalogCache::SnapshotPtr catalog = handler.catalogSnapshot();
+        const int firstId = results.at(0).productId;
+        const int lastId = results.at(4).productId;
+        QVERIFY(firstId > 0 && lastId > 0 && firstId != lastId);
+        // Несуществующая категория отброшена, существующая связана
+        QCOMPARE(catalog->categoriesByProduct.value(firstId), QList<int>({categoryId}));
+        QCOMPARE(catalog->products.value(firstId).price, 10.0);
+        QCOMPARE(catalog->products.value(lastId).stock, 2);
+        // Товар с занятым именем не изменился
+        QCOMPARE(catalog->products.value(existingId).price, 1.0);
+
+        QSqlQuery query(setupDb());
+        QVERIFY(query.exec(QString("SELECT count(*) FROM Products WHERE product_name LIKE '%1batch_%'").arg(kPrefix)));
+        QVERIFY(query.next());
+        QCOMPARE(query.value(0).toInt(), 3);
+    }
+
+    void searchRanksByRelevanceNotAge()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        // Слово в названии весит больше, чем в описании, хотя товар старше
+        QSqlQuery query(setupDb());
+        QVERIFY(query.exec(QString("INSERT INTO Products (product_name, product_price, product_description) VALUES "
+                                   "('%1 зонтик', 1, 'складной'), ('%1 сумка', 1, 'к ней подходит зонтик') "
+                                   "RETURNING product_id").arg(kPrefix + "search")));
+        QVERIFY(query.next());
+        const int byName = query.value(0).toInt();
+        QVERIFY(query.next());
+        const int byDescription = query.value(0).toInt();
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        const SearchResult first = handler.searchProducts("зонтик", std::nullopt, 1);
+        QVERIFY(first.ok);
+        QCOMPARE(first.items.size(), 1);
+        QCOMPARE(first.items.at(0).toObject().value("product_id").toInt(), byName);
+        QVERIFY(first.next);
+        const SearchResult second = handler.searchProducts("зонтик", first.next, 1);
+        QVERIFY(second.ok);
+        QCOMPARE(second.items.size(), 1);
+        QCOMPARE(second.items.at(0).toObject().value("product_id").toInt(), byDescription);
+    }
+
+    void concurrentOrdersForOneProduct()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+        constexpr int kBuyers = 8;
+        const int productId = insertProduct("hot_product", kBuyers);
+        QVERIFY(productId > 0);
+        QList<int> userIds;
+        for (int i = 0; i < kBuyers + 1; ++i) {
+            userIds.append(insertUser(QString("hot_user_%1").arg(i)));
+            QVERIFY(userIds.last() > 0);
+        }
+
+        DatabaseHandler handler;
+        QVERIFY(connectHandler(handler));
+        for (int i = 0; i < kBuyers; ++i) {
+            QCOMPARE(handler.addToCart(userIds.at(i), productId), DbStatus::Ok);
+        }
+        QCOMPARE(handler.addToCart(userIds.last(), productId), DbStatus::SoldOut);
+
+        // Заказы на один товар одновременно ждут блокировку его строки: ни один не получает отказ
+        std::vector<DbStatus> statuses(kBuyers, DbStatus::Error);
+        std::vector<std::unique_ptr<QThread>> threads;
+        for (int i = 0; i < kBuyers; ++i) {
+            threads.emplace_back(QThread::create([&, i]() { statuses[i] = handler.placeOrder(userIds.at(i)); }));
+            threads.back()->start();
+        }
+        for (const auto &thread : threads) {
+            QVERIFY(thread->wait(30000));
+        }
+        for (int i = 0; i < kBuyers; ++i) {
+            QCOMPARE(statuses[i], DbStatus::Ok);
+            QCOMPARE(cartRows(userIds.at(i)), 0);
+        }
+
+        QSqlQuery query(setupDb());
+        query.prepare("SELECT product_stock FROM Products WHERE product_id = :productId");
+        query.bindValue(":productId", productId);
+        QVERIFY(query.exec() && query.next());
+        QCOMPARE(query.value(0).toInt(), 0);
+        QCOMPARE(handler.publishStock(), 1);
+        QCOMPARE(handler.catalogSnapshot()->products.value(productId).stock, 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestDatabaseHandler)
+#include "tst_databasehandler.moc"
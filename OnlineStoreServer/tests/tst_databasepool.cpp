@@ -0,0 +1,204 @@
+#include <QtTest>
+#include <QSemaphore>
+#include <QSqlQuery>
+#include <QThread>
+#include <memory>
+
+#include "databasepool.h"
+#include "testdatabase.h"
+
+class TestDatabasePool : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Поток, который держит соединение пула, пока тест не отпустит его через release
+    struct Holder
+    {
+        std::unique_ptr<QThread> thread;
+        QString connectionName;
+    };
+
+    static void startHolder(DatabasePool &pool, Holder &holder, QSemaphore &acquired, QSemaphore &release)
+    {
+        holder.thread.reset(QThread::create([&pool, &holder, &acquired, &release] {
+            PooledConnection connection = pool.acquire();
+            holder.connectionName = connection.database().connectionName();
+            acquired.release();
+            release.acquire();
+        }));
+        holder.thread->start();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        SKIP_WITHOUT_TEST_DATABASE();
+    }
+
+    void warmUpOpensMinSize()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 3;
+        settings.maxSize = 4;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+        const QJsonObject stats = pool.stats();
+        QCOMPARE(stats.value("open_connections").toInt(), 3);
+        QCOMPARE(stats.value("idle").toInt(), 3);
+        QCOMPARE(stats.value("in_use").toInt(), 0);
+    }
+
+    void nestedAcquireSharesConnection()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 1;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+
+        PooledConnection outer = pool.acquire();
+        QVERIFY(outer.isValid());
+        {
+            // Вложенный вызов в том же потоке работает в той же транзакции
+            PooledConnection inner = pool.acquire();
+            QVERIFY(inner.isValid());
+            QCOMPARE(inner.database().connectionName(), outer.database().connectionName());
+            QCOMPARE(pool.stats().value("in_use").toInt(), 1);
+        }
+        // Конец вложенной выдачи не возвращает соединение в пул
+        QCOMPARE(pool.stats().value("in_use").toInt(), 1);
+        QVERIFY(outer.database().isOpen());
+    }
+
+    void exhaustedPoolTimesOut()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 1;
+        settings.maxSize = 2;
+        settings.acquireTimeoutMs = 200;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+
+        // Соединения заняты другими потоками: в своем потоке выдача была бы вложенной
+        QSemaphore acquired;
+        QSemaphore release;
+        Holder holders[2];
+        for (Holder &holder : holders) {
+            startHolder(pool, holder, acquired, release);
+        }
+        QVERIFY(acquired.tryAcquire(2, 5000));
+        QVERIFY(holders[0].connectionName != holders[1].connectionName);
+
+        QElapsedTimer timer;
+        timer.start();
+        {
+            PooledConnection extra = pool.acquire();
+            QVERIFY(!extra.isValid());
+        }
+        QVERIFY(timer.elapsed() >= settings.acquireTimeoutMs);
+        QJsonObject stats = pool.stats();
+        QCOMPARE(stats.value("acquire_timeouts").toInt(), 1);
+        QCOMPARE(stats.value("open_connections").toInt(), 2);
+        QCOMPARE(stats.value("in_use").toInt(), 2);
+
+        release.release(2);
+        for (Holder &holder : holders) {
+            QVERIFY(holder.thread->wait(5000));
+        }
+        stats = pool.stats();
+        QCOMPARE(stats.value("in_use").toInt(), 0);
+        QCOMPARE(stats.value("idle").toInt(), 2);
+    }
+
+    void waiterGetsReleasedConnection()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 1;
+        settings.maxSize = 1;
+        settings.acquireTimeoutMs = 5000;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+
+        QSemaphore acquired;
+        QSemaphore release;
+        Holder holder;
+        startHolder(pool, holder, acquired, release);
+        QVERIFY(acquired.tryAcquire(1, 5000));
+
+        // Соединение освобождается, пока основной поток ждет в acquire()
+        std::unique_ptr<QThread> releaser(QThread::create([&release] {
+            QThread::msleep(100);
+            release.release();
+        }));
+        releaser->start();
+
+        QElapsedTimer timer;
+        timer.start();
+        {
+            PooledConnection connection = pool.acquire();
+            QVERIFY(connection.isValid());
+            QVERIFY(timer.elapsed() >= 50);
+            // Новое соединение сверх maxSize не открывалось: ожидающий получил освободившееся
+            QCOMPARE(connection.database().connectionName(), holder.connectionName);
+        }
+        QVERIFY(holder.thread->wait(5000));
+        QVERIFY(releaser->wait(5000));
+        const QJsonObject stats = pool.stats();
+        QCOMPARE(stats.value("acquire_timeouts").toInt(), 0);
+        QCOMPARE(stats.value("open_connections").toInt(), 1);
+    }
+
+    void releaseRollsBackOpenTransaction()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 1;
+        settings.maxSize = 1;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+
+        {
+            // Обработчик забыл COMMIT: временная таблица существует только внутри транзакции
+            PooledConnection connection = pool.acquire();
+            QSqlQuery query(connection.database());
+            QVERIFY(query.exec("BEGIN"));
+            QVERIFY(query.exec("CREATE TEMP TABLE tst_pool_uncommitted (id INT)"));
+        }
+        QCOMPARE(pool.stats().value("release_rollbacks").toInt(), 1);
+
+        PooledConnection connection = pool.acquire();
+        QSqlQuery query(connection.database());
+        QVERIFY(query.exec("SELECT to_regclass('pg_temp.tst_pool_uncommitted') IS NULL"));
+        QVERIFY(query.next());
+        QVERIFY(query.value(0).toBool());
+        // То же соединение, а не новое: откат вернул его в пул
+        QCOMPARE(pool.stats().value("connection_opens").toInt(), 0);
+    }
+
+    void refillsToMinSize()
+    {
+        DatabasePool::Settings settings = *testDatabaseSettings();
+        settings.minSize = 2;
+        settings.maxSize = 4;
+        DatabasePool pool;
+        pool.setSettings(settings);
+        QVERIFY(pool.warmUp());
+
+        {
+            // Соединение, закрытое во время работы, при возврате отбрасывается
+            PooledConnection connection = pool.acquire();
+            connection.database().close();
+        }
+        const QJsonObject stats = pool.stats();
+        QCOMPARE(stats.value("open_connections").toInt(), 2);
+        QCOMPARE(stats.value("idle").toInt(), 2);
+        QCOMPARE(stats.value("refills").toInt(), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestDatabasePool)
+#include "tst_databasepool.moc"
@@ -0,0 +1,147 @@
+#include <QtTest>
+#include <QThread>
+#include <atomic>
+
+#include "exportpipe.h"
+
+// Читатель выгрузки: считает уведомления, которые ExportPipe ставит в очередь событий
+class PipeReader : public QObject
+{
+    Q_OBJECT
+public:
+    int notifications = 0;
+
+public slots:
+    void onData() { ++notifications; }
+};
+
+class TestExportPipe : public QObject
+{
+    Q_OBJECT
+
+private:
+    static bool never() { return false; }
+
+private slots:
+    void takeRespectsMaxBytes()
+    {
+        ExportPipe pipe(1024, 1000);
+        QVERIFY(pipe.write("aaaa", never));
+        QVERIFY(pipe.write("bbbb", never));
+        QVERIFY(pipe.write("cccc", never));
+
+        bool finished = true;
+        QCOMPARE(pipe.take(8, &finished), QByteArray("aaaabbbb"));
+        QVERIFY(!finished);
+        // Блок больше лимита все равно отдается целиком, иначе выгрузка остановилась бы
+        QCOMPARE(pipe.take(1, &finished), QByteArray("cccc"));
+        QVERIFY(!finished);
+        QCOMPARE(pipe.take(8, &finished), QByteArray());
+        QVERIFY(!finished);
+
+        pipe.finish(true);
+        QCOMPARE(pipe.take(8, &finished), QByteArray());
+        QVERIFY(finished);
+        QVERIFY(pipe.isOk());
+    }
+
+    void finishedOnlyAfterLastChunk()
+    {
+        ExportPipe pipe(1024, 1000);
+        pipe.write("aaaa", never);
+        pipe.write("bbbb", never);
+        pipe.finish(false);
+        bool finished = true;
+        QCOMPARE(pipe.take(4, &finished), QByteArray("aaaa"));
+        QVERIFY(!finished);
+        QCOMPARE(pipe.take(4, &finished), QByteArray("bbbb"));
+        QVERIFY(finished);
+        QVERIFY(!pipe.isOk());
+    }
+
+    void oversizedChunkFitsEmptyPipe()
+    {
+        ExportPipe pipe(4, 1000);
+        QVERIFY(pipe.write("0123456789", never));
+        bool finished = false;
+        QCOMPARE(pipe.take(4, &finished), QByteArray("0123456789"));
+    }
+
+    void fullPipeStopsOnCancel()
+    {
+        ExportPipe pipe(8, 60 * 1000);
+        QVERIFY(pipe.write("12345678", never));
+        QVERIFY(!pipe.write("9", [] { return true; }));
+    }
+
+    void fullPipeStopsOnStall()
+    {
+        // Читатель ничего не забирает дольше stallTimeoutMs: производитель сдается
+        ExportPipe pipe(8, 50);
+        QVERIFY(pipe.write("12345678", never));
+        QElapsedTimer timer;
+        timer.start();
+        QVERIFY(!pipe.write("9", never));
+        QVERIFY(timer.elapsed() >= 50);
+    }
+
+    void writerResumesAfterTake()
+    {
+        ExportPipe pipe(8, 10 * 1000);
+        QVERIFY(pipe.write("12345678", never));
+        std::atomic<bool> written{false};
+        std::atomic<bool> result{false};
+        QScopedPointer<QThread> writer(QThread::create([&] {
+            result = pipe.write("9", never);
+            written = true;
+        }));
+        writer->start();
+        // Буфер полон: производитель ждет, пока читатель не заберет данные
+        QTest::qWait(150);
+        QVERIFY(!written);
+
+        bool finished = false;
+        QCOMPARE(pipe.take(8, &finished), QByteArray("12345678"));
+        QVERIFY(writer->wait(5000));
+        QVERIFY(result);
+        QCOMPARE(pipe.take(8, &finished), QByteArray("9"));
+    }
+
+    void closeReaderReleasesWriter()
+    {
+        ExportPipe pipe(8, 10 * 1000);
+        QVERIFY(pipe.write("12345678", never));
+        std::atomic<bool> result{true};
+        QScopedPointer<QThread> writer(QThread::create([&] { result = pipe.write("9", never); }));
+        writer->start();
+        QTest::qWait(50);
+        pipe.closeReader();
+        QVERIFY(writer->wait(5000));
+        QVERIFY(!result);
+        // После закрытия читателя запись сразу отклоняется, а буфер пуст
+        QVERIFY(!pipe.write("x", never));
+        bool finished = false;
+        QCOMPARE(pipe.take(8, &finished), QByteArray());
+    }
+
+    void readerIsNotified()
+    {
+        ExportPipe pipe(1024, 1000);
+        PipeReader reader;
+        // Данные, пришедшие раньше читателя, тоже вызывают уведомление
+        pipe.write("a", never);
+        pipe.setReader(&reader, "onData");
+        QTRY_COMPARE(reader.notifications, 1);
+        pipe.write("b", never);
+        pipe.finish(true);
+        QTRY_COMPARE(reader.notifications, 3);
+
+        pipe.closeReader();
+        pipe.write("c", never);
+        QTest::qWait(20);
+        QCOMPARE(reader.notifications, 3);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestExportPipe)
+#include "tst_exportpipe.moc"
@@ -0,0 +1,45 @@
+#include <QtTest>
+
+#include "passwordverifier.h"
+
+// Хеши в формате crypt(password, gen_salt('bf', 8)) из pgcrypto, как в Queries/InitialFilling.sql
+static const QByteArray kSimpleHash = "$2a$08$nbnTtF2gHwZBkfYPZKsNpuc2ZAB6EluQ7FI0PZfxAFvckcp5ym6mq";  // simplepassword
+static const QByteArray kCyrillicHash = "$2a$08$tmcwg3n/xlIPphuK9Ux4UOloRH05POzwjlEbcJVyFlnI2yZDcb3CO"; // пароль
+
+class TestPasswordVerifier : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void acceptsMatchingPassword()
+    {
+        QVERIFY(PasswordVerifier::verify("simplepassword", kSimpleHash));
+        QVERIFY(PasswordVerifier::verify(QString("пароль").toUtf8(), kCyrillicHash));
+    }
+
+    void rejectsWrongPassword()
+    {
+        QVERIFY(!PasswordVerifier::verify("simplepassworD", kSimpleHash));
+        QVERIFY(!PasswordVerifier::verify("", kSimpleHash));
+        // Ноль внутри пароля обрезал бы его для crypt_r
+        QVERIFY(!PasswordVerifier::verify(QByteArray("simplepassword\0x", 16), kSimpleHash));
+    }
+
+    void rejectsForeignHashes()
+    {
+        QVERIFY(!PasswordVerifier::verify("simplepassword", "simplepassword"));
+        QVERIFY(!PasswordVerifier::verify("simplepassword", "$1$abcdefgh$abcdefghijklmnopqrstuv"));
+        QVERIFY(!PasswordVerifier::verify("simplepassword", kSimpleHash.left(40)));
+        QVERIFY(!PasswordVerifier::verify("simplepassword", QByteArray()));
+    }
+
+    void dummyCheckDoesNotThrow()
+    {
+        PasswordVerifier::verifyDummy("anything");
+        // Поток, уже считавший фиктивный хеш, проверяет настоящие как обычно
+        QVERIFY(PasswordVerifier::verify("simplepassword", kSimpleHash));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestPasswordVerifier)
+#include "tst_passwordverifier.moc"
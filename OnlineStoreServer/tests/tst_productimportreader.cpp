@@ -0,0 +1,150 @@
+#include <QtTest>
+#include <QBuffer>
+
+#include "productimportreader.h"
+
+// Строка COPY или причина отказа для одной записи файла
+struct ReadResult
+{
+    QByteArray row;
+    QString reject;
+};
+
+class TestProductImportReader : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QList<ReadResult> readAll(const QByteArray &data, ProductImportReader::Format format,
+                                     QString *error = nullptr)
+    {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        ProductImportReader reader(&buffer, format);
+        QList<ReadResult> results;
+        ReadResult result;
+        while (reader.next(&result.row, &result.reject)) {
+            results.append(result);
+        }
+        if (error) {
+            *error = reader.error();
+        }
+        return results;
+    }
+
+private slots:
+    void formatFromString()
+    {
+        QVERIFY(ProductImportReader::formatFromString("NDJSON") == ProductImportReader::Format::Ndjson);
+        QVERIFY(ProductImportReader::formatFromString("csv") == ProductImportReader::Format::Csv);
+        QVERIFY(!ProductImportReader::formatFromString("xml"));
+    }
+
+    void ndjsonRecord()
+    {
+        const QList<ReadResult> results = readAll(
+            "{\"product_name\":\"Чай\",\"product_price\":12.5,\"product_description\":\"Листовой\","
+            "\"product_image_path\":\"/images/tea.png\",\"product_stock\":3,\"category_ids\":[1,2]}\n",
+            ProductImportReader::Format::Ndjson);
+        QCOMPARE(results.size(), 1);
+        QVERIFY(results.at(0).reject.isEmpty());
+        QCOMPARE(results.at(0).row, QByteArray("1\tЧай\t12.50\tЛистовой\t/images/tea.png\t3\t{1,2}\n"));
+    }
+
+    void ndjsonWithoutStockIsNull()
+    {
+        // Отсутствующий остаток - NULL: при слиянии остаток существующего товара не меняется
+        const QList<ReadResult> results = readAll("{\"product_name\":\"Чай\",\"product_price\":\"7\"}",
+                                                  ProductImportReader::Format::Ndjson);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).row, QByteArray("1\tЧай\t7.00\t\t\t\\N\t{}\n"));
+    }
+
+    void ndjsonEscapesCopyText()
+    {
+        const QList<ReadResult> results = readAll(
+            "{\"product_name\":\"a\\tb\",\"product_price\":1,\"product_description\":\"x\\\\y\\nz\"}\n",
+            ProductImportReader::Format::Ndjson);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).row, QByteArray("1\ta\\tb\t1.00\tx\\\\y\\nz\t\t\\N\t{}\n"));
+    }
+
+    void ndjsonSkipsBlankLines()
+    {
+        const QList<ReadResult> results = readAll("\n{\"product_name\":\"A\",\"product_price\":1}\n\n"
+                                                  "{\"product_name\":\"B\",\"product_price\":2}\n",
+                                                  ProductImportReader::Format::Ndjson);
+        QCOMPARE(results.size(), 2);
+        QVERIFY(results.at(0).row.startsWith("1\tA\t"));
+        QVERIFY(results.at(1).row.startsWith("2\tB\t"));
+    }
+
+    void ndjsonRejects_data()
+    {
+        QTest::addColumn<QByteArray>("line");
+        QTest::newRow("invalid json") << QByteArray("{\"product_name\":");
+        QTest::newRow("not an object") << QByteArray("[1, 2]");
+        QTest::newRow("empty name") << QByteArray("{\"product_name\":\" \",\"product_price\":1}");
+        QTest::newRow("zero price") << QByteArray("{\"product_name\":\"A\",\"product_price\":0}");
+        QTest::newRow("price overflow") << QByteArray("{\"product_name\":\"A\",\"product_price\":100000000}");
+        QTest::newRow("negative stock") << QByteArray("{\"product_name\":\"A\",\"product_price\":1,\"product_stock\":-1}");
+        QTest::newRow("bad category") << QByteArray("{\"product_name\":\"A\",\"product_price\":1,\"category_ids\":[0]}");
+    }
+
+    void ndjsonRejects()
+    {
+        QFETCH(QByteArray, line);
+        // Отклоненная запись не прерывает чтение: следующая запись файла читается как обычно
+        const QList<ReadResult> results = readAll(line + "\n{\"product_name\":\"B\",\"product_price\":2}\n",
+                                                  ProductImportReader::Format::Ndjson);
+        QCOMPARE(results.size(), 2);
+        QVERIFY(results.at(0).row.isEmpty());
+        QVERIFY(!results.at(0).reject.isEmpty());
+        QVERIFY(results.at(1).reject.isEmpty());
+        QVERIFY(results.at(1).row.startsWith("2\tB\t"));
+    }
+
+    void csvRecords()
+    {
+        const QList<ReadResult> results = readAll(
+            "Product_Name,product_price,product_stock,category_ids\r\n"
+            "\"Чай, черный\",10,,1;2\r\n"
+            "Кофе,5.5,4,\r\n",
+            ProductImportReader::Format::Csv);
+        QCOMPARE(results.size(), 2);
+        QCOMPARE(results.at(0).row, QByteArray("1\tЧай, черный\t10.00\t\t\t\\N\t{1,2}\n"));
+        QCOMPARE(results.at(1).row, QByteArray("2\tКофе\t5.50\t\t\t4\t{}\n"));
+    }
+
+    void csvQuotedMultilineField()
+    {
+        const QList<ReadResult> results = readAll(
+            "product_name,product_description,product_price\n"
+            "A,\"первая строка\nвторая \"\"в кавычках\"\"\",3\n",
+            ProductImportReader::Format::Csv);
+        QCOMPARE(results.size(), 1);
+        QCOMPARE(results.at(0).row, QByteArray("1\tA\t3.00\tпервая строка\\nвторая \"в кавычках\"\t\t\\N\t{}\n"));
+    }
+
+    void csvRejectsBadCategory()
+    {
+        const QList<ReadResult> results = readAll("product_name,product_price,category_ids\nA,1,x\n",
+                                                  ProductImportReader::Format::Csv);
+        QCOMPARE(results.size(), 1);
+        QVERIFY(results.at(0).row.isEmpty());
+        QVERIFY(!results.at(0).reject.isEmpty());
+    }
+
+    void csvHeaderErrors()
+    {
+        QString error;
+        QVERIFY(readAll("", ProductImportReader::Format::Csv, &error).isEmpty());
+        QCOMPARE(error, QString("CSV file is empty."));
+        QVERIFY(readAll("name,price\nA,1\n", ProductImportReader::Format::Csv, &error).isEmpty());
+        QVERIFY(!error.isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestProductImportReader)
+#include "tst_productimportreader.moc"
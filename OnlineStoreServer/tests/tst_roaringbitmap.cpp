@@ -0,0 +1,167 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <set>
+
+#include "roaringbitmap.h"
+
+class TestRoaringBitmap : public QObject
+{
+    Q_OBJECT
+
+private:
+    static RoaringBitmap fromSet(const std::set<quint32> &values)
+    {
+        RoaringBitmap bitmap;
+        for (quint32 value : values) {
+            bitmap.add(value);
+        }
+        return bitmap;
+    }
+
+    static QList<int> allValues(const RoaringBitmap &bitmap)
+    {
+        bool more = false;
+        return bitmap.values(-1, std::numeric_limits<int>::max(), &more);
+    }
+
+    static QList<int> toList(const std::set<quint32> &values)
+    {
+        QList<int> result;
+        for (quint32 value : values) {
+            result.append(int(value));
+        }
+        return result;
+    }
+
+    // Значения в нескольких блоках по 65536: плотные (битовые карты) и редкие (массивы)
+    static std::set<quint32> randomSet(QRandomGenerator &random, int count)
+    {
+        std::set<quint32> values;
+        while (int(values.size()) < count) {
+            // Половина значений - в плотный блок 0
+            const quint32 block = random.bounded(2u) == 0 ? 0u : 1u + random.bounded(3u);
+            const quint32 spread = block == 0 ? 6000u : 65536u;
+            values.insert(block * 65536u + random.bounded(spread));
+        }
+        return values;
+    }
+
+private slots:
+    void emptyBitmap()
+    {
+        RoaringBitmap bitmap;
+        QVERIFY(bitmap.isEmpty());
+        QCOMPARE(bitmap.cardinality(), qint64(0));
+        QVERIFY(!bitmap.contains(0));
+        bitmap.remove(5);
+        bool more = true;
+        QVERIFY(bitmap.values(-1, 10, &more).isEmpty());
+        QVERIFY(!more);
+        QVERIFY(RoaringBitmap::intersected(bitmap, bitmap).isEmpty());
+        QCOMPARE(bitmap.intersectionCardinality(fromSet({1, 2})), qint64(0));
+    }
+
+    void addRemoveContains()
+    {
+        RoaringBitmap bitmap;
+        bitmap.add(1);
+        bitmap.add(1);
+        bitmap.add(65535);
+        bitmap.add(65536);
+        QCOMPARE(bitmap.cardinality(), qint64(3));
+        QCOMPARE(bitmap.containerCount(), 2);
+        QVERIFY(bitmap.contains(65535) && bitmap.contains(65536));
+        QVERIFY(!bitmap.contains(2));
+        bitmap.remove(65536);
+        // Опустевший блок удаляется
+        QCOMPARE(bitmap.containerCount(), 1);
+        bitmap.remove(1);
+        bitmap.remove(65535);
+        QVERIFY(bitmap.isEmpty());
+    }
+
+    void containerConversion()
+    {
+        RoaringBitmap bitmap;
+        for (quint32 value = 0; value < 4096; ++value) {
+            bitmap.add(value * 2);
+        }
+        QCOMPARE(bitmap.bitmapContainerCount(), 0);
+        // 4097-е значение переводит блок в битовую карту
+        bitmap.add(1);
+        QCOMPARE(bitmap.bitmapContainerCount(), 1);
+        QCOMPARE(bitmap.cardinality(), qint64(4097));
+        QVERIFY(bitmap.contains(8190) && bitmap.contains(1) && !bitmap.contains(3));
+        // ...а удаление обратно - в массив, с теми же значениями
+        bitmap.remove(8190);
+        QCOMPARE(bitmap.bitmapContainerCount(), 0);
+        QCOMPARE(bitmap.cardinality(), qint64(4096));
+        QVERIFY(bitmap.contains(1) && bitmap.contains(8188) && !bitmap.contains(8190));
+    }
+
+    void valuesPaging()
+    {
+        const RoaringBitmap bitmap = fromSet({3, 5, 70000, 70001, 200000});
+        bool more = false;
+        QCOMPARE(bitmap.values(-1, 2, &more), QList<int>({3, 5}));
+        QVERIFY(more);
+        QCOMPARE(bitmap.values(5, 2, &more), QList<int>({70000, 70001}));
+        QVERIFY(more);
+        // Последнее значение на странице: страниц больше нет
+        QCOMPARE(bitmap.values(70001, 1, &more), QList<int>({200000}));
+        QVERIFY(!more);
+        QCOMPARE(bitmap.values(200000, 5, &more), QList<int>());
+        QVERIFY(!more);
+        QCOMPARE(bitmap.values(4, 10, &more), QList<int>({5, 70000, 70001, 200000}));
+        QCOMPARE(bitmap.values(-1, 0, &more), QList<int>());
+    }
+
+    void setOperationsMatchStdSet()
+    {
+        QRandomGenerator random(20260417);
+        bool sawBitmap = false;
+        bool sawArray = false;
+        for (int round = 0; round < 20; ++round) {
+            const std::set<quint32> a = randomSet(random, 1 + int(random.bounded(12000u)));
+            const std::set<quint32> b = randomSet(random, 1 + int(random.bounded(12000u)));
+            std::set<quint32> both;
+            std::set_intersection(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::inserter(both, both.end()));
+            std::set<quint32> either;
+            std::set_union(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::inserter(either, either.end()));
+
+            const RoaringBitmap left = fromSet(a);
+            const RoaringBitmap right = fromSet(b);
+            QCOMPARE(left.cardinality(), qint64(a.size()));
+            QCOMPARE(allValues(left), toList(a));
+            sawBitmap = sawBitmap || left.bitmapContainerCount() > 0;
+            sawArray = sawArray || left.bitmapContainerCount() < left.containerCount();
+
+            const RoaringBitmap intersection = RoaringBitmap::intersected(left, right);
+            QCOMPARE(allValues(intersection), toList(both));
+            QCOMPARE(intersection.cardinality(), qint64(both.size()));
+            QCOMPARE(left.intersectionCardinality(right), qint64(both.size()));
+
+            const RoaringBitmap united = RoaringBitmap::united(left, right);
+            QCOMPARE(allValues(united), toList(either));
+            QCOMPARE(united.cardinality(), qint64(either.size()));
+        }
+        // Проверены пары массив/массив, массив/битовая карта и битовая карта/битовая карта
+        QVERIFY(sawBitmap && sawArray);
+    }
+
+    void disjointAndSubset()
+    {
+        const RoaringBitmap low = fromSet({1, 2, 3});
+        const RoaringBitmap high = fromSet({65536, 65537});
+        QVERIFY(RoaringBitmap::intersected(low, high).isEmpty());
+        QCOMPARE(low.intersectionCardinality(high), qint64(0));
+        QCOMPARE(allValues(RoaringBitmap::united(low, high)), QList<int>({1, 2, 3, 65536, 65537}));
+        QCOMPARE(allValues(RoaringBitmap::intersected(low, fromSet({2, 3}))), QList<int>({2, 3}));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestRoaringBitmap)
+#include "tst_roaringbitmap.moc"
@@ -0,0 +1,148 @@
+#include <QtTest>
+#include <algorithm>
+#include <cmath>
+
+#include "searchcursor.h"
+
+struct RankedRow
+{
+    float rank;
+    int productId;
+};
+
+class TestSearchCursor : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Страница так же, как ее строит searchProducts поверх fn_SearchProducts: строки по убыванию
+    // ранга, при равном ранге по product_id, строго после курсора; берется limit + 1 строка,
+    // и курсор следующей страницы выдается клиенту закодированным
+    static QList<RankedRow> page(const QList<RankedRow> &rows, const std::optional<SearchCursor> &after,
+                                 int limit, QByteArray *nextCursor)
+    {
+        QList<RankedRow> sorted = rows;
+        std::sort(sorted.begin(), sorted.end(), [](const RankedRow &a, const RankedRow &b) {
+            return a.rank != b.rank ? a.rank > b.rank : a.productId < b.productId;
+        });
+        const float afterRank = after ? after->rank : INFINITY;
+        const int afterId = after ? after->productId : 0;
+        QList<RankedRow> fetched;
+        for (const RankedRow &row : std::as_const(sorted)) {
+            if ((row.rank < afterRank || (row.rank == afterRank && row.productId > afterId))
+                && fetched.size() < limit + 1) {
+                fetched.append(row);
+            }
+        }
+        nextCursor->clear();
+        if (fetched.size() > limit) {
+            fetched.removeLast();
+            *nextCursor = SearchCursor{fetched.constLast().rank, fetched.constLast().productId}.encode();
+        }
+        return fetched;
+    }
+
+    static QList<int> pageThrough(const QList<RankedRow> &rows, int limit, int *pages)
+    {
+        QList<int> ids;
+        std::optional<SearchCursor> after;
+        *pages = 0;
+        forever {
+            QByteArray next;
+            const QList<RankedRow> items = page(rows, after, limit, &next);
+            ++*pages;
+            for (const RankedRow &row : items) {
+                ids.append(row.productId);
+            }
+            if (next.isEmpty()) {
+                return ids;
+            }
+            after = SearchCursor::decode(next);
+            if (!after) {
+                return {};
+            }
+        }
+    }
+
+private slots:
+    void roundTrip_data()
+    {
+        QTest::addColumn<float>("rank");
+        QTest::addColumn<int>("productId");
+        QTest::newRow("typical") << 0.0607927f << 42;
+        QTest::newRow("zero") << 0.0f << 1;
+        QTest::newRow("tiny") << 1e-20f << 7;
+        QTest::newRow("tenth") << 0.1f << 2147483647;
+        QTest::newRow("next after tenth") << std::nextafter(0.1f, 1.0f) << 3;
+    }
+
+    void roundTrip()
+    {
+        QFETCH(float, rank);
+        QFETCH(int, productId);
+        const QByteArray encoded = SearchCursor{rank, productId}.encode();
+        // Строка для URL: без '+', '/' и '='
+        QVERIFY(!encoded.contains('+') && !encoded.contains('/') && !encoded.contains('='));
+        const std::optional<SearchCursor> decoded = SearchCursor::decode(encoded);
+        QVERIFY(decoded);
+        // Ранг сравнивается в SQL на равенство, поэтому должен совпасть побитово
+        QVERIFY(decoded->rank == rank);
+        QCOMPARE(decoded->productId, productId);
+    }
+
+    void rejectsInvalid_data()
+    {
+        QTest::addColumn<QByteArray>("encoded");
+        auto encode = [](const char *json) {
+            return QByteArray(json).toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+        };
+        QTest::newRow("empty") << QByteArray();
+        QTest::newRow("not base64") << QByteArray("!!!");
+        QTest::newRow("not json") << encode("cursor");
+        QTest::newRow("array") << encode("[1, 2]");
+        QTest::newRow("missing id") << encode("{\"r\":\"0.5\"}");
+        QTest::newRow("numeric rank") << encode("{\"r\":0.5,\"i\":1}");
+        QTest::newRow("bad rank") << encode("{\"r\":\"high\",\"i\":1}");
+    }
+
+    void rejectsInvalid()
+    {
+        QFETCH(QByteArray, encoded);
+        QVERIFY(!SearchCursor::decode(encoded));
+    }
+
+    void pagesCoverAllRowsOnce_data()
+    {
+        QTest::addColumn<int>("limit");
+        QTest::addColumn<int>("expectedPages");
+        // 10 строк: при limit 5 последняя страница полная, и курсора после нее нет
+        QTest::newRow("exact multiple") << 5 << 2;
+        QTest::newRow("remainder") << 3 << 4;
+        QTest::newRow("one per page") << 1 << 10;
+        QTest::newRow("single page") << 20 << 1;
+    }
+
+    void pagesCoverAllRowsOnce()
+    {
+        QFETCH(int, limit);
+        QFETCH(int, expectedPages);
+        // Одинаковые ранги на границе страниц различаются только по product_id
+        const QList<RankedRow> rows = {{0.5f, 9}, {0.5f, 3}, {0.5f, 4}, {0.25f, 1}, {0.25f, 8},
+                                       {0.1f, 2}, {std::nextafter(0.1f, 1.0f), 10}, {0.0f, 5},
+                                       {0.0f, 6}, {0.0f, 7}};
+        int pages = 0;
+        const QList<int> ids = pageThrough(rows, limit, &pages);
+        QCOMPARE(ids, QList<int>({3, 4, 9, 1, 8, 10, 2, 5, 6, 7}));
+        QCOMPARE(pages, expectedPages);
+    }
+
+    void emptyResult()
+    {
+        int pages = 0;
+        QVERIFY(pageThrough({}, 5, &pages).isEmpty());
+        QCOMPARE(pages, 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestSearchCursor)
+#include "tst_searchcursor.moc"
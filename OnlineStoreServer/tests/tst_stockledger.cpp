@@ -0,0 +1,225 @@
+#include <QtTest>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "stockledger.h"
+
+class TestStockLedger : public QObject
+{
+    Q_OBJECT
+
+private:
+    static int total(const StockLedger &ledger, const char *key)
+    {
+        return ledger.stats().value(QLatin1String(key)).toInt();
+    }
+
+private slots:
+    void reserveTakesUnit()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 2}});
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::Ok);
+        QCOMPARE(total(ledger, "available"), 1);
+        QCOMPARE(total(ledger, "reserved"), 1);
+        // Резерв не меняет остаток на складе
+        QCOMPARE(ledger.onHand(1), 2);
+    }
+
+    void repeatedReserveOnlyExtends()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 2}});
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::Ok);
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::Ok);
+        QCOMPARE(total(ledger, "available"), 1);
+        QCOMPARE(total(ledger, "reserved"), 1);
+    }
+
+    void reserveSoldOut()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::Ok);
+        QCOMPARE(ledger.reserve(11, 1), StockLedger::Status::SoldOut);
+        QCOMPARE(total(ledger, "sold_out_rejections"), 1);
+    }
+
+    void reserveUnknownProduct()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        QCOMPARE(ledger.reserve(10, 2), StockLedger::Status::NotFound);
+        QCOMPARE(ledger.onHand(2), -1);
+    }
+
+    void releaseReturnsUnit()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        ledger.release(10, 1);
+        QCOMPARE(total(ledger, "available"), 1);
+        QCOMPARE(total(ledger, "reserved"), 0);
+        QCOMPARE(ledger.reserve(11, 1), StockLedger::Status::Ok);
+    }
+
+    void expiredReservationReturnsUnit()
+    {
+        StockLedger ledger;
+        ledger.setReservationTtlMs(0);
+        ledger.reset({{1, 1}});
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::Ok);
+        QCOMPARE(ledger.removeExpired(), 1);
+        QCOMPARE(total(ledger, "available"), 1);
+        QCOMPARE(total(ledger, "reserved"), 0);
+        QCOMPARE(total(ledger, "expired_reservations"), 1);
+        // Освободившуюся единицу может взять другой покупатель
+        QCOMPARE(ledger.reserve(11, 1), StockLedger::Status::Ok);
+    }
+
+    void unexpiredReservationIsKept()
+    {
+        StockLedger ledger;
+        ledger.setReservationTtlMs(60 * 60 * 1000);
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        QCOMPARE(ledger.removeExpired(), 0);
+        QCOMPARE(total(ledger, "reserved"), 1);
+    }
+
+    void claimConsumesReservation()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 2}});
+        ledger.reserve(10, 1);
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1}, &soldOut), StockLedger::Status::Ok);
+        QVERIFY(soldOut.isEmpty());
+        // Проданная единица покидает учет: остаток совпадает со списанным в БД
+        QCOMPARE(ledger.onHand(1), 1);
+        QCOMPARE(total(ledger, "reserved"), 0);
+        QCOMPARE(total(ledger, "available"), 1);
+    }
+
+    void claimAfterExpiryTakesFreeUnit()
+    {
+        StockLedger ledger;
+        ledger.setReservationTtlMs(0);
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        ledger.removeExpired();
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1}, &soldOut), StockLedger::Status::Ok);
+        QCOMPARE(ledger.onHand(1), 0);
+    }
+
+    void claimAfterExpiryWhenTaken()
+    {
+        StockLedger ledger;
+        ledger.setReservationTtlMs(0);
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        ledger.removeExpired();
+        ledger.setReservationTtlMs(60 * 60 * 1000);
+        QCOMPARE(ledger.reserve(11, 1), StockLedger::Status::Ok);
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1}, &soldOut), StockLedger::Status::SoldOut);
+        QCOMPARE(soldOut, QList<int>({1}));
+        QCOMPARE(total(ledger, "reserved"), 1);
+    }
+
+    void claimIsAllOrNothing()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}, {2, 0}});
+        ledger.reserve(10, 1);
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1, 2}, &soldOut), StockLedger::Status::SoldOut);
+        QCOMPARE(soldOut, QList<int>({2}));
+        // Резерв на первый товар остался у покупателя
+        QCOMPARE(ledger.onHand(1), 1);
+        QCOMPARE(total(ledger, "reserved"), 1);
+        QCOMPARE(total(ledger, "available"), 0);
+    }
+
+    void cancelClaimRestoresReservation()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1}, &soldOut), StockLedger::Status::Ok);
+        ledger.cancelClaim(10, {1});
+        QCOMPARE(ledger.onHand(1), 1);
+        QCOMPARE(total(ledger, "reserved"), 1);
+        QCOMPARE(ledger.reserve(11, 1), StockLedger::Status::SoldOut);
+    }
+
+    void adjustBelowReservations()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        ledger.reserve(10, 1);
+        // Администратор списал единицу, которая была в резерве
+        ledger.adjust(1, -1);
+        QCOMPARE(ledger.onHand(1), 0);
+        QList<int> soldOut;
+        QCOMPARE(ledger.claim(10, {1}, &soldOut), StockLedger::Status::SoldOut);
+        QCOMPARE(total(ledger, "reserved"), 0);
+        QCOMPARE(ledger.onHand(1), 0);
+    }
+
+    void concurrentBuyersNeverOversell()
+    {
+        // Покупателей больше, чем единиц: резерв и оформление получают ровно столько, сколько есть на складе
+        constexpr int kStock = 50;
+        constexpr int kThreads = 8;
+        constexpr int kBuyersPerThread = 40;
+        StockLedger ledger;
+        ledger.reset({{1, kStock}});
+        std::atomic<int> reserved{0};
+        std::atomic<int> claimed{0};
+        std::vector<std::unique_ptr<QThread>> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back(QThread::create([&, t] {
+                for (int i = 0; i < kBuyersPerThread; ++i) {
+                    const int userId = t * kBuyersPerThread + i;
+                    if (ledger.reserve(userId, 1) != StockLedger::Status::Ok) {
+                        continue;
+                    }
+                    ++reserved;
+                    QList<int> soldOut;
+                    if (ledger.claim(userId, {1}, &soldOut) == StockLedger::Status::Ok) {
+                        ++claimed;
+                    }
+                }
+            }));
+            threads.back()->start();
+        }
+        for (const std::unique_ptr<QThread> &thread : threads) {
+            QVERIFY(thread->wait(10000));
+        }
+        QCOMPARE(reserved.load(), kStock);
+        QCOMPARE(claimed.load(), kStock);
+        QCOMPARE(ledger.onHand(1), 0);
+        QCOMPARE(total(ledger, "reserved"), 0);
+        QCOMPARE(total(ledger, "sold_out_rejections"), kThreads * kBuyersPerThread - kStock);
+    }
+
+    void removedProductIsUnknown()
+    {
+        StockLedger ledger;
+        ledger.reset({{1, 1}});
+        ledger.addProducts({{2, 3}});
+        QCOMPARE(ledger.onHand(2), 3);
+        ledger.removeProducts({1});
+        QCOMPARE(ledger.reserve(10, 1), StockLedger::Status::NotFound);
+        QCOMPARE(total(ledger, "products"), 1);
+    }
+};
+
+QTEST_GUILESS_MAIN(TestStockLedger)
+#include "tst_stockledger.moc"
@@ -0,0 +1,177 @@
+#include "tokensigner.h"
+#include <QMessageAuthenticationCode>
+#include <QRandomGenerator>
+#include <QDateTime>
+#include <array>
+
+namespace {
+
+constexpr qsizetype kMacSize = 32; // SHA-256
+
+// Сравнение за постоянное время: время не зависит от позиции первого несовпадения
+bool constantTimeEquals(const char *a, const char *b, qsizetype size)
+{
+    unsigned char diff = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Разбирает неотрицательное десятичное число без выделения памяти
+bool parseNumber(QByteArrayView text, qint64 *value)
+{
+    if (text.isEmpty() || text.size() > 18) {
+        return false;
+    }
+    qint64 result = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        result = result * 10 + (c - '0');
+    }
+    *value = result;
+    return true;
+}
+
+} // namespace
+
+TokenSigner::TokenSigner()
+{
+    rotate();
+}
+
+void TokenSigner::setTtlSeconds(qint64 ttlSeconds)
+{
+    m_ttlSeconds = ttlSeconds;
+}
+
+qint64 TokenSigner::ttlSeconds() const
+{
+    return m_ttlSeconds;
+}
+
+QByteArray TokenSigner::issue(int userId, const QString &role) const
+{
+    const std::shared_ptr<const KeyRing> keys = std::atomic_load(&m_keys);
+    const SigningKey &key = keys->constFirst();
+    const qint64 expiresAt = QDateTime::currentSecsSinceEpoch() + m_ttlSeconds;
+
+    const QByteArray payload = QByteArray::number(userId) + '.' + role.toLatin1() + '.'
+                               + QByteArray::number(expiresAt) + '.' + key.kid;
+    const QByteArray mac = QMessageAuthenticationCode::hash(payload, key.secret, QCryptographicHash::Sha256);
+    ++m_issued;
+    return payload + '.' + mac.toHex();
+}
+
+std::optional<AccessClaims> TokenSigner::verify(QByteArrayView token) const
+{
+    // Токен режется на части представлениями, без копий
+    std::array<QByteArrayView, 5> parts;
+    qsizetype start = 0;
+    for (int i = 0; i < 4; ++i) {
+        const qsizetype dot = token.indexOf('.', start);
+        if (dot < 0) {
+            ++m_rejected;
+            return std::nullopt;
+        }
+        parts[i] = token.sliced(start, dot - start);
+        start = dot + 1;
+    }
+    parts[4] = token.sliced(start);
+    const QByteArrayView payload = token.first(start - 1);
+
+    qint64 userId = 0;
+    qint64 expiresAt = 0;
+    const bool isAdmin = parts[1] == "admin";
+    if (!parseNumber(parts[0], &userId) || !parseNumber(parts[2], &expiresAt)
+        || (!isAdmin && parts[1] != "user") || parts[4].size() != kMacSize * 2) {
+        ++m_rejected;
+        return std::nullopt;
+    }
+
+    std::array<char, kMacSize> presented;
+    for (qsizetype i = 0; i < kMacSize; ++i) {
+        const int high = hexValue(parts[4][2 * i]);
+        const int low = hexValue(parts[4][2 * i + 1]);
+        if (high < 0 || low < 0) {
+            ++m_rejected;
+            return std::nullopt;
+        }
+        presented[i] = char((high << 4) | low);
+    }
+
+    const std::shared_ptr<const KeyRing> keys = std::atomic_load(&m_keys);
+    const SigningKey *key = nullptr;
+    for (const SigningKey &candidate : *keys) {
+        if (parts[3] == candidate.kid) {
+            key = &candidate;
+            break;
+        }
+    }
+    if (!key) {
+        ++m_rejected;
+        return std::nullopt;
+    }
+
+    // hashInto пишет результат в буфер на стеке
+    std::array<char, kMacSize> expected;
+    const QByteArrayView mac = QMessageAuthenticationCode::hashInto(expected, payload, key->secret,
+                                                                    QCryptographicHash::Sha256);
+    if (mac.size() != kMacSize || !constantTimeEquals(mac.data(), presented.data(), kMacSize)) {
+        ++m_rejected;
+        return std::nullopt;
+    }
+    // Срок проверяется после подписи, чтобы не отвечать по-разному на поддельные токены
+    if (expiresAt <= QDateTime::currentSecsSinceEpoch()) {
+        ++m_rejected;
+        return std::nullopt;
+    }
+
+    return AccessClaims{int(userId), isAdmin, expiresAt};
+}
+
+QByteArray TokenSigner::rotate()
+{
+    QMutexLocker locker(&m_rotateMutex);
+
+    SigningKey key;
+    key.kid = "k" + QByteArray::number(++m_keySerial);
+    key.secret.resize(kMacSize);
+    QRandomGenerator::system()->fillRange(reinterpret_cast<quint32 *>(key.secret.data()),
+                                          kMacSize / sizeof(quint32));
+
+    auto next = std::make_shared<KeyRing>();
+    next->append(key);
+    if (const std::shared_ptr<const KeyRing> current = std::atomic_load(&m_keys)) {
+        for (const SigningKey &previous : *current) {
+            if (next->size() >= kMaxKeys) {
+                break;
+            }
+            next->append(previous);
+        }
+    }
+    std::atomic_store(&m_keys, std::shared_ptr<const KeyRing>(std::move(next)));
+    return key.kid;
+}
+
+QJsonObject TokenSigner::stats() const
+{
+    const std::shared_ptr<const KeyRing> keys = std::atomic_load(&m_keys);
+    QJsonObject result;
+    result["current_kid"] = QString::fromLatin1(keys->constFirst().kid);
+    result["keys"] = qint64(keys->size());
+    result["ttl_seconds"] = m_ttlSeconds.load();
+    result["issued"] = qint64(m_issued.load());
+    result["rejected"] = qint64(m_rejected.load());
+    return result;
+}
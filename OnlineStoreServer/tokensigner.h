@@ -0,0 +1,60 @@
+#ifndef TOKENSIGNER_H
+#define TOKENSIGNER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QJsonObject>
+#include <atomic>
+#include <memory>
+#include <optional>
+
+// Данные, подписанные в токене доступа
+struct AccessClaims
+{
+    int userId = 0;
+    bool isAdmin = false;
+    qint64 expiresAt = 0; // секунды Unix
+};
+
+// Токены доступа без состояния: "<user_id>.<role>.<exp>.<kid>.<hmac>",
+// где hmac = HMAC-SHA256(ключ kid, "<user_id>.<role>.<exp>.<kid>") в hex.
+// Проверка не обращается к БД и не выделяет память. Ключи можно сменить без перезапуска:
+// новый ключ подписывает, предыдущие еще проверяют уже выданные токены до их истечения.
+class TokenSigner
+{
+public:
+    TokenSigner();
+
+    void setTtlSeconds(qint64 ttlSeconds);
+    qint64 ttlSeconds() const;
+
+    QByteArray issue(int userId, const QString &role) const;
+    std::optional<AccessClaims> verify(QByteArrayView token) const;
+
+    // Генерирует новый ключ подписи; возвращает его идентификатор
+    QByteArray rotate();
+
+    QJsonObject stats() const;
+
+private:
+    struct SigningKey
+    {
+        QByteArray kid;
+        QByteArray secret;
+    };
+    // Неизменяемый набор ключей, публикуется атомарно; первый ключ - текущий
+    using KeyRing = QList<SigningKey>;
+    static constexpr int kMaxKeys = 3;
+
+    std::shared_ptr<const KeyRing> m_keys;
+    QMutex m_rotateMutex;
+    std::atomic<qint64> m_ttlSeconds{15 * 60};
+    std::atomic<quint64> m_keySerial{0};
+    mutable std::atomic<quint64> m_issued{0};
+    mutable std::atomic<quint64> m_rejected{0};
+};
+
+#endif // TOKENSIGNER_H
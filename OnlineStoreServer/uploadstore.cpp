@@ -0,0 +1,235 @@
+#include "uploadstore.h"
+#include <QDir>
+#include <QFile>
+#include <QUuid>
+#include <QDebug>
+
+UploadStore::UploadStore(const QString &directory)
+    : m_directory(directory)
+{
+    QDir dir(m_directory);
+    if (!dir.exists()) {
+        dir.mkpath(".");
+    }
+    // Состояние загрузок хранится только в памяти, поэтому остатки прошлого запуска не продолжить
+    const QStringList leftovers = dir.entryList({"*.part"}, QDir::Files);
+    for (const QString &name : leftovers) {
+        dir.remove(name);
+    }
+}
+
+void UploadStore::setMaxBytes(qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxBytes = maxBytes;
+}
+
+qint64 UploadStore::maxBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxBytes;
+}
+
+void UploadStore::setMaxChunkBytes(qint64 maxChunkBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxChunkBytes = maxChunkBytes;
+}
+
+qint64 UploadStore::maxChunkBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_maxChunkBytes;
+}
+
+void UploadStore::setExpiryMs(qint64 expiryMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_expiryMs = expiryMs;
+}
+
+UploadStore::Status UploadStore::create(qint64 size, UploadInfo *info)
+{
+    QMutexLocker locker(&m_mutex);
+    if (size <= 0 || size > m_maxBytes) {
+        return Status::TooLarge;
+    }
+
+    const QString id = QUuid::createUuid().toString(QUuid::Id128);
+    QFile file(filePathFor(id));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "UploadStore: Could not create" << file.fileName() << file.errorString();
+        return Status::IoError;
+    }
+    file.close();
+
+    Entry entry;
+    entry.size = size;
+    entry.lastActivity.start();
+    m_entries.insert(id, entry);
+
+    info->id = id;
+    info->size = size;
+    info->offset = 0;
+    return Status::Ok;
+}
+
+UploadStore::Status UploadStore::store(const QByteArray &data, QString *filePath)
+{
+    if (data.isEmpty() || data.size() > maxBytes()) {
+        return Status::TooLarge;
+    }
+
+    const QString path = filePathFor(QUuid::createUuid().toString(QUuid::Id128));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qWarning() << "UploadStore: Could not write" << path << file.errorString();
+        file.close();
+        QFile::remove(path);
+        return Status::IoError;
+    }
+    file.close();
+
+    QMutexLocker locker(&m_mutex);
+    ++m_completed;
+    m_bytesReceived += data.size();
+    *filePath = path;
+    return Status::Ok;
+}
+
+UploadStore::Status UploadStore::append(const QString &id, qint64 offset, const QByteArray &chunk, UploadInfo *info)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            return Status::NotFound;
+        }
+        info->id = id;
+        info->size = it->size;
+        info->offset = it->offset;
+        if (it->busy) {
+            return Status::Busy;
+        }
+        if (offset != it->offset) {
+            return Status::OffsetMismatch;
+        }
+        if (chunk.size() > m_maxChunkBytes || offset + chunk.size() > it->size) {
+            return Status::TooLarge;
+        }
+        it->busy = true;
+    }
+
+    // Запись на диск идет без блокировки: фрагменты других загрузок пишутся параллельно
+    QFile file(filePathFor(id));
+    bool written = file.open(QIODevice::ReadWrite) && file.seek(offset)
+                   && file.write(chunk) == chunk.size();
+    if (!written) {
+        qWarning() << "UploadStore: Could not write chunk of" << id << file.errorString();
+    }
+    file.close();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        // Загрузку удалили, пока писался фрагмент
+        QFile::remove(filePathFor(id));
+        return Status::NotFound;
+    }
+    it->busy = false;
+    it->lastActivity.start();
+    if (!written) {
+        return Status::IoError;
+    }
+    it->offset += chunk.size();
+    m_bytesReceived += chunk.size();
+    info->offset = it->offset;
+    return Status::Ok;
+}
+
+UploadStore::Status UploadStore::info(const QString &id, UploadInfo *info) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.constFind(id);
+    if (it == m_entries.constEnd()) {
+        return Status::NotFound;
+    }
+    info->id = id;
+    info->size = it->size;
+    info->offset = it->offset;
+    return Status::Ok;
+}
+
+UploadStore::Status UploadStore::take(const QString &id, QString *filePath)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return Status::NotFound;
+    }
+    if (it->busy) {
+        return Status::Busy;
+    }
+    if (it->offset != it->size) {
+        return Status::Incomplete;
+    }
+    m_entries.erase(it);
+    ++m_completed;
+    *filePath = filePathFor(id);
+    return Status::Ok;
+}
+
+void UploadStore::remove(const QString &id)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+    const bool busy = it->busy;
+    m_entries.erase(it);
+    // Если в файл сейчас пишут, его удалит append после записи
+    if (!busy) {
+        QFile::remove(filePathFor(id));
+    }
+}
+
+int UploadStore::removeExpired()
+{
+    QMutexLocker locker(&m_mutex);
+    int removed = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (!it->busy && it->lastActivity.hasExpired(m_expiryMs)) {
+            QFile::remove(filePathFor(it.key()));
+            it = m_entries.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    m_expired += removed;
+    return removed;
+}
+
+QJsonObject UploadStore::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 pendingBytes = 0;
+    for (const Entry &entry : m_entries) {
+        pendingBytes += entry.offset;
+    }
+    QJsonObject result;
+    result["in_progress"] = qint64(m_entries.size());
+    result["pending_bytes"] = pendingBytes;
+    result["completed"] = qint64(m_completed);
+    result["expired"] = qint64(m_expired);
+    result["bytes_received"] = qint64(m_bytesReceived);
+    result["max_bytes"] = m_maxBytes;
+    result["max_chunk_bytes"] = m_maxChunkBytes;
+    return result;
+}
+
+QString UploadStore::filePathFor(const QString &id) const
+{
+    return m_directory + "/" + id + ".part";
+}
@@ -0,0 +1,78 @@
+#ifndef UPLOADSTORE_H
+#define UPLOADSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+// Состояние одной возобновляемой загрузки
+struct UploadInfo
+{
+    QString id;
+    qint64 size = 0;   // объявленный клиентом полный размер
+    qint64 offset = 0; // сколько байт уже записано
+};
+
+// Хранилище незавершенных загрузок. Каждая загрузка пишется во временный файл
+// частями по смещению, поэтому в памяти находится не больше одного фрагмента,
+// а после обрыва клиент продолжает с последнего подтвержденного смещения.
+class UploadStore
+{
+public:
+    enum class Status {
+        Ok,
+        NotFound,
+        OffsetMismatch, // смещение фрагмента не совпадает с уже записанным
+        TooLarge,
+        Busy,           // в эту загрузку уже пишется другой фрагмент
+        Incomplete,
+        IoError
+    };
+
+    explicit UploadStore(const QString &directory = "uploads");
+
+    void setMaxBytes(qint64 maxBytes);
+    qint64 maxBytes() const;
+    void setMaxChunkBytes(qint64 maxChunkBytes);
+    qint64 maxChunkBytes() const;
+    // Брошенные загрузки удаляются после этого времени без активности
+    void setExpiryMs(qint64 expiryMs);
+
+    Status create(qint64 size, UploadInfo *info);
+    // Сохраняет данные, полученные одним запросом, во временный файл хранилища
+    Status store(const QByteArray &data, QString *filePath);
+    Status append(const QString &id, qint64 offset, const QByteArray &chunk, UploadInfo *info);
+    Status info(const QString &id, UploadInfo *info) const;
+    // Забирает полностью полученную загрузку: запись удаляется, файл остается вызывающему
+    Status take(const QString &id, QString *filePath);
+    void remove(const QString &id);
+    int removeExpired();
+
+    QJsonObject stats() const;
+
+private:
+    struct Entry
+    {
+        qint64 size = 0;
+        qint64 offset = 0;
+        bool busy = false;
+        QElapsedTimer lastActivity;
+    };
+
+    QString filePathFor(const QString &id) const;
+
+    QString m_directory;
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    qint64 m_maxBytes = 20 * 1024 * 1024;
+    qint64 m_maxChunkBytes = 1024 * 1024;
+    qint64 m_expiryMs = 30 * 60 * 1000;
+    quint64 m_completed = 0;
+    quint64 m_expired = 0;
+    quint64 m_bytesReceived = 0;
+};
+
+#endif // UPLOADSTORE_H
@@ -1,16 +1,3 @@
-CREATE OR REPLACE FUNCTION fn_AuthenticateUser(
-    p_user_name TEXT,
-    p_password TEXT
-)
-RETURNS TABLE (user_id INT, user_role VARCHAR(63)) AS $$
-BEGIN
-    RETURN QUERY
-    SELECT u.user_id, u.user_role
-    FROM Users u
-    WHERE u.user_name = p_user_name AND u.user_password = crypt(p_password, u.user_password);
-END;
-$$ LANGUAGE plpgsql;
-
 CREATE OR REPLACE FUNCTION fn_GetProductsByCategory(
     p_category_id INT
 )
@@ -34,10 +21,48 @@ BEGIN
     JOIN
         Products_Categories pc ON p.product_id = pc.product_id
     WHERE
-        pc.category_id = p_category_id;
+        pc.category_id = p_category_id AND p.product_is_active;
 END;
 $$ LANGUAGE plpgsql;
 
+-- Поиск по названию и описанию (русская морфология). Совпадения находит GIN-индекс
+-- по product_search, и все они ранжируются по ts_rank: выдача - самые релевантные товары.
+-- Для слов, которые есть в большей части каталога, время ранжирования ограничивает
+-- statement_timeout соединения поиска (см. DatabaseHandler::searchProducts).
+-- Страницы - по ключу (search_rank, product_id) последней строки предыдущей страницы;
+-- для первой страницы p_after_rank = 'Infinity'.
+CREATE OR REPLACE FUNCTION fn_SearchProducts(
+    p_query TEXT,
+    p_after_rank REAL,
+    p_after_id INT,
+    p_limit INT
+)
+RETURNS TABLE (
+    product_id INT,
+    product_name VARCHAR(255),
+    product_price DECIMAL(10, 2),
+    product_description TEXT,
+    product_image_path TEXT,
+    product_stock INT,
+    search_rank REAL
+) AS $$
+BEGIN
+    RETURN QUERY
+    SELECT m.product_id, m.product_name, m.product_price, m.product_description,
+           m.product_image_path, m.product_stock, m.search_rank
+    FROM (
+        SELECT p.product_id, p.product_name, p.product_price, p.product_description,
+               p.product_image_path, p.product_stock, ts_rank(p.product_search, q.query) AS search_rank
+        FROM Products p, websearch_to_tsquery('russian', p_query) AS q(query)
+        WHERE p.product_is_active AND p.product_search @@ q.query
+    ) m
+    WHERE m.search_rank < p_after_rank
+       OR (m.search_rank = p_after_rank AND m.product_id > p_after_id)
+    ORDER BY m.search_rank DESC, m.product_id
+    LIMIT p_limit;
+END;
+$$ LANGUAGE plpgsql STABLE;
+
 CREATE OR REPLACE PROCEDURE sp_AddToCart(
     p_user_id INT,
     p_product_id INT
@@ -46,7 +71,7 @@ BEGIN
     IF NOT EXISTS (SELECT 1 FROM Users WHERE user_id = p_user_id) THEN
         RAISE EXCEPTION 'User with ID % not found', p_user_id;
     END IF;
-    IF NOT EXISTS (SELECT 1 FROM Products WHERE product_id = p_product_id) THEN
+    IF NOT EXISTS (SELECT 1 FROM Products WHERE product_id = p_product_id AND product_is_active) THEN
         RAISE EXCEPTION 'Product with ID % not found or no longer available', p_product_id;
     END IF;
     INSERT INTO Cart (user_id, product_id)
@@ -76,29 +101,47 @@ BEGIN
     INTO total_price
     FROM Cart cr
     JOIN Products p ON cr.product_id = p.product_id
-    WHERE cr.user_id = p_user_id;
+    WHERE cr.user_id = p_user_id AND p.product_is_active;
 
     RETURN total_price;
 END;
 $$ LANGUAGE plpgsql;
 
-CREATE OR REPLACE PROCEDURE sp_PlaceOrder(
-    p_user_id INT
-) AS $$
-DECLARE
-    product_to_remove_id INT;
+-- Оформление заказа: списание остатка и очистка корзины в одной транзакции (один вызов).
+-- Товары, которые сервер уже забрал из резервов в памяти, блокируются в порядке product_id,
+-- поэтому параллельные заказы не образуют взаимоблокировок и встают в очередь за блокировкой.
+-- Ожидание ограничено lock_timeout функции: дольше - ошибка 55P03, и сервер повторяет заказ.
+-- Остаток не ограничивается нулем: если товара в БД меньше, чем продано,
+-- CHECK (product_stock >= 0) отменяет весь заказ ошибкой 23514.
+CREATE OR REPLACE FUNCTION fn_PlaceOrder(
+    p_user_id INT,
+    p_product_ids INT[]
+)
+RETURNS TABLE (purchased_product_id INT, remaining_stock INT)
+SET lock_timeout = '2s'
+AS $$
 BEGIN
-    IF NOT EXISTS (SELECT 1 FROM Cart WHERE user_id = p_user_id) THEN
-        RAISE NOTICE 'Корзина пуста. Заказ не может быть оформлен.';
-        RETURN;
-    END IF;
-    FOR product_to_remove_id IN SELECT product_id FROM Cart WHERE user_id = p_user_id
-    LOOP
-        DELETE FROM Products WHERE product_id = product_to_remove_id;
-    END LOOP;
-    DELETE FROM Cart WHERE user_id = p_user_id;
+    PERFORM 1
+    FROM Products p
+    WHERE p.product_id = ANY(p_product_ids)
+    ORDER BY p.product_id
+    FOR UPDATE OF p;
 
-    RAISE NOTICE 'Заказ успешно оформлен. Товары куплены и удалены из магазина. Корзина очищена.';
+    RETURN QUERY
+    WITH purchased AS (
+        UPDATE Products p
+        SET product_stock = p.product_stock - 1
+        FROM Cart c
+        WHERE c.user_id = p_user_id AND c.product_id = p.product_id
+          AND p.product_id = ANY(p_product_ids) AND p.product_is_active
+        RETURNING p.product_id, p.product_stock
+    ),
+    removed AS (
+        DELETE FROM Cart c
+        USING purchased
+        WHERE c.user_id = p_user_id AND c.product_id = purchased.product_id
+    )
+    SELECT purchased.product_id, purchased.product_stock FROM purchased;
 END;
 $$ LANGUAGE plpgsql;
 
@@ -146,7 +189,10 @@ CREATE OR REPLACE PROCEDURE sp_DeleteProduct(
     p_product_id INT
 ) AS $$
 BEGIN
-    DELETE FROM Products WHERE product_id = p_product_id;
+    -- Строка только помечается; физически ее удалит фоновая очистка вместе с каскадами
+    UPDATE Products
+    SET product_is_active = FALSE, product_deleted_at = now()
+    WHERE product_id = p_product_id AND product_is_active;
 
     IF NOT FOUND THEN
         RAISE WARNING 'Товар с ID % не найден.', p_product_id;
@@ -15,12 +15,28 @@ CREATE TABLE Categories
 CREATE TABLE Products
 (
     product_id SERIAL PRIMARY KEY,
-    product_name varchar(255) NOT NULL UNIQUE,
+    product_name varchar(255) NOT NULL,
     product_price DECIMAL(10, 2) NOT NULL CHECK (product_price > 0),
     product_description TEXT,
-    product_image_path TEXT
+    product_image_path TEXT,
+    product_stock INT NOT NULL DEFAULT 1 CHECK (product_stock >= 0), -- Количество на складе
+    product_is_active BOOLEAN NOT NULL DEFAULT TRUE, -- FALSE: товар удален и ждет физического удаления
+    product_deleted_at TIMESTAMPTZ,
+    -- Полнотекстовый поиск: название важнее описания; столбец пересчитывается самой БД
+    product_search TSVECTOR GENERATED ALWAYS AS (
+        setweight(to_tsvector('russian', coalesce(product_name, '')), 'A') ||
+        setweight(to_tsvector('russian', coalesce(product_description, '')), 'B')
+    ) STORED
 );
 
+-- Все чтения идут только по активным товарам; имя уникально среди активных,
+-- чтобы удаленный товар не мешал завести новый с тем же названием
+CREATE UNIQUE INDEX ux_products_active_name ON Products (product_name) WHERE product_is_active;
+CREATE INDEX ix_products_active ON Products (product_id) WHERE product_is_active;
+-- Очередь фоновой очистки: удаленные товары в порядке удаления
+CREATE INDEX ix_products_inactive ON Products (product_deleted_at) WHERE NOT product_is_active;
+CREATE INDEX ix_products_search ON Products USING GIN (product_search) WHERE product_is_active;
+
 CREATE TABLE Products_Categories
 (
     product_id INT,
@@ -12,7 +12,9 @@ FROM
 LEFT JOIN
     Products_Categories pc ON p.product_id = pc.product_id
 LEFT JOIN
-    Categories c ON pc.category_id = c.category_id;
+    Categories c ON pc.category_id = c.category_id
+WHERE
+    p.product_is_active;
 
 CREATE OR REPLACE VIEW vw_UserCartItems AS
 SELECT
@@ -28,17 +30,19 @@ FROM
 JOIN
     Users u ON cr.user_id = u.user_id
 JOIN
-    Products p ON cr.product_id = p.product_id;
+    Products p ON cr.product_id = p.product_id AND p.product_is_active;
 
 CREATE OR REPLACE VIEW vw_CategoriesWithProductCount AS
 SELECT
     c.category_id,
     c.category_name,
-    COUNT(pc.product_id) AS number_of_products
+    COUNT(p.product_id) AS number_of_products
 FROM
     Categories c
 LEFT JOIN
     Products_Categories pc ON c.category_id = pc.category_id
+LEFT JOIN
+    Products p ON pc.product_id = p.product_id AND p.product_is_active
 GROUP BY
     c.category_id, c.category_name
 ORDER BY